@@ -0,0 +1,702 @@
+#include "include/rhi_sc.h"
+#include "src/common/backend.h"
+#include "src/common/link.h"
+#include "src/common/spirv.h"
+#include <argparse/argparse.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+// Compile throughput benchmark over the synthetic corpus written by generate_corpus.py, results are printed as JSON.
+// Phases come from CompilationStats with the include cache dropped before every compile, so loads hit the disk.
+// Latency percentiles and throughput are measured without statistics enabled.
+using Clock = std::chrono::steady_clock;
+namespace RSC = RHI::ShaderCompiler;
+
+// Counts the allocations made while counting is set, for the argument building benchmark
+static std::atomic<bool> count_allocations = false;
+static std::atomic<size_t> allocations = 0;
+void* operator new(size_t size)
+{
+    if(count_allocations.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct CorpusShader
+{
+    std::string category;
+    RHI::ShaderStage stage;
+    std::filesystem::path path;
+};
+struct ShaderTimings
+{
+    std::vector<double> load, preprocess, front_end, optimization, serialization, total;
+    size_t bytes_in = 0, bytes_out = 0;
+};
+static double Milliseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+static double Percentile(std::vector<double> values, double p)
+{
+    if(values.empty()) return 0;
+    std::ranges::sort(values);
+    size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+    return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+static size_t PeakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+static std::string JsonString(std::string_view str)
+{
+    std::string out = "\"";
+    for(char c : str)
+    {
+        if(c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+static bool LoadCorpus(const std::filesystem::path& dir, std::vector<CorpusShader>& corpus)
+{
+    std::ifstream listing(dir / "corpus.txt");
+    std::string category, stage, file;
+    while(listing >> category >> stage >> file)
+    {
+        RHI::ShaderStage shader_stage;
+        if(stage == "compute") shader_stage = RHI::ShaderStage::Compute;
+        else if(stage == "pixel") shader_stage = RHI::ShaderStage::Pixel;
+        else if(stage == "vertex") shader_stage = RHI::ShaderStage::Vertex;
+        else return false;
+        corpus.push_back({category, shader_stage, dir / file});
+    }
+    return !corpus.empty();
+}
+static std::unique_ptr<RSC::CompileOptions> MakeOptions(RSC::OptimizationLevel level)
+{
+    auto opt = RSC::CompileOptions::New();
+    opt->SetOptimizationLevel(level);
+    return opt;
+}
+static RSC::ShaderSource Source(const CorpusShader& shader)
+{
+    RSC::ShaderSource src;
+    src.source = shader.path;
+    src.stage = shader.stage;
+    return src;
+}
+// Hammers one Compiler and one CompileOptions from every thread at once, mixing the output paths and dropping the
+// include cache now and then. Every output has to match the single threaded one
+static bool RunStress(const std::vector<CorpusShader>& corpus, const std::unique_ptr<RSC::CompileOptions>& opt, size_t threads, size_t iterations, std::ostream& json)
+{
+    const auto cmp = RSC::Compiler::New();
+    std::vector<std::vector<char>> expected(corpus.size());
+    for(size_t i = 0; i < corpus.size(); i++)
+    {
+        auto result = cmp->CompileToBuffer(RHI::API::Vulkan, Source(corpus[i]), opt, expected[i]);
+        if(result.error != RSC::CompilationError::None)
+        {
+            std::cerr << corpus[i].path.string() << ": compilation failed\n" << result.messages << std::endl;
+            return false;
+        }
+    }
+    std::atomic<size_t> compilations = 0, failures = 0, mismatches = 0;
+    auto worker = [&](size_t id)
+    {
+        for(size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            for(size_t n = 0; n < corpus.size(); n++)
+            {
+                // every thread walks the corpus from a different starting point
+                size_t i = (n + id) % corpus.size();
+                std::vector<char> output;
+                RSC::CompilationResult result;
+                if((id + iteration) % 2)
+                {
+                    RSC::ShaderBlob blob;
+                    result = cmp->CompileToBlob(Source(corpus[i]), opt, blob);
+                    output.assign(blob.Bytes().begin(), blob.Bytes().end());
+                }
+                else
+                {
+                    result = cmp->CompileToBuffer(RHI::API::Vulkan, Source(corpus[i]), opt, output);
+                }
+                if(id == 0 && n == 0) cmp->InvalidateIncludeCache();
+                compilations++;
+                if(result.error != RSC::CompilationError::None) failures++;
+                else if(output != expected[i]) mismatches++;
+            }
+        }
+    };
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for(size_t i = 0; i < threads; i++)
+        pool.emplace_back(worker, i);
+    for(auto& thread : pool)
+        thread.join();
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"stress\": {\"threads\": " << threads << ", \"compilations\": " << compilations << ", \"failures\": " << failures
+         << ", \"mismatches\": " << mismatches << ", \"seconds\": " << std::chrono::duration<double>(Clock::now() - start).count() << "},\n";
+    json << "  \"peak_rss_kb\": " << PeakRssKb() << "\n";
+    json << "}\n";
+    return failures == 0 && mismatches == 0;
+}
+// Builds the backend's command line for every corpus shader with a typical set of options and counts the heap
+// allocations doing so, there should be none
+static bool RunArguments(const std::vector<CorpusShader>& corpus, RSC::OptimizationLevel level, size_t iterations, std::ostream& json)
+{
+    auto opt = MakeOptions(level);
+    opt->SetEntryPoint("main");
+    opt->EnableDebuggingSymbols();
+    for(int i = 0; i < 16; i++)
+        opt->AddMacroDefinition("FEATURE_" + std::to_string(i), std::to_string(i % 2));
+    std::vector<RSC::ShaderSource> sources;
+    for(auto& shader : corpus)
+        sources.push_back(Source(shader));
+    size_t argument_count = 0;
+    const RSC::Backend::ArgumentVisitor visit = [&](std::span<const wchar_t* const> args) { argument_count += args.size(); };
+    const size_t builds = std::max<size_t>(iterations, 1) * 10000;
+    allocations = 0;
+    count_allocations = true;
+    auto start = Clock::now();
+    for(size_t build = 0; build < builds; build++)
+        RSC::Backend::VisitArguments(opt.get(), sources[build % sources.size()], visit);
+    auto elapsed = Clock::now() - start;
+    count_allocations = false;
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"arguments\": {\"builds\": " << builds << ", \"arguments_per_build\": " << static_cast<double>(argument_count) / builds
+         << ", \"allocations_per_build\": " << static_cast<double>(allocations) / builds
+         << ", \"ns_per_build\": " << std::chrono::duration<double, std::nano>(elapsed).count() / builds << "}\n";
+    json << "}\n";
+    return allocations == 0;
+}
+// Streams jobs and then four times as many through CompileBatch with a sink that drops the outputs. The peak RSS
+// must not grow with the job count
+static bool RunBatch(const std::vector<CorpusShader>& corpus, const std::unique_ptr<RSC::CompileOptions>& opt, size_t jobs, size_t threads, std::ostream& json)
+{
+    const auto cmp = RSC::Compiler::New();
+    size_t failures = 0;
+    auto run = [&](size_t count, size_t& bytes)
+    {
+        auto source = [&](size_t i, RSC::ShaderSource& src, std::unique_ptr<RSC::CompileOptions>& options)
+        {
+            src = Source(corpus[i % corpus.size()]);
+            if(!options) options = opt->Clone();
+            return true;
+        };
+        auto sink = [&](RSC::BatchOutput& done)
+        {
+            if(done.result.error != RSC::CompilationError::None) failures++;
+            bytes += done.output.size();
+        };
+        RSC::BatchSettings settings;
+        settings.memory_repr = false;
+        settings.threads = static_cast<uint32_t>(threads);
+        settings.max_memory = size_t(16) << 20;
+        auto start = Clock::now();
+        cmp->CompileBatch(count, source, sink, settings);
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    size_t small_bytes = 0, large_bytes = 0;
+    const double small_seconds = run(jobs, small_bytes);
+    const size_t small_rss = PeakRssKb();
+    const double large_seconds = run(jobs * 4, large_bytes);
+    const size_t large_rss = PeakRssKb();
+    // allocator noise, the outputs of the larger run alone are four times as big
+    const bool bounded = large_rss <= small_rss + small_rss / 10;
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"batch\": [\n";
+    json << "    {\"jobs\": " << jobs << ", \"output_bytes\": " << small_bytes << ", \"seconds\": " << small_seconds << ", \"peak_rss_kb\": " << small_rss << "},\n";
+    json << "    {\"jobs\": " << jobs * 4 << ", \"output_bytes\": " << large_bytes << ", \"seconds\": " << large_seconds << ", \"peak_rss_kb\": " << large_rss << "}\n";
+    json << "  ],\n";
+    json << "  \"failures\": " << failures << "\n";
+    json << "}\n";
+    if(!bounded)
+        std::cerr << "Peak RSS grew from " << small_rss << " KiB to " << large_rss << " KiB with four times the jobs" << std::endl;
+    return failures == 0 && bounded;
+}
+// Links the corpus' vertex and pixel shader pair, whose pixel shader reads two of the four varyings. The linked vertex
+// shader must only write what the pixel shader reads and be smaller than the one compiled alone. Its vector constants
+// (OpConstantComposite) have to be handled by the linker, a module it gives up on keeps every output
+static bool RunPipeline(const std::filesystem::path& dir, RSC::OptimizationLevel level, size_t iterations, std::ostream& json)
+{
+    const auto cmp = RSC::Compiler::New();
+    auto stages = std::vector<RSC::PipelineStage>(2);
+    stages[0].source.source = dir / "pipeline_vs.hlsl";
+    stages[0].source.stage = RHI::ShaderStage::Vertex;
+    stages[1].source.source = dir / "pipeline_ps.hlsl";
+    stages[1].source.stage = RHI::ShaderStage::Pixel;
+    for(auto& stage : stages)
+        stage.options = MakeOptions(level);
+    std::vector<char> alone;
+    if(cmp->CompileToBuffer(RHI::API::Vulkan, stages[0].source, stages[0].options, alone).error != RSC::CompilationError::None)
+    {
+        std::cerr << "pipeline_vs.hlsl: compilation failed" << std::endl;
+        return false;
+    }
+    std::vector<RSC::PipelineStageResult> linked;
+    auto start = Clock::now();
+    for(size_t i = 0; i < iterations; i++)
+        linked = cmp->CompilePipeline(RHI::API::Vulkan, stages);
+    auto elapsed = Clock::now() - start;
+    for(auto& stage : linked)
+    {
+        if(stage.result.error != RSC::CompilationError::None)
+        {
+            std::cerr << stage.result.messages << "pipeline: linking failed" << std::endl;
+            return false;
+        }
+    }
+    auto code = [](const std::vector<char>& bytes){ return std::span(reinterpret_cast<const uint32_t*>(bytes.data()), bytes.size() / sizeof(uint32_t)); };
+    auto vertex = RSC::Spirv::Interface(code(linked[0].output));
+    auto pixel = RSC::Spirv::Interface(code(linked[1].output));
+    std::vector<uint32_t> written, read;
+    if(vertex) for(auto& output : vertex->outputs) written.push_back(output.location);
+    if(pixel) for(auto& input : pixel->inputs) read.push_back(input.location);
+    std::ranges::sort(written);
+    std::ranges::sort(read);
+    const uint32_t before = RSC::Spirv::InstructionCount(code(alone)), after = RSC::Spirv::InstructionCount(code(linked[0].output));
+    const bool composites = std::ranges::any_of(RSC::Spirv::Parse(code(alone)), [](auto& inst){ return inst.opcode == RSC::Spirv::OpConstantComposite; });
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"pipeline\": {\"links\": " << iterations << ", \"ms_per_link\": " << Milliseconds(elapsed) / iterations
+         << ", \"removed_outputs\": " << linked[0].removed_outputs.size() << ", \"removed_inputs\": " << linked[1].removed_inputs.size()
+         << ", \"vertex_instructions_alone\": " << before << ", \"vertex_instructions_linked\": " << after
+         << ", \"composite_constants\": " << (composites ? "true" : "false") << "}\n";
+    json << "}\n";
+    for(auto& stage : linked)
+    {
+        if(stage.result.warning_count)
+        {
+            std::cerr << stage.result.messages << "pipeline: a stage was left unlinked" << std::endl;
+            return false;
+        }
+    }
+    if(!composites)
+    {
+        std::cerr << "pipeline: pipeline_vs.hlsl has no composite constant, the check doesn't cover them" << std::endl;
+        return false;
+    }
+    if(!vertex || !pixel || written != read || read.size() != 2)
+    {
+        std::cerr << "pipeline: the vertex shader still writes varyings the pixel shader doesn't read" << std::endl;
+        return false;
+    }
+    if(after >= before)
+    {
+        std::cerr << "pipeline: the code computing the removed varyings is still there" << std::endl;
+        return false;
+    }
+    return true;
+}
+// Strips and remaps every shader of the corpus, neither pass may give up on a module. Vector constants are everywhere
+// in real shaders, the corpus has to contain some for the check to mean anything
+static bool RunPostProcess(const std::vector<CorpusShader>& corpus, RSC::OptimizationLevel level, std::ostream& json)
+{
+    const auto cmp = RSC::Compiler::New();
+    auto opt = MakeOptions(level);
+    opt->StripDebugInfo();
+    opt->RemapIds();
+    size_t skipped = 0, composites = 0, bytes = 0;
+    for(auto& shader : corpus)
+    {
+        std::vector<char> output;
+        auto result = cmp->CompileToBuffer(RHI::API::Vulkan, Source(shader), opt, output);
+        if(result.error != RSC::CompilationError::None || result.warning_count)
+        {
+            std::cerr << result.messages << shader.path.string() << ": compilation failed or a post processing pass was skipped" << std::endl;
+            skipped++;
+            continue;
+        }
+        bytes += output.size();
+        auto code = std::span(reinterpret_cast<const uint32_t*>(output.data()), output.size() / sizeof(uint32_t));
+        auto instructions = RSC::Spirv::Parse(code);
+        composites += std::ranges::any_of(instructions, [](auto& inst){ return inst.opcode == RSC::Spirv::OpConstantComposite; });
+    }
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"postprocess\": {\"shaders\": " << corpus.size() << ", \"skipped\": " << skipped
+         << ", \"with_composite_constants\": " << composites << ", \"output_bytes\": " << bytes << "}\n";
+    json << "}\n";
+    if(!composites)
+        std::cerr << "postprocess: no module of the corpus has a composite constant" << std::endl;
+    return skipped == 0 && composites > 0;
+}
+// Bytes read through read() and friends by this process so far, nullopt without /proc
+static std::optional<uint64_t> ReadChars()
+{
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while(io >> key >> value)
+    {
+        if(key == "rchar:") return value;
+    }
+    return std::nullopt;
+}
+// Compiles the corpus from a MemoryFileSystem and from a mapped source archive, under a root that doesn't exist on disk.
+// The outputs must match the ones compiled from disk and, where /proc/self/io is there, no compile may read anything
+static bool RunFileSystem(const std::filesystem::path& dir, const std::vector<CorpusShader>& corpus, const std::unique_ptr<RSC::CompileOptions>& opt, size_t iterations, std::ostream& json)
+{
+    const auto cmp = RSC::Compiler::New();
+    // the main file's name would tell the outputs apart otherwise
+    const auto stripped = opt->Clone();
+    stripped->StripDebugInfo();
+    std::vector<std::vector<char>> expected(corpus.size());
+    for(size_t i = 0; i < corpus.size(); i++)
+    {
+        if(cmp->CompileToBuffer(RHI::API::Vulkan, Source(corpus[i]), stripped, expected[i]).error != RSC::CompilationError::None)
+        {
+            std::cerr << corpus[i].path.string() << ": compilation failed" << std::endl;
+            return false;
+        }
+    }
+    const std::filesystem::path root = "virtual-corpus";
+    auto memory = RSC::MemoryFileSystem::New();
+    RSC::ArchiveWriter writer;
+    for(auto& entry : std::filesystem::recursive_directory_iterator(dir))
+    {
+        if(!entry.is_regular_file()) continue;
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto name = (root / entry.path().lexically_relative(dir)).generic_string();
+        writer.Add(name, "", std::vector<char>(text.begin(), text.end()));
+        memory->Write(name, std::move(text));
+    }
+    const auto archive_path = std::filesystem::temp_directory_path() / "rhi_sc_bench_sources.rsa";
+    if(!writer.Write(archive_path))
+    {
+        std::cerr << "Failed to write " << archive_path.string() << std::endl;
+        return false;
+    }
+    struct Run
+    {
+        const char* name = nullptr;
+        std::shared_ptr<RSC::FileSystem> files = nullptr;
+        double ms = 0;
+        std::optional<uint64_t> bytes_read = std::nullopt;
+        size_t mismatches = 0;
+    };
+    Run runs[] = {{.name = "memory", .files = memory}, {.name = "archive", .files = RSC::FileSystem::MapArchive(archive_path)}};
+    bool passed = runs[1].files != nullptr;
+    for(auto& run : runs)
+    {
+        if(!run.files) continue;
+        cmp->SetFileSystem(run.files);
+        // the second read measures what reading /proc/self/io itself adds
+        auto before = ReadChars(), idle = ReadChars();
+        auto start = Clock::now();
+        for(size_t n = 0; n < iterations; n++)
+        {
+            for(size_t i = 0; i < corpus.size(); i++)
+            {
+                RSC::ShaderSource src;
+                src.source = root / corpus[i].path.lexically_relative(dir);
+                src.stage = corpus[i].stage;
+                std::vector<char> output;
+                auto result = cmp->CompileToBuffer(RHI::API::Vulkan, src, stripped, output);
+                run.mismatches += result.error != RSC::CompilationError::None || output != expected[i];
+            }
+        }
+        run.ms = Milliseconds(Clock::now() - start);
+        if(auto after = ReadChars(); before && idle && after)
+            run.bytes_read = (*after - *idle) - (*idle - *before);
+        passed &= run.mismatches == 0 && run.bytes_read.value_or(0) == 0;
+    }
+    cmp->SetFileSystem(nullptr);
+    for(auto& run : runs)
+        run.files.reset();
+    std::error_code ec;
+    std::filesystem::remove(archive_path, ec);
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"file_systems\": [\n";
+    for(size_t r = 0; r < std::size(runs); r++)
+    {
+        auto& run = runs[r];
+        json << "    {\"name\": \"" << run.name << "\", \"compiles\": " << iterations * corpus.size() << ", \"ms_per_compile\": "
+             << run.ms / (iterations * corpus.size()) << ", \"mismatches\": " << run.mismatches << ", \"bytes_read\": ";
+        if(run.bytes_read) json << *run.bytes_read;
+        else json << "null";
+        json << "}" << (r + 1 < std::size(runs) ? ",\n" : "\n");
+    }
+    json << "  ]\n";
+    json << "}\n";
+    if(!passed)
+        std::cerr << "file systems: a compile failed, differed from the one from disk or read from disk" << std::endl;
+    return passed;
+}
+static bool WriteReport(const argparse::ArgumentParser& parser, const std::string& report)
+{
+    if(const auto output = parser.present("--output"))
+    {
+        std::ofstream file(*output);
+        file << report;
+        if(!file.good())
+        {
+            std::cerr << "Failed to write " << *output << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        std::cout << report;
+    }
+    return true;
+}
+int main(int argc, char** argv)
+{
+    argparse::ArgumentParser parser("rhi_sc_bench");
+    parser.add_description("Compile throughput benchmark for rhi_sc");
+    parser.add_argument("corpus")
+        .help("Directory written by generate_corpus.py");
+    parser.add_argument("--level")
+        .default_value(std::string("3"))
+        .help("Optimization level (None, 1, 2 or 3)");
+    parser.add_argument("--iterations")
+        .default_value(5)
+        .scan<'i', int>()
+        .help("Times every shader is compiled per measurement");
+    parser.add_argument("--threads")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Highest thread count measured for throughput (0 uses every hardware thread)");
+    parser.add_argument("--output")
+        .help("Write the JSON report to this file instead of stdout");
+    parser.add_argument("--stress")
+        .scan<'i', int>()
+        .help("Instead of measuring, compile the corpus from this many threads through one shared Compiler and check every output");
+    parser.add_argument("--arguments")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Instead of compiling, count the heap allocations made building the backend's command line");
+    parser.add_argument("--pipeline")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Instead of measuring, link the corpus' vertex and pixel shader and check the unread varyings were removed");
+    parser.add_argument("--batch")
+        .scan<'i', int>()
+        .help("Instead of measuring, stream this many and then four times as many jobs through CompileBatch and check the peak RSS stays flat");
+    parser.add_argument("--postprocess")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Instead of measuring, strip and remap the ids of every shader and check neither pass gives up on one");
+    parser.add_argument("--file-systems")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Instead of measuring, compile the corpus from memory and from a mapped archive and check nothing is read from disk");
+    parser.parse_args(argc, argv);
+
+    std::vector<CorpusShader> corpus;
+    if(!LoadCorpus(parser.get<std::string>("corpus"), corpus))
+    {
+        std::cerr << "Failed to read the corpus listing" << std::endl;
+        return 1;
+    }
+    const auto level_name = parser.get<std::string>("level");
+    RSC::OptimizationLevel level;
+    if(level_name == "None") level = RSC::OptimizationLevel::None;
+    else if(level_name == "1") level = RSC::OptimizationLevel::_1;
+    else if(level_name == "2") level = RSC::OptimizationLevel::_2;
+    else if(level_name == "3") level = RSC::OptimizationLevel::_3;
+    else
+    {
+        std::cerr << "Unknown optimization level " << level_name << std::endl;
+        return 1;
+    }
+    const size_t iterations = std::max(parser.get<int>("iterations"), 1);
+    const size_t max_threads = parser.get<int>("threads") > 0 ? parser.get<int>("threads") : std::max(std::thread::hardware_concurrency(), 1u);
+    const auto opt = MakeOptions(level);
+    const auto stats_opt = MakeOptions(level);
+    stats_opt->EnableStatistics();
+    if(const auto stress = parser.present<int>("--stress"))
+    {
+        std::ostringstream json;
+        bool passed = RunStress(corpus, opt, std::max(*stress, 1), iterations, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    if(parser.get<bool>("--pipeline"))
+    {
+        std::ostringstream json;
+        bool passed = RunPipeline(parser.get<std::string>("corpus"), level, iterations, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    if(const auto batch = parser.present<int>("--batch"))
+    {
+        std::ostringstream json;
+        bool passed = RunBatch(corpus, opt, std::max(*batch, 1), max_threads, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    if(parser.get<bool>("--postprocess"))
+    {
+        std::ostringstream json;
+        bool passed = RunPostProcess(corpus, level, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    if(parser.get<bool>("--file-systems"))
+    {
+        std::ostringstream json;
+        bool passed = RunFileSystem(parser.get<std::string>("corpus"), corpus, opt, iterations, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    if(parser.get<bool>("--arguments"))
+    {
+        std::ostringstream json;
+        bool passed = RunArguments(corpus, level, iterations, json);
+        return WriteReport(parser, json.str()) && passed ? 0 : 1;
+    }
+
+    // per shader phases, single threaded
+    const auto cmp = RSC::Compiler::New();
+    std::vector<ShaderTimings> timings(corpus.size());
+    for(size_t i = 0; i < corpus.size(); i++)
+    {
+        std::vector<char> output;
+        auto result = cmp->CompileToBuffer(RHI::API::Vulkan, Source(corpus[i]), opt, output, false);
+        if(result.error != RSC::CompilationError::None)
+        {
+            std::cerr << corpus[i].path.string() << ": compilation failed\n" << result.messages << std::endl;
+            return 1;
+        }
+        timings[i].bytes_out = output.size();
+        for(auto& file : result.dependencies)
+            timings[i].bytes_in += std::filesystem::file_size(file);
+    }
+    for(size_t iteration = 0; iteration < iterations; iteration++)
+    {
+        for(size_t i = 0; i < corpus.size(); i++)
+        {
+            auto& t = timings[i];
+            auto src = Source(corpus[i]);
+
+            std::vector<char> output;
+            cmp->InvalidateIncludeCache();
+            auto phases = cmp->CompileToBuffer(RHI::API::Vulkan, src, stats_opt, output, false).stats.value_or(RSC::CompilationStats{});
+            t.load.push_back(phases.load_ms);
+            t.preprocess.push_back(phases.preprocess_ms);
+            t.front_end.push_back(phases.codegen_ms);
+            t.optimization.push_back(phases.optimize_ms);
+            t.serialization.push_back(phases.output_ms);
+
+            auto start = Clock::now();
+            (void)cmp->CompileToBuffer(RHI::API::Vulkan, src, opt, output, false);
+            t.total.push_back(Milliseconds(Clock::now() - start));
+        }
+    }
+
+    // throughput, the threads share one compiler and take the next job off a shared counter
+    std::vector<std::pair<size_t, double>> throughput;
+    for(size_t threads = 1;; threads = std::min(threads * 2, max_threads))
+    {
+        const size_t jobs = corpus.size() * iterations;
+        std::atomic<size_t> next = 0;
+        const auto shared_cmp = RSC::Compiler::New();
+        auto worker = [&]()
+        {
+            std::vector<char> output;
+            for(size_t job = next++; job < jobs; job = next++)
+            {
+                output.clear();
+                (void)shared_cmp->CompileToBuffer(RHI::API::Vulkan, Source(corpus[job % corpus.size()]), opt, output, false);
+            }
+        };
+        auto start = Clock::now();
+        std::vector<std::thread> pool;
+        for(size_t i = 1; i < threads; i++)
+            pool.emplace_back(worker);
+        worker();
+        for(auto& thread : pool)
+            thread.join();
+        throughput.emplace_back(threads, jobs / std::chrono::duration<double>(Clock::now() - start).count());
+        if(threads == max_threads) break;
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"backend\": " << JsonString(RSC::Compiler::BackendName()) << ",\n";
+    json << "  \"level\": " << JsonString(level_name) << ",\n";
+    json << "  \"iterations\": " << iterations << ",\n";
+    json << "  \"shaders\": [\n";
+    std::map<std::string, std::vector<double>> categories;
+    std::vector<double> all;
+    for(size_t i = 0; i < corpus.size(); i++)
+    {
+        auto& t = timings[i];
+        json << "    {\"name\": " << JsonString(corpus[i].path.filename().string()) << ", \"category\": " << JsonString(corpus[i].category)
+             << ", \"bytes_in\": " << t.bytes_in << ", \"bytes_out\": " << t.bytes_out
+             << ", \"phases_ms\": {\"load\": " << Percentile(t.load, 0.5) << ", \"preprocess\": " << Percentile(t.preprocess, 0.5)
+             << ", \"front_end\": " << Percentile(t.front_end, 0.5) << ", \"optimization\": " << Percentile(t.optimization, 0.5)
+             << ", \"serialization\": " << Percentile(t.serialization, 0.5) << "}"
+             << ", \"p50_ms\": " << Percentile(t.total, 0.5) << ", \"p99_ms\": " << Percentile(t.total, 0.99) << "}"
+             << (i + 1 < corpus.size() ? ",\n" : "\n");
+        auto& category = categories[corpus[i].category];
+        category.insert(category.end(), t.total.begin(), t.total.end());
+        all.insert(all.end(), t.total.begin(), t.total.end());
+    }
+    json << "  ],\n";
+    json << "  \"categories\": {";
+    for(auto it = categories.begin(); it != categories.end(); ++it)
+    {
+        json << (it == categories.begin() ? "\n" : ",\n") << "    " << JsonString(it->first)
+             << ": {\"p50_ms\": " << Percentile(it->second, 0.5) << ", \"p99_ms\": " << Percentile(it->second, 0.99) << "}";
+    }
+    json << "\n  },\n";
+    json << "  \"latency_ms\": {\"p50\": " << Percentile(all, 0.5) << ", \"p99\": " << Percentile(all, 0.99) << "},\n";
+    json << "  \"throughput\": [";
+    for(size_t i = 0; i < throughput.size(); i++)
+    {
+        json << (i ? ", " : "") << "{\"threads\": " << throughput[i].first << ", \"shaders_per_second\": " << throughput[i].second << "}";
+    }
+    json << "],\n";
+    json << "  \"peak_rss_kb\": " << PeakRssKb() << "\n";
+    json << "}\n";
+
+    return WriteReport(parser, json.str()) ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# Writes the synthetic HLSL corpus the benchmark compiles, plus corpus.txt listing "category stage file" per shader.
+# Output is deterministic so numbers stay comparable between runs and machines.
+import os
+import sys
+
+out_dir = sys.argv[1]
+os.makedirs(os.path.join(out_dir, 'include'), exist_ok=True)
+listing = []
+
+
+def write(name, text):
+    with open(os.path.join(out_dir, name), 'w', newline='\n') as f:
+        f.write(text)
+
+
+def add(category, stage, name, text):
+    write(name, text)
+    listing.append(f'{category} {stage} {name}')
+
+
+def helper(i):
+    return f'''float4 helper{i}(float4 v, float t)
+{{
+    float4 r = v;
+    [loop] for(int k = 0; k < {4 + i % 5}; k++)
+    {{
+        r = r * {1.0 + i * 0.01:.2f} + sin(r.yzwx * t + k);
+        r.xy = r.x > r.y ? r.yx : r.xy;
+    }}
+    return normalize(r + {i}.0);
+}}
+'''
+
+
+compute_header = '''RWStructuredBuffer<float4> data : register(u0);
+cbuffer Params : register(b0)
+{
+    float4 scale;
+    uint count;
+};
+'''
+
+for i in range(4):
+    add('small', 'compute', f'small_{i}.hlsl', compute_header + f'''
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{{
+    if(id.x >= count) return;
+    data[id.x] = data[id.x] * scale + {i}.0;
+}}
+''')
+
+medium_body = ''.join(helper(i) for i in range(24))
+for i in range(2):
+    calls = ''.join(f'    color += helper{k}(color, uv.x * {k + 1}.0);\n' for k in range(24))
+    add('medium', 'pixel', f'medium_{i}.hlsl', f'''Texture2D albedo : register(t0);
+SamplerState linear_sampler : register(s0);
+cbuffer Material : register(b0)
+{{
+    float4 tint;
+    float roughness;
+}};
+{medium_body}
+float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target
+{{
+    float4 color = albedo.Sample(linear_sampler, uv) * tint;
+{calls}    return color * roughness + {i}.0;
+}}
+''')
+
+huge_body = ''.join(helper(i) for i in range(600))
+huge_calls = ''.join(f'    v += helper{k}(v, {k}.0);\n' for k in range(600))
+add('huge', 'compute', 'huge_0.hlsl', compute_header + huge_body + f'''
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{{
+    float4 v = data[id.x] * scale;
+{huge_calls}    data[id.x] = v;
+}}
+''')
+
+# every header pulls in a shared set of common headers, so the tree has many repeated includes
+for i in range(16):
+    write(os.path.join('include', f'common_{i}.hlsli'), f'''#ifndef COMMON_{i}
+#define COMMON_{i}
+float common{i}(float x) {{ return x * {i + 1}.0 + {i}.0; }}
+#endif
+''')
+for i in range(64):
+    commons = ''.join(f'#include "common_{(i + k) % 16}.hlsli"\n' for k in range(4))
+    write(os.path.join('include', f'module_{i}.hlsli'), f'''#ifndef MODULE_{i}
+#define MODULE_{i}
+{commons}float module{i}(float x) {{ return common{i % 16}(x) + common{(i + 3) % 16}(x * 0.5); }}
+#endif
+''')
+for i in range(2):
+    includes = ''.join(f'#include "include/module_{k}.hlsli"\n' for k in range(64))
+    sums = ' + '.join(f'module{k}(x)' for k in range(0, 64, 8))
+    add('include_heavy', 'compute', f'include_heavy_{i}.hlsl', includes + compute_header + f'''
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{{
+    float x = data[id.x].x;
+    data[id.x] = ({sums}) * scale + {i}.0;
+}}
+''')
+
+for i in range(2):
+    defines = ''.join(f'#define M{k}(x) (M{k - 1}(x) * 0.5 + {k}.0)\n' for k in range(1, 64))
+    conditionals = ''.join(f'''#if FEATURE_LEVEL > {k}
+    v += M{k}(v);
+#else
+    v -= M{k}(v);
+#endif
+''' for k in range(0, 64, 2))
+    add('macro_heavy', 'compute', f'macro_heavy_{i}.hlsl', f'''#define M0(x) (x)
+{defines}#define FEATURE_LEVEL {32 + i}
+''' + compute_header + f'''
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{{
+    float4 v = data[id.x];
+{conditionals}    data[id.x] = M63(v) * scale;
+}}
+''')
+
+# a vertex and pixel shader linked by --pipeline, the pixel shader only reads two of the four varyings. Not listed in
+# corpus.txt, the throughput numbers stay comparable
+varyings = '''struct Varyings
+{
+    float4 pos : SV_Position;
+    float2 uv : TEXCOORD0;
+    float3 normal : NORMAL;
+    float4 color : COLOR;
+    float4 tangent : TANGENT;
+};
+'''
+write('pipeline_vs.hlsl', varyings + helper(0) + helper(1) + '''cbuffer Camera : register(b0)
+{
+    float4x4 view_projection;
+    float time;
+};
+Varyings main(float3 pos : POSITION, float3 normal : NORMAL, float2 uv : TEXCOORD0)
+{
+    Varyings v;
+    v.pos = mul(view_projection, float4(pos, 1.0));
+    v.uv = uv;
+    v.normal = normal;
+    v.color = helper0(float4(pos, time), time);
+    v.tangent = helper1(float4(normal, time), time * 2.0);
+    return v;
+}
+''')
+write('pipeline_ps.hlsl', varyings + '''float4 main(Varyings v) : SV_Target
+{
+    return float4(v.uv, 0.0, 1.0) * saturate(v.normal.z);
+}
+''')
+
+write('corpus.txt', '\n'.join(listing) + '\n')
@@ -1,7 +1,20 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <functional>
+#include <istream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
 #include <string_view>
 #include <variant>
 #include <vector>
@@ -18,26 +31,484 @@ namespace RHI
             NonExistentFile,
             Error,
             APINotAvailable,
-            InvalidStage
+            InvalidStage,
+            Cancelled
+        };
+        // Filled in when CompileOptions::EnableStatistics was called, times are wall clock milliseconds
+        struct CompilationStats
+        {
+            // reading the main source and its includes
+            double load_ms = 0;
+            double preprocess_ms = 0;
+            // parsing and code generation, measured as an unoptimized compile minus preprocessing
+            double codegen_ms = 0;
+            // the compile at the requested level minus the unoptimized one, plus stripping and id remapping
+            double optimize_ms = 0;
+            // writing the file, buffer or allocation
+            double output_ms = 0;
+            double total_ms = 0;
+            uint64_t input_bytes = 0;
+            uint64_t output_bytes = 0;
+            uint32_t include_count = 0;
+            uint32_t instructions_before = 0;
+            uint32_t instructions_after = 0;
+            // size the module lost to StripDebugInfo and RemapIds
+            uint64_t stripped_bytes = 0;
+            // the output came from the cache directory, nothing was compiled
+            bool cache_hit = false;
+        };
+        // Static cost of one entry point of the output, counted over every function it can reach. Each function is counted
+        // once and loops once, so these are code properties to compare between builds rather than runtime estimates
+        struct ShaderCost
+        {
+            std::string entry_point;
+            ShaderStage stage = ShaderStage::None;
+            // arithmetic, logic, conversions and derivatives
+            uint32_t alu = 0;
+            // sin, cos, exp, log, pow, sqrt and the like, usually run at a fraction of the ALU rate
+            uint32_t transcendental = 0;
+            // sampling, fetching and gathering through image descriptors
+            uint32_t texture = 0;
+            // loads, stores and atomics on buffers, storage images, push constants and shared memory
+            uint32_t memory = 0;
+            uint32_t barrier = 0;
+            // control flow, composites, calls and the remaining instructions
+            uint32_t other = 0;
+            // the most values alive at once in one function, an estimate of register pressure. Scalars count the 32 bit
+            // components of those values (a float4 is 4)
+            uint32_t peak_live_values = 0;
+            uint32_t peak_live_scalars = 0;
+            uint32_t functions = 0;
+            uint32_t blocks = 0;
+            // conditional branches and switches
+            uint32_t branches = 0;
+            uint32_t loops = 0;
+            uint32_t max_loop_depth = 0;
+            // instructions inside any loop
+            uint32_t loop_instructions = 0;
+            // descriptors the entry point accesses, an array counts once
+            uint32_t uniform_buffers = 0;
+            uint32_t storage_buffers = 0;
+            uint32_t textures = 0;
+            uint32_t storage_images = 0;
+            uint32_t samplers = 0;
+            bool push_constants = false;
+            // an instruction the analysis doesn't know was reached, the values it reads are left out of the peak live counts
+            bool approximate = false;
         };
         struct CompilationResult
         {
             uint32_t warning_count = 0;
             std::string messages;
             CompilationError error;
+            // every file read to produce the output, the main source file first
+            std::vector<std::filesystem::path> dependencies;
+            std::optional<CompilationStats> stats;
+            // one per entry point, filled in when CompileOptions::EnableCostAnalysis was called
+            std::vector<ShaderCost> cost;
         };
         enum class OptimizationLevel
         {
             None, _1, _2, _3, Max=_3
         };
+        // Layout of the reflection data stored in the trailer of a shader file ([u32 size][SPIR-V][trailer]).
+        // A trailer of 16 zero bytes means no reflection was stored, otherwise the trailer starts with a Header
+        // followed by header.section_count Sections, whose offsets are relative to the start of the Header.
+        // All values are little endian u32s, strings are null terminated and referenced by offset into the Strings section
+        namespace Reflection
+        {
+            constexpr uint32_t Magic = 0x46525352; // "RSRF"
+            constexpr uint32_t Version = 1;
+            constexpr uint32_t NoName = 0xffffffff;
+            enum class SectionKind : uint32_t
+            {
+                Info, Bindings, PushConstants, VertexInputs, Strings, SpecConstants
+            };
+            // Descriptor types as declared in SPIR-V, the caller picks the RHI DescriptorType for each when it builds a RootSignatureDesc
+            enum class DescriptorKind : uint32_t
+            {
+                UniformBuffer, StorageBuffer, SampledImage, StorageImage, Sampler, CombinedImageSampler,
+                UniformTexelBuffer, StorageTexelBuffer, InputAttachment, AccelerationStructure
+            };
+            enum class ComponentType : uint32_t
+            {
+                Float, Int, UInt, Other, Bool
+            };
+            struct Header
+            {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t size;
+                uint32_t section_count;
+            };
+            struct Section
+            {
+                SectionKind kind;
+                uint32_t offset;
+                uint32_t count;
+                uint32_t stride;
+            };
+            struct Info
+            {
+                uint32_t stage;
+                uint32_t workgroup_size[3];
+            };
+            struct Binding
+            {
+                uint32_t set;
+                uint32_t binding;
+                DescriptorKind kind;
+                // 0 for runtime sized arrays
+                uint32_t count;
+                uint32_t name;
+            };
+            struct PushConstantRange
+            {
+                uint32_t offset;
+                uint32_t size;
+                uint32_t name;
+            };
+            struct VertexInput
+            {
+                uint32_t location;
+                ComponentType type;
+                uint32_t components;
+                uint32_t name;
+            };
+            struct SpecConstant
+            {
+                // the SpecId to pass in VkSpecializationMapEntry::constantID
+                uint32_t id;
+                ComponentType type;
+                // bits of the default value, 0 or 1 for Bool
+                uint32_t default_value;
+                uint32_t name;
+            };
+        }
+        // Zero copy view of the reflection stored in a shader file, the data must be 4 byte aligned and outlive the view
+        class ShaderReflection
+        {
+        public:
+            // nullopt if the file carries no (or malformed) reflection
+            static std::optional<ShaderReflection> FromFile(std::span<const char> file)
+            {
+                uint32_t spv_size;
+                if(file.size() < sizeof(uint32_t)) return std::nullopt;
+                std::memcpy(&spv_size, file.data(), sizeof(uint32_t));
+                if(spv_size > file.size() - sizeof(uint32_t)) return std::nullopt;
+                return FromTrailer(file.subspan(sizeof(uint32_t) + spv_size));
+            }
+            static std::optional<ShaderReflection> FromTrailer(std::span<const char> trailer)
+            {
+                if(trailer.size() < sizeof(Reflection::Header)) return std::nullopt;
+                auto header = reinterpret_cast<const Reflection::Header*>(trailer.data());
+                if(header->magic != Reflection::Magic || header->version != Reflection::Version || header->size > trailer.size() ||
+                    header->size < sizeof(Reflection::Header) + header->section_count * uint64_t(sizeof(Reflection::Section)))
+                    return std::nullopt;
+                ShaderReflection reflection;
+                reflection.data = trailer.first(header->size);
+                for(auto& section : reflection.Sections())
+                {
+                    // sections are read in place as arrays of u32 based structs
+                    if(section.offset % alignof(uint32_t) != 0 || section.offset > header->size ||
+                        section.count * uint64_t(section.stride) > header->size - section.offset)
+                        return std::nullopt;
+                }
+                return reflection;
+            }
+            [[nodiscard]] ShaderStage Stage() const
+            {
+                auto info = Section<Reflection::Info>(Reflection::SectionKind::Info);
+                return info.empty() ? ShaderStage::None : static_cast<ShaderStage>(info[0].stage);
+            }
+            [[nodiscard]] std::array<uint32_t, 3> WorkgroupSize() const
+            {
+                auto info = Section<Reflection::Info>(Reflection::SectionKind::Info);
+                if(info.empty()) return {0, 0, 0};
+                return {info[0].workgroup_size[0], info[0].workgroup_size[1], info[0].workgroup_size[2]};
+            }
+            [[nodiscard]] std::span<const Reflection::Binding> Bindings() const
+            {
+                return Section<Reflection::Binding>(Reflection::SectionKind::Bindings);
+            }
+            [[nodiscard]] std::span<const Reflection::PushConstantRange> PushConstants() const
+            {
+                return Section<Reflection::PushConstantRange>(Reflection::SectionKind::PushConstants);
+            }
+            [[nodiscard]] std::span<const Reflection::VertexInput> VertexInputs() const
+            {
+                return Section<Reflection::VertexInput>(Reflection::SectionKind::VertexInputs);
+            }
+            [[nodiscard]] std::span<const Reflection::SpecConstant> SpecConstants() const
+            {
+                return Section<Reflection::SpecConstant>(Reflection::SectionKind::SpecConstants);
+            }
+            // SpecId of the specialization constant called name (e.g. a macro passed to CompileOptions::SpecializeMacro)
+            [[nodiscard]] std::optional<uint32_t> SpecConstantId(std::string_view name) const
+            {
+                for(auto& constant : SpecConstants())
+                {
+                    if(Name(constant.name) == name) return constant.id;
+                }
+                return std::nullopt;
+            }
+            [[nodiscard]] std::string_view Name(uint32_t offset) const
+            {
+                auto strings = Section<char>(Reflection::SectionKind::Strings);
+                if(offset >= strings.size()) return {};
+                auto name = std::string_view(strings.data() + offset, strings.size() - offset);
+                return name.substr(0, name.find('\0'));
+            }
+        private:
+            std::span<const Reflection::Section> Sections() const
+            {
+                // FromTrailer checked that the table fits in data, a default constructed view has none
+                if(data.empty()) return {};
+                auto header = reinterpret_cast<const Reflection::Header*>(data.data());
+                return {reinterpret_cast<const Reflection::Section*>(header + 1), header->section_count};
+            }
+            template<typename T>
+            std::span<const T> Section(Reflection::SectionKind kind) const
+            {
+                for(auto& section : Sections())
+                {
+                    if(section.kind == kind && section.stride == sizeof(T))
+                        return {reinterpret_cast<const T*>(data.data() + section.offset), section.count};
+                }
+                return {};
+            }
+            std::span<const char> data;
+        };
+        // Codecs for the compressed variant of shader files, both produce the LZ4 block format and share one decoder
+        enum class ShaderCompression : uint32_t
+        {
+            None,
+            // greedy matching, cheap enough to compress every build
+            LZ4,
+            // exhaustive match search, slower to write but smaller, for shipped files. Loads as fast as LZ4
+            LZ4HC
+        };
+        // Layout of a compressed shader file: a Header followed by the compressed regular file
+        // ([u32 spirv size][spirv][trailer]), all values little endian
+        namespace Compressed
+        {
+            constexpr uint32_t Magic = 0x315a5352; // "RSZ1"
+            struct Header
+            {
+                uint32_t magic;
+                ShaderCompression codec;
+                // size of the regular file, the decompressed output
+                uint64_t size;
+                uint64_t compressed_size;
+            };
+        }
+        // Decompresses a compressed shader file straight into caller provided storage, size() is known from the header
+        // alone so the destination can be allocated once up front
+        class CompressedShaderReader
+        {
+        public:
+            // nullopt unless file starts with a valid header followed by all of the compressed data
+            static std::optional<CompressedShaderReader> FromMemory(std::span<const char> file)
+            {
+                CompressedShaderReader reader;
+                if(file.size() < sizeof(Compressed::Header)) return std::nullopt;
+                std::memcpy(&reader.header, file.data(), sizeof(Compressed::Header));
+                if(!reader.Valid() || reader.header.compressed_size > file.size() - sizeof(Compressed::Header)) return std::nullopt;
+                reader.data = file.subspan(sizeof(Compressed::Header), reader.header.compressed_size);
+                return reader;
+            }
+            // Reads only the header, Read then decodes from the stream as it goes without buffering the compressed data
+            static std::optional<CompressedShaderReader> FromStream(std::istream& stream)
+            {
+                CompressedShaderReader reader;
+                if(!stream.read(reinterpret_cast<char*>(&reader.header), sizeof(Compressed::Header)) || !reader.Valid())
+                    return std::nullopt;
+                reader.stream = &stream;
+                return reader;
+            }
+            [[nodiscard]] uint64_t size() const { return header.size; }
+            [[nodiscard]] ShaderCompression Codec() const { return header.codec; }
+            // dest must be exactly size() bytes, false if the data is corrupt or truncated
+            [[nodiscard]] bool Read(std::span<char> dest)
+            {
+                if(dest.size() != header.size) return false;
+                if(stream)
+                {
+                    return Decode([this](char* out, size_t count)
+                    {
+                        return count == 0 || stream->read(out, count).gcount() == static_cast<std::streamsize>(count);
+                    }, dest);
+                }
+                size_t offset = 0;
+                return Decode([this, &offset](char* out, size_t count)
+                {
+                    if(count > data.size() - offset) return false;
+                    if(count == 0) return true;
+                    std::memcpy(out, data.data() + offset, count);
+                    offset += count;
+                    return true;
+                }, dest);
+            }
+        private:
+            bool Valid() const
+            {
+                return header.magic == Compressed::Magic &&
+                    (header.codec == ShaderCompression::LZ4 || header.codec == ShaderCompression::LZ4HC);
+            }
+            // LZ4 block format, matches are copied from the output already written so no window is kept
+            static bool Decode(auto&& source, std::span<char> dest)
+            {
+                auto length = [&](size_t& value)
+                {
+                    uint8_t byte;
+                    do
+                    {
+                        if(!source(reinterpret_cast<char*>(&byte), 1)) return false;
+                        value += byte;
+                    } while(byte == 255);
+                    return true;
+                };
+                size_t pos = 0;
+                while(true)
+                {
+                    uint8_t token;
+                    if(!source(reinterpret_cast<char*>(&token), 1)) return false;
+                    size_t literals = token >> 4;
+                    if(literals == 15 && !length(literals)) return false;
+                    if(literals > dest.size() - pos || !source(dest.data() + pos, literals)) return false;
+                    pos += literals;
+                    // the last sequence has no match
+                    if(pos == dest.size()) return true;
+                    uint8_t offset_bytes[2];
+                    if(!source(reinterpret_cast<char*>(offset_bytes), 2)) return false;
+                    size_t offset = offset_bytes[0] | size_t(offset_bytes[1]) << 8;
+                    size_t match = token & 15;
+                    if(match == 15 && !length(match)) return false;
+                    match += 4;
+                    if(offset == 0 || offset > pos || match > dest.size() - pos) return false;
+                    // byte by byte, the match may overlap the bytes it produces
+                    for(size_t end = pos + match; pos < end; pos++) dest[pos] = dest[pos - offset];
+                }
+            }
+            Compressed::Header header = {};
+            std::span<const char> data;
+            std::istream* stream = nullptr;
+        };
+        // Owning view of a compiled SPIR-V module, holds on to the backend's result instead of copying it
+        class ShaderBlob
+        {
+        public:
+            ShaderBlob() = default;
+            ShaderBlob(std::shared_ptr<const void> owner, std::span<const uint32_t> code) : owner(std::move(owner)), code(code)
+            {
+            }
+            [[nodiscard]] std::span<const uint32_t> Code() const { return code; }
+            [[nodiscard]] std::span<const char> Bytes() const { return {reinterpret_cast<const char*>(code.data()), code.size_bytes()}; }
+            [[nodiscard]] const uint32_t* data() const { return code.data(); }
+            [[nodiscard]] size_t size() const { return code.size(); }
+            [[nodiscard]] bool empty() const { return code.empty(); }
+            [[nodiscard]] auto begin() const { return code.begin(); }
+            [[nodiscard]] auto end() const { return code.end(); }
+            // The reflection block written to the file trailer, empty unless reflection was enabled
+            [[nodiscard]] std::span<const char> Reflection() const
+            {
+                return reflection ? std::span<const char>(*reflection) : std::span<const char>();
+            }
+            void SetReflection(std::vector<char> data)
+            {
+                reflection = std::make_shared<const std::vector<char>>(std::move(data));
+            }
+        private:
+            std::shared_ptr<const void> owner;
+            std::span<const uint32_t> code;
+            std::shared_ptr<const std::vector<char>> reflection;
+        };
+        // Called once with the size in bytes of the output, returns storage for at least that many bytes or nullptr to abort
+        using OutputAllocator = std::function<void*(size_t size)>;
+        struct MacroDefinition
+        {
+            std::string name;
+            std::optional<std::string> value;
+        };
+        using MacroSet = std::vector<MacroDefinition>;
+        // Canonical name of a macro set used as archive key: sorted by name, "NAME" or "NAME=VALUE" joined by ';'
+        std::string PermutationKey(const MacroSet& macros);
+        // Packs shader files (or any other payload) into one archive, read with ShaderArchive from rhi_sc_archive.h
+        class ArchiveWriter
+        {
+        public:
+            // Adding a name and key again replaces the previous payload
+            void Add(std::string_view name, std::string_view key, std::vector<char> bytes);
+            [[nodiscard]] size_t size() const { return entries.size(); }
+            // Payload bytes Write saves by storing identical payloads once and pointing every entry holding them at that copy
+            [[nodiscard]] uint64_t DuplicateBytes() const;
+            // Written to a temporary file first and renamed over path, so readers never see a partial archive
+            [[nodiscard]] bool Write(const std::filesystem::path& path) const;
+        private:
+            // name and key joined by a zero byte
+            std::map<std::string, std::vector<char>> entries;
+        };
+        // Writes an archive whose entries are known up front while their payloads are still being produced. Payloads go
+        // to disk as they're added, only the index is kept in memory. Identical payloads are stored once, like ArchiveWriter
+        class ArchiveStreamWriter
+        {
+        public:
+            // entries holds the name and key of every payload to come, path is only replaced by Finish
+            ArchiveStreamWriter(const std::filesystem::path& path, std::span<const std::pair<std::string, std::string>> entries);
+            // Removes the partial archive unless Finish succeeded
+            ~ArchiveStreamWriter();
+            ArchiveStreamWriter(const ArchiveStreamWriter&) = delete;
+            ArchiveStreamWriter& operator=(const ArchiveStreamWriter&) = delete;
+            [[nodiscard]] bool Good() const;
+            // Stores the payload of entries[index], not thread safe
+            bool Add(size_t index, std::span<const char> bytes);
+            [[nodiscard]] uint64_t DuplicateBytes() const;
+            // Writes the index and renames the archive over path, fails unless every entry was added
+            [[nodiscard]] bool Finish();
+        private:
+            struct State;
+            std::unique_ptr<State> state;
+        };
+        struct PermutationResult
+        {
+            CompilationResult result;
+            std::vector<char> output;
+            // index of the permutation that was compiled to produce this output, its own unless it was deduplicated
+            size_t compiled_as = 0;
+        };
+        // Options are only read while compiling, once configured one instance can be used by any number of
+        // concurrent compilations. Modifying it while a compilation uses it is a data race
         class CompileOptions {
         protected:
             DECL_CLASS_CONSTRUCTORS(CompileOptions);
         public:
             static std::unique_ptr<CompileOptions> New();
+            [[nodiscard]] std::unique_ptr<CompileOptions> Clone() const;
             void AddMacroDefinition(std::string_view name, std::optional<std::string_view> value);
             void SetOptimizationLevel(OptimizationLevel level);
             void EnableDebuggingSymbols();
+            // Reflects the module at compile time and stores the result in the trailer of the output (see ShaderReflection)
+            void EnableReflection();
+            // Fills CompilationResult::stats. Telling code generation and optimization apart costs an extra unoptimized compile
+            void EnableStatistics();
+            // Fills CompilationResult::cost from the final module, runs on cache hits too
+            void EnableCostAnalysis();
+            // Removes names, source and line information and non-semantic instructions after compiling. Reflection
+            // is taken before stripping, so it keeps its names
+            void StripDebugInfo();
+            // Renumbers the ids of the module densely in a canonical order, identical shaders then produce identical
+            // modules regardless of how the backend numbered them and the output compresses better
+            void RemapIds();
+            // Compresses the file representation written by CompileToFile, CompileToBuffer and CompileToAllocator
+            // (not memory_repr output), read it back with CompressedShaderReader
+            void SetCompression(ShaderCompression codec);
+            // Function the shader starts at, "main" unless set
+            void SetEntryPoint(std::string_view name);
+            // Turns the boolean switch name into a specialization constant instead of a macro, so one module covers
+            // both of its values and the variant is chosen at pipeline creation. The shader has to test it as an
+            // expression (if(name)), testing it with #if, #ifdef or #elif is reported as an error. SpecIds are assigned
+            // in call order from 0 and recorded in the reflection, the default value is false
+            void SpecializeMacro(std::string_view name);
         };
         class ShaderSource
         {
@@ -50,13 +521,168 @@ namespace RHI
             std::variant<std::filesystem::path, StringSource> source;
             ShaderStage stage;
         };
+        // Contents of a source file, text stays valid while owner is alive
+        struct SourceFile
+        {
+            std::string_view text;
+            std::shared_ptr<const void> owner;
+        };
+        // Where a Compiler reads main sources and includes from (see Compiler::SetFileSystem). Includes are looked up by the
+        // path the backend resolves them to, relative to the including file. Open is called from every compiling thread at once
+        class FileSystem
+        {
+        public:
+            virtual ~FileSystem() = default;
+            // nullopt if there is no such file
+            virtual std::optional<SourceFile> Open(const std::filesystem::path& path) = 0;
+            // Files on disk, relative paths are resolved against root. Contents are cached like the include cache
+            static std::shared_ptr<FileSystem> Directory(std::filesystem::path root);
+            // The entries of an archive written by ArchiveWriter, named by generic path with an empty key. The archive is
+            // mapped and sources are read in place, nullptr if it can't be opened
+            static std::shared_ptr<FileSystem> MapArchive(const std::filesystem::path& path);
+        };
+        // Files held in memory, they can be replaced while compilations are running
+        class MemoryFileSystem : public FileSystem
+        {
+        public:
+            static std::shared_ptr<MemoryFileSystem> New();
+            void Write(const std::filesystem::path& path, std::string text);
+            // Serves text without copying it, it has to stay valid while owner is alive
+            void Write(const std::filesystem::path& path, std::string_view text, std::shared_ptr<const void> owner);
+            void Remove(const std::filesystem::path& path);
+            std::optional<SourceFile> Open(const std::filesystem::path& path) override;
+        private:
+            std::mutex mutex;
+            // keyed by the normalized generic path
+            std::map<std::string, SourceFile, std::less<>> files;
+        };
+        // One stage of Compiler::CompilePipeline, every stage has its own options (and so its own entry point)
+        struct PipelineStage
+        {
+            ShaderSource source;
+            std::unique_ptr<CompileOptions> options;
+        };
+        struct PipelineStageResult
+        {
+            CompilationResult result;
+            std::vector<char> output;
+            // locations of the outputs removed because the next stage doesn't read them
+            std::vector<uint32_t> removed_outputs;
+            // locations of the inputs removed because nothing read them
+            std::vector<uint32_t> removed_inputs;
+        };
+        // Queued jobs run highest priority first, in submission order within a priority
+        enum class CompilePriority
+        {
+            Background, Normal, Interactive
+        };
+        // Copies share one flag, cancelling it cancels every job it was passed to (e.g. all jobs of a superseded edit)
+        class CancellationToken
+        {
+        public:
+            CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false))
+            {
+            }
+            void Cancel() { flag->store(true); }
+            [[nodiscard]] bool Cancelled() const { return flag->load(); }
+        private:
+            std::shared_ptr<std::atomic<bool>> flag;
+        };
+        struct AsyncCompileResult
+        {
+            CompilationResult result;
+            std::vector<char> output;
+        };
+        // One finished job of Compiler::CompileBatch
+        struct BatchOutput
+        {
+            size_t index = 0;
+            // the worker that compiled it and when
+            size_t worker = 0;
+            std::chrono::steady_clock::time_point start, end;
+            CompilationResult result;
+            // only valid during the sink call, the buffer is reused for later jobs
+            std::span<const char> output;
+        };
+        // Describes job index for CompileBatch, returning false skips it. Called on the worker taking the job
+        using BatchSource = std::function<bool(size_t index, ShaderSource& source, std::unique_ptr<CompileOptions>& options)>;
+        // Receives the finished jobs one at a time in completion order, on a thread of its own
+        using BatchSink = std::function<void(BatchOutput& output)>;
+        struct BatchSettings
+        {
+            RHI::API api = RHI::API::Vulkan;
+            bool memory_repr = true;
+            uint32_t threads = 1;
+            // bytes of finished outputs waiting for the sink, above it the workers stop taking new jobs. With 0 a worker
+            // waits until the sink has taken every finished output
+            size_t max_memory = size_t(256) << 20;
+        };
+        struct AsyncState;
+        // Handle to a job on the compiler's scheduler. Awaiting it in a coroutine resumes the coroutine on the thread
+        // that completes the job: the worker that ran it, or the one that cancelled it
+        class CompileTask
+        {
+        public:
+            explicit CompileTask(std::shared_ptr<AsyncState> state);
+            [[nodiscard]] bool Ready() const;
+            void Wait() const;
+            [[nodiscard]] bool WaitFor(std::chrono::milliseconds timeout) const;
+            // Waits for the job, the result can only be taken once
+            [[nodiscard]] AsyncCompileResult Get();
+            // Completes the task right away with CompilationError::Cancelled, a queued job is then skipped and a running
+            // one discarded. Jobs cancelled through their CancellationToken complete once the scheduler reaches them
+            void Cancel();
+            bool await_ready() const { return Ready(); }
+            bool await_suspend(std::coroutine_handle<> handle);
+            AsyncCompileResult await_resume() { return Get(); }
+        private:
+            std::shared_ptr<AsyncState> state;
+        };
+        // Every Compile* call and the include cache functions can be used concurrently on one Compiler, backend
+        // compilers are created lazily for each calling thread. SetCacheDirectory must not race with compilations
         class Compiler {
         protected:
             DECL_CLASS_CONSTRUCTORS(Compiler);
         public:
             static std::unique_ptr<Compiler> New();
+            // Identifies the backend the library was built with ("shaderc" or "dxc")
+            static std::string_view BackendName();
+            // Compiled shaders are stored in and served from this directory, keyed on the preprocessed source and options
+            void SetCacheDirectory(std::optional<std::filesystem::path> directory);
+            // Sources and includes are kept in memory between compilations and revalidated by modification time and size on use
+            void PrewarmIncludeCache(std::span<const std::filesystem::path> files);
+            void InvalidateIncludeCache();
+            void InvalidateIncludeCache(const std::filesystem::path& file);
+            // Main sources and includes are read through files instead of from disk, nullptr goes back to disk. The include
+            // cache functions only concern disk. Must not race with compilations
+            void SetFileSystem(std::shared_ptr<FileSystem> files);
             [[nodiscard]] CompilationResult CompileToFile(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const std::filesystem::path& output);
             [[nodiscard]] CompilationResult CompileToBuffer(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::vector<char>& output, bool memory_repr=true);
+            // The blob is the backend's own output (or cache entry), no copy is made
+            [[nodiscard]] CompilationResult CompileToBlob(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, ShaderBlob& output);
+            // Writes the output straight into storage handed out by allocator (e.g. an arena or upload buffer)
+            [[nodiscard]] CompilationResult CompileToAllocator(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const OutputAllocator& allocator, bool memory_repr=true);
+            // Number of scheduler threads CompileAsync uses, takes effect if called before the first CompileAsync.
+            // Defaults to the hardware concurrency
+            void SetAsyncWorkerCount(uint32_t count);
+            // Queues the compilation and returns immediately, source (including string sources) and options are copied
+            [[nodiscard]] CompileTask CompileAsync(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, CompilePriority priority = CompilePriority::Normal, std::optional<CancellationToken> token = std::nullopt, bool memory_repr=true);
+            // Runs only the preprocessor, output receives the source with includes and macros expanded
+            [[nodiscard]] CompilationResult Preprocess(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::string& output);
+            // Compiles source once per macro set (added on top of base_options), the source and its includes are only read once.
+            // Every permutation is preprocessed first and permutations with the same preprocessed text are only compiled
+            // once, unless debug info (which records the macros) is enabled. Results are in the same order as permutations
+            [[nodiscard]] std::vector<PermutationResult> CompilePermutations(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& base_options, std::span<const MacroSet> permutations, uint32_t num_threads = 1, bool memory_repr=true);
+            // Compiles the jobs 0 to count - 1 on settings.threads workers (the calling thread being one of them) and hands every
+            // result to sink as soon as it's done, nothing of a job is kept once the sink returns. Outputs are compiled into
+            // recycled buffers and workers wait while the outputs queued for the sink exceed settings.max_memory, so memory
+            // stays flat however many jobs there are
+            void CompileBatch(size_t count, const BatchSource& source, const BatchSink& sink, const BatchSettings& settings = {});
+            // Compiles the vertex, hull, domain, geometry and pixel stages of one pipeline (any subset, in any order) and links
+            // them: outputs the next stage doesn't read are removed with the code computing them, and inputs a stage reads
+            // but the previous one doesn't write, or reads with another type, fail that stage. The inputs of the first stage
+            // and the outputs of the last one are left alone, so the reflection stays valid. Results are in the order of stages
+            [[nodiscard]] std::vector<PipelineStageResult> CompilePipeline(RHI::API api, std::span<const PipelineStage> stages, bool memory_repr=true);
         };
     }
 }
@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#ifdef _WIN32
+// keeps std::min and std::max usable in the code including this header
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Archive layout (little endian):
+        //   [Header][u32 fanout[256]][Entry entries[entry_count]][names][padding][payloads]
+        // Entries are sorted by hash, fanout[b] is the number of entries whose hash' top byte is <= b.
+        // Every payload starts on an ArchiveAlignment boundary, shader payloads are the regular file
+        // representation ([u32 spirv size][spirv][trailer]) or its compressed variant (see CompressedShaderReader).
+        // Entries with identical payloads may share one offset.
+        namespace Archive
+        {
+            constexpr uint32_t Magic = 0x31415352; // "RSA1"
+            constexpr uint32_t Version = 1;
+            constexpr uint64_t Alignment = 4096;
+            struct Header
+            {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t entry_count;
+                uint32_t reserved;
+                uint64_t names_offset;
+                uint64_t names_size;
+            };
+            struct Entry
+            {
+                uint64_t hash;
+                uint64_t offset;
+                uint64_t size;
+                uint32_t name_offset;
+                uint32_t name_size;
+            };
+            constexpr uint64_t IndexOffset = sizeof(Header) + sizeof(uint32_t) * 256;
+            // FNV-1a over name, a zero byte and the permutation key, the stored name uses the same separator
+            constexpr uint64_t Hash(std::string_view name, std::string_view key)
+            {
+                uint64_t hash = 0xcbf29ce484222325;
+                auto feed = [&hash](char c) { hash = (hash ^ uint8_t(c)) * 0x100000001b3; };
+                for(char c : name) feed(c);
+                feed('\0');
+                for(char c : key) feed(c);
+                return hash;
+            }
+        }
+        class ArchiveEntry
+        {
+        public:
+            ArchiveEntry(std::span<const char> bytes) : bytes(bytes) {}
+            // the payload exactly as it was added
+            [[nodiscard]] std::span<const char> Bytes() const { return bytes; }
+            // the SPIR-V of an uncompressed shader payload, empty if the payload isn't one
+            [[nodiscard]] std::span<const uint32_t> Code() const
+            {
+                uint32_t size;
+                if(bytes.size() < sizeof(uint32_t)) return {};
+                std::memcpy(&size, bytes.data(), sizeof(uint32_t));
+                if(size % sizeof(uint32_t) || size > bytes.size() - sizeof(uint32_t)) return {};
+                return {reinterpret_cast<const uint32_t*>(bytes.data() + sizeof(uint32_t)), size / sizeof(uint32_t)};
+            }
+            // the reflection (or zero) trailer of a shader payload
+            [[nodiscard]] std::span<const char> Trailer() const
+            {
+                auto code = Code();
+                if(code.empty()) return {};
+                return bytes.subspan(sizeof(uint32_t) + code.size_bytes());
+            }
+        private:
+            std::span<const char> bytes;
+        };
+        // Read only view of a shader archive. Open() maps the file, nothing is copied and lookups touch the fanout
+        // table and a handful of index entries.
+        class ShaderArchive
+        {
+        public:
+            ShaderArchive() = default;
+            ShaderArchive(const ShaderArchive&) = delete;
+            ShaderArchive& operator=(const ShaderArchive&) = delete;
+            ShaderArchive(ShaderArchive&& other) noexcept
+            {
+                *this = std::move(other);
+            }
+            ShaderArchive& operator=(ShaderArchive&& other) noexcept
+            {
+                std::swap(data, other.data);
+                std::swap(mapping, other.mapping);
+                return *this;
+            }
+            ~ShaderArchive()
+            {
+                Unmap();
+            }
+            static std::optional<ShaderArchive> Open(const std::filesystem::path& path)
+            {
+                ShaderArchive archive;
+#ifdef _WIN32
+                HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if(file == INVALID_HANDLE_VALUE) return std::nullopt;
+                LARGE_INTEGER size;
+                HANDLE map = nullptr;
+                if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+                    map = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                CloseHandle(file);
+                if(!map) return std::nullopt;
+                void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(map);
+                if(!view) return std::nullopt;
+                archive.mapping = {view, size_t(size.QuadPart)};
+#else
+                int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0) return std::nullopt;
+                struct stat st;
+                void* view = MAP_FAILED;
+                if(fstat(fd, &st) == 0 && st.st_size > 0)
+                    view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if(view == MAP_FAILED) return std::nullopt;
+                archive.mapping = {view, size_t(st.st_size)};
+#endif
+                archive.data = {static_cast<const char*>(archive.mapping.first), archive.mapping.second};
+                if(!archive.Validate()) return std::nullopt;
+                return archive;
+            }
+            // View over an archive already in memory (embedded in the executable, read by the caller...), the memory
+            // must be 8 byte aligned and outlive the view
+            static std::optional<ShaderArchive> FromMemory(std::span<const char> bytes)
+            {
+                ShaderArchive archive;
+                archive.data = bytes;
+                if(!archive.Validate()) return std::nullopt;
+                return archive;
+            }
+            [[nodiscard]] std::optional<ArchiveEntry> Find(std::string_view name, std::string_view key = {}) const
+            {
+                // default constructed or moved from
+                if(data.empty()) return std::nullopt;
+                uint64_t hash = Archive::Hash(name, key);
+                auto fanout = Fanout();
+                uint32_t bucket = hash >> 56;
+                auto entries = Entries();
+                auto first = entries.begin() + (bucket ? fanout[bucket - 1] : 0);
+                auto last = entries.begin() + fanout[bucket];
+                first = std::lower_bound(first, last, hash, [](const Archive::Entry& e, uint64_t h) { return e.hash < h; });
+                for(; first != last && first->hash == hash; ++first)
+                {
+                    auto stored = Name(*first);
+                    if(stored.size() == name.size() + 1 + key.size() && stored.starts_with(name) &&
+                        stored[name.size()] == '\0' && stored.ends_with(key))
+                    {
+                        return ArchiveEntry(data.subspan(first->offset, first->size));
+                    }
+                }
+                return std::nullopt;
+            }
+            [[nodiscard]] size_t size() const
+            {
+                return Entries().size();
+            }
+            // entries in index order, name and key are split at the stored separator
+            [[nodiscard]] std::pair<std::string_view, std::string_view> EntryName(size_t i) const
+            {
+                auto name = Name(Entries()[i]);
+                auto separator = name.find('\0');
+                return {name.substr(0, separator), name.substr(separator + 1)};
+            }
+            [[nodiscard]] ArchiveEntry Entry(size_t i) const
+            {
+                auto& entry = Entries()[i];
+                return ArchiveEntry(data.subspan(entry.offset, entry.size));
+            }
+        private:
+            const Archive::Header& Header() const
+            {
+                return *reinterpret_cast<const Archive::Header*>(data.data());
+            }
+            std::span<const uint32_t> Fanout() const
+            {
+                return {reinterpret_cast<const uint32_t*>(data.data() + sizeof(Archive::Header)), 256};
+            }
+            std::span<const Archive::Entry> Entries() const
+            {
+                if(data.empty()) return {};
+                return {reinterpret_cast<const Archive::Entry*>(data.data() + Archive::IndexOffset), Header().entry_count};
+            }
+            std::string_view Name(const Archive::Entry& entry) const
+            {
+                return {data.data() + Header().names_offset + entry.name_offset, entry.name_size};
+            }
+            // bounds are checked once here so lookups don't have to
+            bool Validate() const
+            {
+                if(data.size() < Archive::IndexOffset || reinterpret_cast<uintptr_t>(data.data()) % alignof(Archive::Entry)) return false;
+                auto& header = Header();
+                if(header.magic != Archive::Magic || header.version != Archive::Version) return false;
+                if((data.size() - Archive::IndexOffset) / sizeof(Archive::Entry) < header.entry_count) return false;
+                if(header.names_offset > data.size() || header.names_size > data.size() - header.names_offset) return false;
+                auto fanout = Fanout();
+                for(uint32_t i = 0; i < 256; i++)
+                {
+                    if(fanout[i] > header.entry_count || (i && fanout[i] < fanout[i - 1])) return false;
+                }
+                if(fanout[255] != header.entry_count) return false;
+                auto entries = Entries();
+                for(size_t i = 0; i < entries.size(); i++)
+                {
+                    auto& entry = entries[i];
+                    if(i && entry.hash < entries[i - 1].hash) return false;
+                    if(entry.offset > data.size() || entry.size > data.size() - entry.offset) return false;
+                    if(entry.name_offset > header.names_size || entry.name_size > header.names_size - entry.name_offset) return false;
+                }
+                return true;
+            }
+            void Unmap()
+            {
+                if(!mapping.first) return;
+#ifdef _WIN32
+                UnmapViewOfFile(mapping.first);
+#else
+                munmap(mapping.first, mapping.second);
+#endif
+                mapping = {nullptr, 0};
+            }
+            std::span<const char> data;
+            std::pair<void*, size_t> mapping = {nullptr, 0};
+        };
+    }
+}
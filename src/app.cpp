@@ -1,11 +1,19 @@
 #include "RootSignature.h"
+#include "build.h"
+#include "manifest.h"
 #include "rhi_sc.h"
+#include "server.h"
 #include <argparse/argparse.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cctype>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <string>
 #include <ranges>
 #include <string_view>
+#include <vector>
 RHI::ShaderCompiler::OptimizationLevel GetOptimizationLevel(const argparse::ArgumentParser& parser)
 {
     if(parser["-ONone"] == true)
@@ -32,95 +40,322 @@ RHI::ShaderCompiler::OptimizationLevel GetOptimizationLevel(const argparse::Argu
 }
 RHI::ShaderStage GetShaderStage(const argparse::ArgumentParser& parser)
 {
-    auto stg = parser.get("-t");
-    std::ranges::transform(stg, stg.begin(),
-                           [](const unsigned char c){ return std::tolower(c); });
-    if (stg == "pixel")
-        return RHI::ShaderStage::Pixel;
-    else if (stg == "vertex")
-        return RHI::ShaderStage::Vertex;
-    else if (stg == "compute")
-        return RHI::ShaderStage::Compute;
-    else if (stg == "hull")
-        return RHI::ShaderStage::Hull;
-    else if (stg == "domain")
-        return RHI::ShaderStage::Domain;
-    else if (stg == "geometry")
-        return RHI::ShaderStage::Geometry;
-    else
-        return RHI::ShaderStage::None;
+    return RHI::ShaderCompiler::ParseShaderStage(parser.get("-t"));
 }
-void AddMacroDefns(argparse::ArgumentParser& parser, const std::unique_ptr<RHI::ShaderCompiler::CompileOptions>& args)
+RHI::ShaderCompiler::MacroSet GetMacroDefns(argparse::ArgumentParser& parser)
 {
+    RHI::ShaderCompiler::MacroSet set;
     for(auto macros = parser.get<std::vector<std::string>>("-D"); auto& macro : macros)
     {
         if(const auto name = macro.find('='); name == std::string::npos)
         {
             std::cout << "name = " << macro << std::endl;
-            args->AddMacroDefinition(macro, std::nullopt);
+            set.push_back({macro, std::nullopt});
         }
         else {
-            const auto mac_name = std::string_view(macro.data(), name);
-            auto mac_value = std::string_view(macro.data() + name + 1, macro.size() - name -1);
-            args->AddMacroDefinition(mac_name, mac_value);
+            set.push_back({macro.substr(0, name), macro.substr(name + 1)});
         }
     }
+    return set;
 }
-int main(int argc, char** argv) 
+// A byte count with an optional K, M or G suffix
+std::optional<size_t> ParseSize(std::string_view text)
+{
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if(ec != std::errc() || end == text.data()) return std::nullopt;
+    std::string_view suffix(end, text.data() + text.size());
+    if(suffix.empty()) return value;
+    if(suffix.size() != 1) return std::nullopt;
+    switch(std::toupper(static_cast<unsigned char>(suffix[0])))
+    {
+        case 'K': return value << 10;
+        case 'M': return value << 20;
+        case 'G': return value << 30;
+        default: return std::nullopt;
+    }
+}
+void AddArguments(argparse::ArgumentParser& parser)
 {
-    argparse::ArgumentParser parser("rhi_sc");
     parser.add_description("Shader Compiler For Pistachio's RHI");
     parser.add_argument("-i", "--inputs")
-        .required()
         .nargs(argparse::nargs_pattern::at_least_one)
         .help("The HLSL source files (-i {FILENAMES})");
     parser.add_argument("-o", "--outputs")
-        .required()
         .nargs(argparse::nargs_pattern::at_least_one)
         .help("Output Filename (-o {FILENAMES})");
     parser.add_argument("-t", "--target")
-        .required()
         .help("Target Shader Stage (-t [pixel | vertex | compute | hull | domain | geometry ] - case insensitive)");
     parser.add_argument("-g", "--embed-debug")
         .flag()
         .help("Embed Debug Info");
+    parser.add_argument("--reflect")
+        .flag()
+        .help("Store the bindings, push constants, vertex inputs and workgroup size in the output trailer");
+    parser.add_argument("--strip")
+        .flag()
+        .help("Remove names, source and line information and non-semantic instructions from the output");
+    parser.add_argument("--remap-ids")
+        .flag()
+        .help("Renumber the ids of the output canonically, so equal shaders produce equal modules that compress well");
+    parser.add_argument("--compress")
+        .choices("lz4", "lz4hc")
+        .help("Write compressed shader files, lz4 for fast builds or lz4hc for smaller shipped files (--compress [lz4 | lz4hc])");
     parser.add_argument("-D")
         .help("Define Macro (-D name or -D name=value)")
         .append();
+    parser.add_argument("--specialize")
+        .help("Compile the boolean macro as a specialization constant instead, one output covers both values (--specialize name)")
+        .append();
     auto& grp = parser.add_mutually_exclusive_group();
     grp.add_argument("-ONone").flag().help("Disable Optimization");
     grp.add_argument("-O1").flag().help("Optimization Level 1");
     grp.add_argument("-O2").flag().help("Optimization Level 2");
     grp.add_argument("-O3").flag().help("Optimization Level 3");
     grp.add_argument("-OFast").flag().help("Same as -O3");
-    parser.parse_args(argc, argv);
-    const auto args = RHI::ShaderCompiler::CompileOptions::New();
-    if (parser["-g"] == true)
+    parser.add_argument("-j", "--jobs")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Number of worker threads used to compile the inputs (-j 0 uses every hardware thread)");
+    parser.add_argument("--cache-dir")
+        .help("Reuse compiled shaders stored in this directory and store new ones in it");
+    parser.add_argument("--serve")
+        .flag()
+        .help("Run as a compile server answering framed requests on stdin/stdout (or on --socket)");
+    parser.add_argument("--socket")
+        .help("Unix domain socket used by --serve and --connect");
+    parser.add_argument("--connect")
+        .flag()
+        .help("Submit the inputs to the compile server listening on --socket instead of compiling them in process");
+    parser.add_argument("-MD")
+        .flag()
+        .help("Write a Makefile style depfile listing the sources and includes of every output (<output>.d unless -MF is given)");
+    parser.add_argument("-MF")
+        .help("Write the rules of every output to this depfile");
+    parser.add_argument("--incremental")
+        .flag()
+        .help("Skip inputs whose output was built with the same options from unchanged sources and includes");
+    parser.add_argument("--time-report")
+        .flag()
+        .help("Print the time spent per compile phase over all inputs and the slowest inputs");
+    parser.add_argument("--trace")
+        .help("Write a Chrome trace (chrome://tracing or Perfetto) of every input and its compile phases to this file");
+    parser.add_argument("--manifest")
+        .help("Build the jobs and permutations listed in this JSON file instead of the -i/-o lists (see src/manifest.h)");
+    parser.add_argument("-E", "--entry")
+        .default_value(std::string("main"))
+        .help("Entry point function of the inputs");
+    parser.add_argument("--dedupe")
+        .flag()
+        .help("Preprocess every input first and compile inputs with the same preprocessed text and options only once");
+    parser.add_argument("--archive")
+        .help("Pack every output into this archive instead of writing one file per input, -o then names the entries (the inputs if omitted)");
+    parser.add_argument("--watch")
+        .flag()
+        .help("After building, keep running and recompile the outputs whose sources or includes change, replacing them atomically");
+    parser.add_argument("--debounce")
+        .default_value(50)
+        .scan<'i', int>()
+        .help("Milliseconds --watch waits for further changes before recompiling, so a burst of saves is built once");
+    parser.add_argument("--pipeline")
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("Compile these stages as one pipeline and remove the outputs the next stage doesn't read, -o names one output per stage (--pipeline vertex:VSMain=mesh.hlsl pixel:PSMain=mesh.hlsl)");
+    parser.add_argument("--max-memory")
+        .help("Stream every output to disk as soon as it's compiled, keeping at most this many bytes of outputs in flight (--max-memory 256M)");
+    parser.add_argument("--cost-report")
+        .help("Write the instruction mix, register pressure, loops and descriptors of every compiled entry point to this JSON file");
+    parser.add_argument("--cost-baseline")
+        .help("Fail if an entry point costs more than in this earlier --cost-report, outputs it doesn't list pass");
+    parser.add_argument("--cost-tolerance")
+        .default_value(5.0)
+        .scan<'g', double>()
+        .help("Percentage a metric may grow over --cost-baseline before the build fails");
+}
+// One job per --pipeline STAGE[:ENTRY]=FILE, the file may contain anything after the first '='
+bool PipelineJobs(argparse::ArgumentParser& parser, std::vector<RHI::ShaderCompiler::BuildJob>& jobs)
+{
+    const auto stages = parser.get<std::vector<std::string>>("--pipeline");
+    const auto outputs = parser.is_used("-o") ? parser.get<std::vector<std::string>>("-o") : std::vector<std::string>();
+    if(stages.size() != outputs.size())
     {
-        args->EnableDebuggingSymbols();
+        std::cerr << "--pipeline needs one -o output per stage" << std::endl;
+        return false;
     }
-    AddMacroDefns(parser, args);
-    args->SetOptimizationLevel(GetOptimizationLevel(parser));
-    const auto out_files = parser.get<std::vector<std::string>>("-o");
-    const auto names = parser.get<std::vector<std::string>>("-i");
-    if(names.size() != out_files.size())
+    for(const auto i : std::views::iota(static_cast<size_t>(0), stages.size()))
+    {
+        const auto& spec = stages[i];
+        const auto file = spec.find('=');
+        const auto entry = spec.substr(0, file).find(':');
+        auto& job = jobs.emplace_back();
+        job.stage = RHI::ShaderCompiler::ParseShaderStage(spec.substr(0, std::min(file, entry)));
+        if(file == std::string::npos || job.stage == RHI::ShaderStage::None)
+        {
+            std::cerr << "--pipeline takes STAGE=FILE or STAGE:ENTRY=FILE, not " << spec << std::endl;
+            return false;
+        }
+        job.input = spec.substr(file + 1);
+        job.output = outputs[i];
+        job.entry = entry == std::string::npos ? parser.get("--entry") : spec.substr(entry + 1, file - entry - 1);
+        job.level = GetOptimizationLevel(parser);
+        job.debug = parser["-g"] == true;
+        job.reflect = parser["--reflect"] == true;
+        job.macros = GetMacroDefns(parser);
+        job.specialize = parser.get<std::vector<std::string>>("--specialize");
+    }
+    return true;
+}
+// One job per -i/-o pair, every input of the command line shares the same options
+bool CommandLineJobs(argparse::ArgumentParser& parser, std::vector<RHI::ShaderCompiler::BuildJob>& jobs)
+{
+    const auto macros = GetMacroDefns(parser);
+    const auto inputs = parser.get<std::vector<std::string>>("-i");
+    const auto outputs = parser.is_used("-o") ? parser.get<std::vector<std::string>>("-o") : inputs;
+    if(inputs.size() != outputs.size())
     {
         std::cerr << "Input and Output files must be the same length" << std::endl;
+        return false;
+    }
+    for(const auto i : std::views::iota(static_cast<size_t>(0), inputs.size()))
+    {
+        auto& job = jobs.emplace_back();
+        job.input = inputs[i];
+        job.output = outputs[i];
+        job.stage = GetShaderStage(parser);
+        job.entry = parser.get("--entry");
+        job.level = GetOptimizationLevel(parser);
+        job.debug = parser["-g"] == true;
+        job.reflect = parser["--reflect"] == true;
+        job.macros = macros;
+        job.specialize = parser.get<std::vector<std::string>>("--specialize");
+        job.variant = RHI::ShaderCompiler::PermutationKey(macros);
+    }
+    return true;
+}
+int main(int argc, char** argv) 
+{
+    argparse::ArgumentParser parser("rhi_sc");
+    AddArguments(parser);
+    parser.parse_args(argc, argv);
+    const auto cache_dir = parser.present("--cache-dir");
+    if(parser["--serve"] == true)
+    {
+        RHI::ShaderCompiler::CompilerPool pool(cache_dir ? std::optional<std::filesystem::path>(*cache_dir) : std::nullopt);
+        if(const auto socket = parser.present("--socket"))
+        {
+            std::cerr << RHI::ShaderCompiler::ServeSocket(*socket, pool) << std::endl;
+            return 1;
+        }
+        RHI::ShaderCompiler::Serve(*RHI::ShaderCompiler::StdioChannel(), pool);
+        return 0;
+    }
+    const auto manifest_path = parser.present("--manifest");
+    RHI::ShaderCompiler::Manifest manifest;
+    if(manifest_path)
+    {
+        std::string error;
+        if(!RHI::ShaderCompiler::LoadManifest(*manifest_path, manifest, error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    auto archive = parser.present("--archive");
+    if(!archive && manifest.archive) archive = manifest.archive->string();
+    const bool pipeline = parser.is_used("--pipeline");
+    const bool connect = parser["--connect"] == true;
+    const bool dedupe = parser["--dedupe"] == true;
+    const bool watch = parser["--watch"] == true;
+    if(pipeline && (manifest_path || archive || parser.is_used("-i") || watch || dedupe || connect ||
+        parser["--incremental"] == true || parser.is_used("--max-memory")))
+    {
+        std::cerr << "--pipeline can't be combined with --manifest, -i, --archive, --watch, --dedupe, --connect, --incremental or --max-memory" << std::endl;
+        return 1;
+    }
+    if(!manifest_path && !pipeline && (!parser.is_used("-i") || (!parser.is_used("-o") && !archive) || !parser.is_used("-t")))
+    {
+        std::cerr << "-i, -o and -t are required unless a --manifest is given" << std::endl;
+        return 1;
+    }
+    const auto cost_report = parser.present("--cost-report");
+    const auto cost_baseline = parser.present("--cost-baseline");
+    if((cost_report || cost_baseline) && connect)
+    {
+        std::cerr << "--cost-report and --cost-baseline can't be combined with --connect" << std::endl;
+        return 1;
+    }
+    if(parser.get<double>("--cost-tolerance") < 0)
+    {
+        std::cerr << "--cost-tolerance takes a percentage of 0 or more" << std::endl;
         return 1;
     }
-    size_t num_files = names.size();
-    const auto cmp = RHI::ShaderCompiler::Compiler::New();
-    for(const auto i : std::views::iota(static_cast<decltype(num_files)>(0), num_files))
+    const auto socket = parser.present("--socket");
+    if(connect && !socket)
     {
-        RHI::ShaderCompiler::ShaderSource src;
-        src.source = std::filesystem::path(names[i]);
-        src.stage = GetShaderStage(parser);
-        if (const auto [warning_count, messages, error] = cmp->CompileToFile(src, args, out_files[i]); error != RHI::ShaderCompiler::CompilationError::None)
+        std::cerr << "--connect requires --socket" << std::endl;
+        return 1;
+    }
+    if(dedupe && connect)
+    {
+        std::cerr << "--dedupe can't be combined with --connect" << std::endl;
+        return 1;
+    }
+    if(watch && (archive || dedupe || connect))
+    {
+        std::cerr << "--watch can't be combined with --archive, --dedupe or --connect" << std::endl;
+        return 1;
+    }
+    std::optional<size_t> max_memory;
+    if(const auto size = parser.present("--max-memory"))
+    {
+        max_memory = ParseSize(*size);
+        if(!max_memory || *max_memory == 0)
         {
-            std::cerr << messages;
+            std::cerr << "--max-memory takes a size in bytes with an optional K, M or G suffix" << std::endl;
             return 1;
         }
+        if(dedupe || watch || connect)
+        {
+            std::cerr << "--max-memory can't be combined with --dedupe, --watch or --connect" << std::endl;
+            return 1;
+        }
+    }
+
+    RHI::ShaderCompiler::BuildSettings settings;
+    settings.strip = parser["--strip"] == true;
+    settings.remap = parser["--remap-ids"] == true;
+    if(const auto codec = parser.present("--compress"))
+        settings.compression = *codec == "lz4hc" ? RHI::ShaderCompiler::ShaderCompression::LZ4HC : RHI::ShaderCompiler::ShaderCompression::LZ4;
+    settings.time_report = parser["--time-report"] == true;
+    if(const auto trace = parser.present("--trace")) settings.trace = *trace;
+    if(cost_report || cost_baseline)
+    {
+        auto& cost = settings.cost.emplace();
+        if(cost_report) cost.report = *cost_report;
+        if(cost_baseline) cost.baseline = *cost_baseline;
+        cost.tolerance = parser.get<double>("--cost-tolerance");
     }
-    
-    return 0;
-}
\ No newline at end of file
+    if(cache_dir) settings.cache_dir = *cache_dir;
+    settings.workers = std::max(parser.get<int>("-j"), 0);
+    settings.incremental = parser["--incremental"] == true;
+    settings.depfiles = parser["-MD"] == true;
+    if(const auto depfile = parser.present("-MF")) settings.depfile = *depfile;
+    if(manifest_path)
+    {
+        settings.manifest = *manifest_path;
+        settings.manifest_jobs = manifest.job_count;
+    }
+    if(archive) settings.archive = *archive;
+    if(connect) settings.connect = *socket;
+    settings.dedupe = dedupe;
+    settings.max_memory = max_memory;
+    settings.watch = watch;
+    settings.debounce = std::chrono::milliseconds(std::max(parser.get<int>("--debounce"), 0));
+
+    // manifest jobs bring their own options
+    std::vector<RHI::ShaderCompiler::BuildJob> jobs = std::move(manifest.jobs);
+    if(pipeline)
+        return PipelineJobs(parser, jobs) ? RHI::ShaderCompiler::RunPipeline(jobs, settings) : 1;
+    if(!manifest_path && !CommandLineJobs(parser, jobs))
+        return 1;
+    return RHI::ShaderCompiler::RunBuild(jobs, settings);
+}
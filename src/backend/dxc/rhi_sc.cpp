@@ -3,34 +3,95 @@
 #include "RootSignature.h"
 #include "WinAdapter.h"
 #include "dxcapi.h"
+#include "src/common/backend.h"
+#include "src/common/include_cache.h"
+#include "src/common/per_thread.h"
 #include <algorithm>
+#include <atomic>
 #include <bit>
 #include <filesystem>
 #include <fstream>
 #include <iterator>
 #include <memory>
 #include <span>
+#include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 namespace RHI
 {
     namespace ShaderCompiler
     {
-        std::wstring to_wstring(const std::string& stringToConvert)
+        // Decodes UTF-8 into out, which needs room for text.size() + 1 characters, and returns the length written.
+        // wchar_t is UTF-16 on windows and UTF-32 elsewhere, malformed sequences become U+FFFD
+        size_t DecodeUtf8(std::string_view text, wchar_t* out)
         {
-            std::wstring wideString = 
-                std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(stringToConvert);
-            return wideString;
+            static constexpr uint32_t MinCodePoint[] = {0, 0, 0x80, 0x800, 0x10000};
+            size_t count = 0;
+            for(size_t i = 0; i < text.size();)
+            {
+                auto lead = static_cast<unsigned char>(text[i]);
+                uint32_t cp = lead;
+                size_t length = 0;
+                if(lead < 0x80) length = 1;
+                else if((lead & 0xE0) == 0xC0) { cp = lead & 0x1F; length = 2; }
+                else if((lead & 0xF0) == 0xE0) { cp = lead & 0x0F; length = 3; }
+                else if((lead & 0xF8) == 0xF0) { cp = lead & 0x07; length = 4; }
+                bool valid = length && i + length <= text.size();
+                for(size_t k = 1; valid && k < length; k++)
+                {
+                    auto next = static_cast<unsigned char>(text[i + k]);
+                    valid = (next & 0xC0) == 0x80;
+                    cp = cp << 6 | (next & 0x3F);
+                }
+                // overlong forms, surrogates and anything past the last code point
+                if(valid && (cp < MinCodePoint[length] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))) valid = false;
+                if(!valid)
+                {
+                    out[count++] = 0xFFFD;
+                    i++;
+                    continue;
+                }
+                i += length;
+                if constexpr(sizeof(wchar_t) == 2)
+                {
+                    if(cp >= 0x10000)
+                    {
+                        cp -= 0x10000;
+                        out[count++] = static_cast<wchar_t>(0xD800 + (cp >> 10));
+                        out[count++] = static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+                        continue;
+                    }
+                }
+                out[count++] = static_cast<wchar_t>(cp);
+            }
+            out[count] = 0;
+            return count;
         }
+        std::wstring to_wstring(std::string_view text)
+        {
+            // the terminator DecodeUtf8 writes lands on the string's own
+            std::wstring wide(text.size(), L'\0');
+            wide.resize(DecodeUtf8(text, wide.data()));
+            return wide;
+        }
+        // Holds the option dependent part of the command line, rendered by every setter so compiling only reads it
         class DXCCompileOptions : public CompileOptions
         {
         public:
-            bool debug;
-            OptimizationLevel level;
-            std::vector<std::wstring> macros;
+            OptionsState state;
+            std::vector<std::wstring> args;
+            std::vector<const wchar_t*> raw;
             DXCCompileOptions()
             {
+                Render();
+            }
+            // raw points into args, so copies render their own
+            DXCCompileOptions(const DXCCompileOptions& other) : state(other.state)
+            {
+                Render();
             }
-            std::wstring StageToString(RHI::ShaderStage stg) const
+            static const wchar_t* StageToString(RHI::ShaderStage stg)
             {
                 switch (stg)
                 {
@@ -44,9 +105,9 @@ namespace RHI
                     default: return L"";
                 }
             }
-            std::wstring OptimizationToString() const
+            const wchar_t* OptimizationToString() const
             {
-                switch (level)
+                switch (state.level)
                 {
                     using enum OptimizationLevel;
                     case None: return L"-Od";
@@ -56,50 +117,205 @@ namespace RHI
                     default: return L"";
                 }
             }
-            std::vector<std::wstring> AsArgs(RHI::ShaderStage stg) const
+            void Render()
             {
-                std::vector<std::wstring> args = {};
-                args.emplace_back(L"-T");
-                args.emplace_back(StageToString(stg));
-                if(debug)
+                args.clear();
+                args.emplace_back(L"-E");
+                args.emplace_back(to_wstring(state.entry));
+                if(state.debug)
                 {
                     args.emplace_back(L"-Zi");
                     args.emplace_back(L"-Qembed_debug");
                 }
                 args.emplace_back(OptimizationToString());
-                for(auto& macro: macros)
+                for(auto& [name, value] : state.macros)
                 {
                     args.emplace_back(L"-D");
-                    args.emplace_back(macro.data());
+                    auto& macro = args.emplace_back(to_wstring(name));
+                    if(value)
+                    {
+                        macro += L'=';
+                        macro += to_wstring(*value);
+                    }
                 }
-                args.push_back(L"-spirv");
+                args.emplace_back(L"-spirv");
+                raw.clear();
+                for(auto& arg : args)
+                    raw.push_back(arg.c_str());
+            }
+        };
+        // The full command line of one compilation, the per compilation arguments (stage, file name) are kept inline
+        // so building it doesn't allocate unless there are a lot of macros or the file name is unusually long
+        class DXCCommandLine
+        {
+        public:
+            DXCCommandLine(const DXCCompileOptions& opt, const ShaderSource& source, bool preprocess)
+            {
+                size_t count = opt.raw.size() + 4;
+                if(count > InlineArgs) heap_args.resize(count);
+                args = count > InlineArgs ? heap_args.data() : inline_args;
+                args[size++] = L"-T";
+                args[size++] = DXCCompileOptions::StageToString(source.stage);
+                for(auto arg : opt.raw)
+                    args[size++] = arg;
+                // the source name lets dxc resolve includes relative to the main file
+                if(std::holds_alternative<std::filesystem::path>(source.source))
+                    args[size++] = Name(std::get<std::filesystem::path>(source.source).native());
+                else if(auto& str = std::get<ShaderSource::StringSource>(source.source); !str.filename.empty())
+                    args[size++] = Name(str.filename);
+                if(preprocess) args[size++] = L"-P";
+            }
+            DXCCommandLine(const DXCCommandLine&) = delete;
+            DXCCommandLine& operator=(const DXCCommandLine&) = delete;
+            const wchar_t** Args()
+            {
                 return args;
             }
-            std::vector<const wchar_t*> AsRawArgs(std::vector<std::wstring>& args) const
+            size_t Size() const
             {
-                std::vector<const wchar_t*> raw;
-                for(auto& arg: args)
-                    raw.push_back(arg.c_str());
-                return raw;
+                return size;
+            }
+        private:
+            static constexpr size_t InlineArgs = 64;
+            static constexpr size_t InlineName = 260;
+            // windows paths are wide already
+            const wchar_t* Name(const std::wstring& name)
+            {
+                return name.c_str();
+            }
+            const wchar_t* Name(std::string_view name)
+            {
+                wchar_t* out = inline_name;
+                if(name.size() >= InlineName)
+                {
+                    heap_name.resize(name.size());
+                    out = heap_name.data();
+                }
+                DecodeUtf8(name, out);
+                return out;
             }
+            const wchar_t* inline_args[InlineArgs];
+            wchar_t inline_name[InlineName];
+            std::vector<const wchar_t*> heap_args;
+            std::wstring heap_name;
+            const wchar_t** args;
+            size_t size = 0;
         };
-        class DXCCompiler : public Compiler
+        // Serves includes through LoadSourceFile, created for every compilation
+        class DXCIncludeHandler : public IDxcIncludeHandler
         {
         public:
+            explicit DXCIncludeHandler(IDxcUtils* utils) : utils(utils)
+            {
+            }
+            HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+            {
+                if(!ppIncludeSource) return E_POINTER;
+                *ppIncludeSource = nullptr;
+                auto content = LoadSourceFile(std::filesystem::path(pFilename));
+                if(!content) return E_FAIL;
+                // pinned, the contents are kept alive by the handler which outlives the compilation
+                CComPtr<IDxcBlobEncoding> blob;
+                auto res = utils->CreateBlobFromPinned(content->text.data(), content->text.size(), DXC_CP_UTF8, &blob);
+                if(FAILED(res)) return res;
+                files.push_back(std::move(content->owner));
+                *ppIncludeSource = blob.Detach();
+                return S_OK;
+            }
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+            {
+                if(!ppvObject) return E_POINTER;
+                if(IsEqualIID(riid, __uuidof(IDxcIncludeHandler)) || IsEqualIID(riid, __uuidof(IUnknown)))
+                {
+                    *ppvObject = static_cast<IDxcIncludeHandler*>(this);
+                    AddRef();
+                    return S_OK;
+                }
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            ULONG STDMETHODCALLTYPE AddRef() override
+            {
+                return ++refCount;
+            }
+            ULONG STDMETHODCALLTYPE Release() override
+            {
+                ULONG count = --refCount;
+                if(count == 0) delete this;
+                return count;
+            }
+        private:
+            IDxcUtils* utils;
+            std::vector<std::shared_ptr<const void>> files;
+            std::atomic<ULONG> refCount = 0;
+        };
+        // IDxcCompiler3 instances aren't safe to use from several threads at once
+        struct DXCContext
+        {
             CComPtr<IDxcCompiler3> compiler;
-            CComPtr<IDxcIncludeHandler> includeHandler;
             CComPtr<IDxcUtils> utils;
-            DXCCompiler()
+            DXCContext()
             {
                 DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
                 DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
-                utils->CreateDefaultIncludeHandler(&includeHandler);
             }
         };
+        class DXCCompiler : public Compiler
+        {
+            PerThread<DXCContext> contexts;
+        public:
+            // destroyed before the contexts, its scheduler may still be running jobs that use them
+            CompilerState state;
+            DXCContext& Context()
+            {
+                return contexts.Get([]{ return std::make_unique<DXCContext>(); });
+            }
+        };
+        std::string_view Backend::Name()
+        {
+            return "dxc";
+        }
+        std::string_view Backend::Version()
+        {
+            static const std::string version = []
+            {
+                std::string version;
+                CComPtr<IDxcCompiler3> compiler;
+                CComPtr<IDxcVersionInfo> info;
+                UINT32 major = 0, minor = 0;
+                if(FAILED(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler))) || FAILED(compiler.QueryInterface(&info)) ||
+                    FAILED(info->GetVersion(&major, &minor)))
+                    return version;
+                version = std::to_string(major) + "." + std::to_string(minor);
+                // release versions aren't bumped by every build, the commit is
+                CComPtr<IDxcVersionInfo2> commit;
+                UINT32 commit_count = 0;
+                char* commit_hash = nullptr;
+                if(SUCCEEDED(info.QueryInterface(&commit)) && SUCCEEDED(commit->GetCommitInfo(&commit_count, &commit_hash)) && commit_hash)
+                {
+                    version += "." + std::to_string(commit_count) + " " + commit_hash;
+                    CoTaskMemFree(commit_hash);
+                }
+                return version;
+            }();
+            return version;
+        }
+        CompilerState& Backend::State(Compiler* cmp)
+        {
+            return static_cast<DXCCompiler*>(cmp)->state;
+        }
+        const OptionsState& Backend::State(const CompileOptions* opt)
+        {
+            return static_cast<const DXCCompileOptions*>(opt)->state;
+        }
         std::unique_ptr<CompileOptions> CompileOptions::New()
         {
             return std::make_unique<DXCCompileOptions>();
         }
+        std::unique_ptr<CompileOptions> CompileOptions::Clone() const
+        {
+            return std::make_unique<DXCCompileOptions>(*static_cast<const DXCCompileOptions*>(this));
+        }
         std::unique_ptr<Compiler> Compiler::New()
         {
             return std::make_unique<DXCCompiler>();
@@ -107,38 +323,77 @@ namespace RHI
         void CompileOptions::AddMacroDefinition(std::string_view name, std::optional<std::string_view> value)
         {
             auto opt = (DXCCompileOptions*)this;
-            std::wstring& wname = opt->macros.emplace_back(name.size(), L' ');
-            wname.reserve(mbstowcs(wname.data(), name.data(), name.size()));
-            if(value)
-            {
-                wname += L'=';
-                wname += to_wstring(std::string(*value));   
-            }
+            opt->state.macros.emplace_back(name, value);
+            opt->Render();
         }
         void CompileOptions::EnableDebuggingSymbols()
         {
             auto opt = (DXCCompileOptions*)this;
-            opt->debug = true;
+            opt->state.debug = true;
+            opt->Render();
+        }
+        void CompileOptions::EnableReflection()
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.reflect = true;
+        }
+        void CompileOptions::EnableStatistics()
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.stats = true;
+        }
+        void CompileOptions::EnableCostAnalysis()
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.cost = true;
+        }
+        void CompileOptions::StripDebugInfo()
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.strip = true;
+        }
+        void CompileOptions::RemapIds()
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.remap = true;
+        }
+        void CompileOptions::SetCompression(ShaderCompression codec)
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.compression = codec;
+        }
+        void CompileOptions::SetEntryPoint(std::string_view name)
+        {
+            auto opt = (DXCCompileOptions*)this;
+            opt->state.entry = name;
+            opt->Render();
+        }
+        void CompileOptions::SpecializeMacro(std::string_view name)
+        {
+            auto opt = (DXCCompileOptions*)this;
+            if(std::ranges::find(opt->state.specialized, name) == opt->state.specialized.end())
+                opt->state.specialized.emplace_back(name);
         }
         void CompileOptions::SetOptimizationLevel(OptimizationLevel level)
         {
             auto opt = (DXCCompileOptions*)this;
-            opt->level = level;
+            opt->state.level = level;
+            opt->Render();
         }
-        DxcBuffer MakeBuffer(IDxcBlobEncoding** enc, DXCCompiler* cmp, const ShaderSource& src)
+        DxcBuffer MakeBuffer(std::optional<SourceFile>& storage, const ShaderSource& src)
         {
             DxcBuffer buff;
             if(std::holds_alternative<std::filesystem::path>(src.source))
             {
                 auto& path = std::get<std::filesystem::path>(src.source);
-                auto res = cmp->utils->LoadFile(to_wstring(path.string()).c_str(), nullptr, enc);
-                if(!SUCCEEDED(res))
+                storage = LoadSourceFile(path);
+                if(!storage)
                 {
                     memset(&buff, 0, sizeof(buff));
                     return buff;
                 }
-                buff.Size = (*enc)->GetBufferSize();
-                buff.Ptr = (*enc)->GetBufferPointer();
+                buff.Size = storage->text.size();
+                buff.Ptr = storage->text.data();
                 buff.Encoding = DXC_CP_ACP;
             }  
             else
@@ -150,28 +405,23 @@ namespace RHI
             }
             return buff;
         }
-        CComPtr<IDxcResult> Compile(DXCCompiler* cmp, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, CompilationResult& ret_val)
+        CComPtr<IDxcResult> Compile(DXCCompiler* cmp, const ShaderSource& source, const CompileOptions* opt, CompilationResult& ret_val, bool preprocess = false)
         {
-            auto sc_opt = static_cast<const DXCCompileOptions*>(opt.get());
-            auto args = sc_opt->AsArgs(source.stage);
-            CComPtr<IDxcBlobEncoding> enc;
-            auto buffer = MakeBuffer(&enc, cmp, source);
+            auto sc_opt = static_cast<const DXCCompileOptions*>(opt);
+            DXCCommandLine args(*sc_opt, source, preprocess);
+            IncludeScope scope(cmp->state.Sources());
+            std::optional<SourceFile> storage;
+            auto buffer = MakeBuffer(storage, source);
             if(!buffer.Ptr) 
             {
                 ret_val.error = CompilationError::Error;
                 ret_val.messages = "Internal Error Occurred, Check that the filename is valid";
                 return nullptr;
             }
+            auto& context = cmp->Context();
+            CComPtr<IDxcIncludeHandler> includeHandler = new DXCIncludeHandler(context.utils);
             CComPtr<IDxcResult> result;
-            cmp->compiler->Compile(&buffer, sc_opt->AsRawArgs(args).data(), args.size(), cmp->includeHandler, IID_PPV_ARGS(&result));
-            ret_val.error = CompilationError::None;
-            return result;
-        }
-        CompilationResult Compiler::CompileToFile(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const std::filesystem::path& output)
-        {
-            CompilationResult ret_val;
-            auto result = Compile(static_cast<DXCCompiler*>(this), source, opt, ret_val);
-            if(ret_val.error != CompilationError::None) return ret_val;
+            context.compiler->Compile(&buffer, args.Args(), args.Size(), includeHandler, IID_PPV_ARGS(&result));
             CComPtr<IDxcBlobUtf8> pErrors = nullptr;
             result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr);
             if (pErrors != nullptr && pErrors->GetStringLength() != 0)
@@ -180,51 +430,36 @@ namespace RHI
             if(FAILED(status))
             {
                 ret_val.error = CompilationError::Error;   
-                return ret_val;
+                return nullptr;
             }
-            CComPtr<IDxcBlob> pShader = nullptr;
-            CComPtr<IDxcBlobWide> pShaderName = nullptr;
-            result->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pShader), &pShaderName);
-            if(!pShader)
+            ret_val.error = CompilationError::None;
+            return result;
+        }
+        void Backend::VisitArguments(const CompileOptions* opt, const ShaderSource& source, const ArgumentVisitor& visit)
+        {
+            DXCCommandLine args(*static_cast<const DXCCompileOptions*>(opt), source, false);
+            visit(std::span<const wchar_t* const>(args.Args(), args.Size()));
+        }
+        CompilationResult Backend::Preprocess(Compiler* compiler, const ShaderSource& source, const CompileOptions* opt, std::string& output)
+        {
+            CompilationResult ret_val;
+            auto result = Compile(static_cast<DXCCompiler*>(compiler), source, opt, ret_val, true);
+            if(ret_val.error != CompilationError::None) return ret_val;
+            CComPtr<IDxcBlobUtf8> pText = nullptr;
+            result->GetOutput(DXC_OUT_HLSL, IID_PPV_ARGS(&pText), nullptr);
+            if(!pText)
             {
-                ret_val.error = CompilationError::Error;   
+                ret_val.error = CompilationError::Error;
                 return ret_val;
             }
-            std::ofstream file(output);
-            uint32_t spvSize = pShader->GetBufferSize();
-            std::span spvSizeBytes = std::as_writable_bytes(std::span(&spvSize, 1));
-            if(std::endian::native != std::endian::little)
-            {
-                std::reverse(spvSizeBytes.begin(), spvSizeBytes.end());
-            }
-            file.write((char*)&spvSize, sizeof(spvSize));
-            file.write((const char*)pShader->GetBufferPointer(), spvSize);
-            uint32_t zero[4] = {0,0,0,0};
-            file.write((char*)zero, sizeof(uint32_t) * 4);
+            output.assign(pText->GetStringPointer(), pText->GetStringLength());
             return ret_val;
         }
-        [[nodiscard]] CompilationResult Compiler::CompileToBuffer(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::vector<char>& output, bool memory_repr)
+        CompilationResult Backend::Compile(Compiler* compiler, const ShaderSource& source, const CompileOptions* opt, ShaderBlob& output)
         {
             CompilationResult ret_val;
-            if(memory_repr && api != RHI::API::Vulkan)
-            {
-                ret_val.messages = "Only Vulkan API shaders supported";
-                ret_val.error = CompilationError::APINotAvailable;
-                return ret_val;
-            }
-            auto result = Compile(static_cast<DXCCompiler*>(this), source, opt, ret_val);
+            auto result = Compile(static_cast<DXCCompiler*>(compiler), source, opt, ret_val);
             if(ret_val.error != CompilationError::None) return ret_val;
-
-            CComPtr<IDxcBlobUtf8> pErrors = nullptr;
-            result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr);
-            if (pErrors != nullptr && pErrors->GetStringLength() != 0)
-                ret_val.messages = pErrors->GetStringPointer();
-            HRESULT status;result->GetStatus(&status);
-            if(FAILED(status))
-            {
-                ret_val.error = CompilationError::Error;   
-                return ret_val;
-            }
             CComPtr<IDxcBlob> pShader = nullptr;
             CComPtr<IDxcBlobWide> pShaderName = nullptr;
             result->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pShader), &pShaderName);
@@ -233,27 +468,8 @@ namespace RHI
                 ret_val.error = CompilationError::Error;   
                 return ret_val;
             }
-
-            uint32_t spvSize = pShader->GetBufferSize();
-            uint32_t extraBytes = memory_repr ? 0 : sizeof(uint32_t) * 5;
-            output.resize(spvSize + extraBytes);
-            uint32_t offset = 0;
-            if(!memory_repr)
-            {
-                uint32_t spvSizeCpy = spvSize;
-                std::span spvSizeBytes = std::as_writable_bytes(std::span(&spvSizeCpy, 1));
-                if(std::endian::native != std::endian::little)
-                {
-                    std::reverse(spvSizeBytes.begin(), spvSizeBytes.end());
-                }
-                std::memcpy(output.data(), spvSizeBytes.data(), sizeof(uint32_t));
-                offset = sizeof(uint32_t);
-            }
-            std::memcpy(output.data() + offset, pShader->GetBufferPointer(), spvSize);
-            if(!memory_repr)
-            {
-                std::memset(output.data() + offset + spvSize, 0, sizeof(uint32_t) * 4);
-            }
+            auto code = std::span((const uint32_t*)pShader->GetBufferPointer(), pShader->GetBufferSize() / sizeof(uint32_t));
+            output = ShaderBlob(std::make_shared<CComPtr<IDxcBlob>>(std::move(pShader)), code);
             return ret_val;
         }
     }
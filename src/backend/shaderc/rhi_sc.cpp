@@ -2,6 +2,9 @@
 #include "FormatsAndTypes.h"
 #include "RootSignature.h"
 #include "shaderc/shaderc.hpp"
+#include "src/common/backend.h"
+#include "src/common/include_cache.h"
+#include "src/common/per_thread.h"
 #include <algorithm>
 #include <bit>
 #include <filesystem>
@@ -10,29 +13,114 @@
 #include <memory>
 #include <shaderc/shaderc.h>
 #include <span>
+#include <spirv-tools/libspirv.h>
+#include <string>
 #include <variant>
 namespace RHI
 {
     namespace ShaderCompiler
     {
+        class ShaderCIncluder : public shaderc::CompileOptions::IncluderInterface
+        {
+            struct Include
+            {
+                shaderc_include_result result;
+                std::string name;
+                std::optional<SourceFile> content;
+                // the error message when the include can't be opened
+                std::string error;
+            };
+        public:
+            shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, size_t) override
+            {
+                auto include = new Include;
+                std::filesystem::path path = requested_source;
+                if(type == shaderc_include_type_relative)
+                    path = std::filesystem::path(requesting_source).parent_path() / path;
+                include->content = LoadSourceFile(path);
+                std::string_view text;
+                if(include->content)
+                {
+                    include->name = path.string();
+                    text = include->content->text;
+                }
+                else
+                {
+                    // an empty name signals failure, the content is then the error message
+                    include->error = "Cannot open include file " + path.string();
+                    text = include->error;
+                }
+                include->result.source_name = include->name.data();
+                include->result.source_name_length = include->name.size();
+                include->result.content = text.data();
+                include->result.content_length = text.size();
+                include->result.user_data = include;
+                return &include->result;
+            }
+            void ReleaseInclude(shaderc_include_result* data) override
+            {
+                delete static_cast<Include*>(data->user_data);
+            }
+        };
         class ShaderCCompileOptions : public CompileOptions
         {
         public:
             ShaderCCompileOptions()
             {
                 options.SetSourceLanguage(shaderc_source_language_hlsl);
+                options.SetIncluder(std::make_unique<ShaderCIncluder>());
+            }
+            ShaderCCompileOptions(const ShaderCCompileOptions& other) : options(other.options), state(other.state)
+            {
+                // the copied options still point at the other includer
+                options.SetIncluder(std::make_unique<ShaderCIncluder>());
             }
             shaderc::CompileOptions options;
+            OptionsState state;
         };
         class ShaderCCompiler : public Compiler
         {
+            PerThread<shaderc::Compiler> contexts;
         public:
-            shaderc::Compiler compiler;
+            // destroyed before the contexts, its scheduler may still be running jobs that use them
+            CompilerState state;
+            shaderc::Compiler& Context()
+            {
+                return contexts.Get([]{ return std::make_unique<shaderc::Compiler>(); });
+            }
         };
+        std::string_view Backend::Name()
+        {
+            return "shaderc";
+        }
+        std::string_view Backend::Version()
+        {
+            // shaderc has no version query of its own, the SPIR-V version it targets and the
+            // SPIRV-Tools build it ships with change with every SDK
+            static const std::string version = []
+            {
+                unsigned int spirv = 0, revision = 0;
+                shaderc_get_spv_version(&spirv, &revision);
+                return std::to_string(spirv) + "." + std::to_string(revision) + " " + spvSoftwareVersionDetailsString();
+            }();
+            return version;
+        }
+        CompilerState& Backend::State(Compiler* cmp)
+        {
+            return static_cast<ShaderCCompiler*>(cmp)->state;
+        }
+        const OptionsState& Backend::State(const CompileOptions* opt)
+        {
+            return static_cast<const ShaderCCompileOptions*>(opt)->state;
+        }
         std::unique_ptr<CompileOptions> CompileOptions::New()
         {
             return std::make_unique<ShaderCCompileOptions>();
         }
+        std::unique_ptr<CompileOptions> CompileOptions::Clone() const
+        {
+            return std::make_unique<ShaderCCompileOptions>(*static_cast<const ShaderCCompileOptions*>(this));
+        }
         std::unique_ptr<Compiler> Compiler::New()
         {
             return std::make_unique<ShaderCCompiler>();
@@ -40,6 +128,7 @@ namespace RHI
         void CompileOptions::AddMacroDefinition(std::string_view name, std::optional<std::string_view> value)
         {
             auto opt = (ShaderCCompileOptions*)this;
+            opt->state.macros.emplace_back(name, value);
             if (value)
             {
                 opt->options.AddMacroDefinition(name.data(), name.size(), value->data(), value->size());
@@ -53,6 +142,48 @@ namespace RHI
         {
             auto opt = (ShaderCCompileOptions*)this;
             opt->options.SetGenerateDebugInfo();
+            opt->state.debug = true;
+        }
+        void CompileOptions::EnableReflection()
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.reflect = true;
+        }
+        void CompileOptions::EnableStatistics()
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.stats = true;
+        }
+        void CompileOptions::EnableCostAnalysis()
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.cost = true;
+        }
+        void CompileOptions::StripDebugInfo()
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.strip = true;
+        }
+        void CompileOptions::RemapIds()
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.remap = true;
+        }
+        void CompileOptions::SetCompression(ShaderCompression codec)
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.compression = codec;
+        }
+        void CompileOptions::SetEntryPoint(std::string_view name)
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            opt->state.entry = name;
+        }
+        void CompileOptions::SpecializeMacro(std::string_view name)
+        {
+            auto opt = (ShaderCCompileOptions*)this;
+            if(std::ranges::find(opt->state.specialized, name) == opt->state.specialized.end())
+                opt->state.specialized.emplace_back(name);
         }
         void CompileOptions::SetOptimizationLevel(OptimizationLevel level)
         {
@@ -67,6 +198,7 @@ namespace RHI
                 case _3: lv = shaderc_optimization_level_performance; break;    
             }
             opt->options.SetOptimizationLevel(lv);
+            opt->state.level = level;
         }
         static shaderc_shader_kind ShaderKind(ShaderStage stg)
         {
@@ -76,42 +208,54 @@ namespace RHI
                 case Vertex: return shaderc_vertex_shader;
                 case Pixel: return shaderc_fragment_shader;
                 case Geometry: return shaderc_geometry_shader;
-                case Domain: return shaderc_tess_control_shader;
-                case Hull: return shaderc_tess_evaluation_shader;
+                case Hull: return shaderc_tess_control_shader;
+                case Domain: return shaderc_tess_evaluation_shader;
                 case Compute: return shaderc_compute_shader;
                 default: return shaderc_glsl_infer_from_source;
             }
         }
-        shaderc::SpvCompilationResult Compile(ShaderCCompiler* cmp, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, CompilationResult& ret_val)
+        // text points either into storage or into the caller's string source
+        static bool LoadSource(const ShaderSource& source, std::optional<SourceFile>& storage, std::string_view& text, std::string& name, CompilationResult& ret_val)
         {
-            shaderc::SpvCompilationResult result;
-            auto sc_opt = static_cast<const ShaderCCompileOptions*>(opt.get());
-            auto kind = ShaderKind(source.stage);
-            if(kind == shaderc_glsl_infer_from_source)
-            {
-                ret_val.error = CompilationError::InvalidStage;
-                ret_val.messages = "Invalid Shader Stage Specified";
-            }
             if(std::holds_alternative<std::filesystem::path>(source.source))
             {
                 auto& path = std::get<std::filesystem::path>(source.source);
-                if(!std::filesystem::exists(path))
+                storage = LoadSourceFile(path);
+                if(!storage)
                 {
                     ret_val.error = CompilationError::NonExistentFile;
                     ret_val.messages = "File passed in was not found";
-                    return result;
+                    return false;
                 }
-                std::ifstream file(path);
-                std::string str;
-                str.resize(std::filesystem::file_size(path));
-                str.assign(std::istreambuf_iterator(file), std::istreambuf_iterator<char>());
-                result = cmp->compiler.CompileGlslToSpv(str, kind, path.c_str(), sc_opt->options);
+                text = storage->text;
+                name = path.string();
             }
             else
             {
                 auto& src = std::get<ShaderSource::StringSource>(source.source);
-                result = cmp->compiler.CompileGlslToSpv(src.shader.data(), src.shader.size(), kind, std::string(src.filename).c_str());
+                text = src.shader;
+                name = src.filename;
             }
+            return true;
+        }
+        shaderc::SpvCompilationResult Compile(ShaderCCompiler* cmp, const ShaderSource& source, const CompileOptions* opt, CompilationResult& ret_val)
+        {
+            shaderc::SpvCompilationResult result;
+            auto sc_opt = static_cast<const ShaderCCompileOptions*>(opt);
+            auto kind = ShaderKind(source.stage);
+            if(kind == shaderc_glsl_infer_from_source)
+            {
+                ret_val.error = CompilationError::InvalidStage;
+                ret_val.messages = "Invalid Shader Stage Specified";
+                return result;
+            }
+            IncludeScope scope(cmp->state.Sources());
+            std::optional<SourceFile> storage;
+            std::string name;
+            std::string_view text;
+            if(!LoadSource(source, storage, text, name, ret_val))
+                return result;
+            result = cmp->Context().CompileGlslToSpv(text.data(), text.size(), kind, name.c_str(), sc_opt->state.entry.c_str(), sc_opt->options);
             ret_val.messages = result.GetErrorMessage();
             if(result.GetCompilationStatus() != shaderc_compilation_status_success)
             {
@@ -121,56 +265,47 @@ namespace RHI
             ret_val.error = CompilationError::None;
             return result;
         }
-        CompilationResult Compiler::CompileToFile(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const std::filesystem::path& output)
+        void Backend::VisitArguments(const CompileOptions*, const ShaderSource&, const ArgumentVisitor& visit)
         {
-            CompilationResult ret_val;
-            auto result = Compile(static_cast<ShaderCCompiler*>(this), source, opt, ret_val);
-            if(ret_val.error != CompilationError::None) return ret_val;
-            
-            std::ofstream file(output);
-            uint32_t spvSize = (result.end() - result.begin()) * sizeof(decltype(result)::element_type);
-            std::span spvSizeBytes = std::as_writable_bytes(std::span(&spvSize, 1));
-            if(std::endian::native != std::endian::little)
-            {
-                std::reverse(spvSizeBytes.begin(), spvSizeBytes.end());
-            }
-            file.write((char*)&spvSize, sizeof(spvSize));
-            file.write((const char*)result.begin(), spvSize);
-            uint32_t zero[4] = {0,0,0,0};
-            file.write((char*)zero, sizeof(uint32_t) * 4);
-            return ret_val;
+            // shaderc takes its options as an object, there is no command line
+            visit({});
         }
-        [[nodiscard]] CompilationResult Compiler::CompileToBuffer(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::vector<char>& output, bool memory_repr)
+        CompilationResult Backend::Preprocess(Compiler* compiler, const ShaderSource& source, const CompileOptions* opt, std::string& output)
         {
             CompilationResult ret_val;
-            if(memory_repr && api != RHI::API::Vulkan)
+            auto cmp = static_cast<ShaderCCompiler*>(compiler);
+            auto sc_opt = static_cast<const ShaderCCompileOptions*>(opt);
+            auto kind = ShaderKind(source.stage);
+            if(kind == shaderc_glsl_infer_from_source)
             {
-                ret_val.messages = "Only Vulkan API shaders supported";
-                ret_val.error = CompilationError::APINotAvailable;
+                ret_val.error = CompilationError::InvalidStage;
+                ret_val.messages = "Invalid Shader Stage Specified";
                 return ret_val;
             }
-            auto result = Compile(static_cast<ShaderCCompiler*>(this), source, opt, ret_val);
-            if(ret_val.error != CompilationError::None) return ret_val;
-
-            uint32_t spvSize = (result.end() - result.begin()) * sizeof(decltype(result)::element_type);
-            uint32_t extraBytes = memory_repr ? 0 : sizeof(uint32_t) * 5;
-            output.resize(spvSize + extraBytes);
-            uint32_t offset = 0;
-            if(!memory_repr)
-            {
-                uint32_t spvSizeCpy = spvSize;
-                std::span spvSizeBytes = std::as_writable_bytes(std::span(&spvSizeCpy, 1));
-                if(std::endian::native != std::endian::little)
-                {
-                    std::reverse(spvSizeBytes.begin(), spvSizeBytes.end());
-                }
-                std::memcpy(output.data(), spvSizeBytes.data(), sizeof(uint32_t));
-            }
-            std::memcpy(output.data() + offset, result.begin(), spvSize);
-            if(!memory_repr)
+            IncludeScope scope(cmp->state.Sources());
+            std::optional<SourceFile> storage;
+            std::string name;
+            std::string_view text;
+            if(!LoadSource(source, storage, text, name, ret_val))
+                return ret_val;
+            auto result = cmp->Context().PreprocessGlsl(text.data(), text.size(), kind, name.c_str(), sc_opt->options);
+            ret_val.messages = result.GetErrorMessage();
+            if(result.GetCompilationStatus() != shaderc_compilation_status_success)
             {
-                std::memset(output.data() + offset + spvSize, 0, sizeof(uint32_t) * 4);
+                ret_val.error = CompilationError::Error;
+                return ret_val;
             }
+            output.assign(result.begin(), result.end());
+            ret_val.error = CompilationError::None;
+            return ret_val;
+        }
+        CompilationResult Backend::Compile(Compiler* compiler, const ShaderSource& source, const CompileOptions* opt, ShaderBlob& output)
+        {
+            CompilationResult ret_val;
+            auto result = Compile(static_cast<ShaderCCompiler*>(compiler), source, opt, ret_val);
+            if(ret_val.error != CompilationError::None) return ret_val;
+            auto owner = std::make_shared<shaderc::SpvCompilationResult>(std::move(result));
+            output = ShaderBlob(owner, std::span(owner->begin(), owner->end()));
             return ret_val;
         }
     }
@@ -0,0 +1,714 @@
+#include "build.h"
+#include "depfile.h"
+#include "server.h"
+#include "watch.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <ranges>
+#include <set>
+#include <thread>
+#include <unordered_map>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        using Clock = std::chrono::steady_clock;
+        // Everything besides the sources that affects the output, compared by --incremental
+        static std::string OptionsFingerprint(const BuildJob& job, const MacroSet& macros, const BuildSettings& settings)
+        {
+            std::string fingerprint = std::string(Compiler::BackendName());
+            fingerprint += " stage=" + std::to_string(static_cast<uint32_t>(job.stage));
+            fingerprint += " O=" + std::to_string(static_cast<uint32_t>(job.level));
+            fingerprint += job.debug ? " g" : "";
+            fingerprint += job.reflect ? " reflect" : "";
+            fingerprint += settings.strip ? " strip" : "";
+            fingerprint += settings.remap ? " remap-ids" : "";
+            fingerprint += " compress=" + std::to_string(static_cast<uint32_t>(settings.compression));
+            fingerprint += " entry=" + job.entry;
+            for(auto& [name, value] : macros)
+            {
+                fingerprint += " -D" + name;
+                if(value) fingerprint += "=" + *value;
+            }
+            for(auto& name : job.specialize)
+                fingerprint += " spec=" + name;
+            return fingerprint;
+        }
+        // outputs are what CI compares from run to run, variants of a manifest share theirs
+        static std::vector<std::string> CostNames(const std::vector<BuildJob>& jobs)
+        {
+            std::vector<std::string> names;
+            for(auto& job : jobs)
+                names.push_back(job.output + (job.variant.empty() ? "" : " [" + job.variant + "]"));
+            return names;
+        }
+        static void CreateParentDirectory(const std::filesystem::path& output)
+        {
+            std::error_code ec;
+            if(auto dir = output.parent_path(); !dir.empty())
+                std::filesystem::create_directories(dir, ec);
+        }
+        std::unique_ptr<CompileOptions> JobOptions(const BuildJob& job, const BuildSettings& settings)
+        {
+            auto args = CompileOptions::New();
+            if (job.debug)
+            {
+                args->EnableDebuggingSymbols();
+            }
+            if (job.reflect)
+            {
+                args->EnableReflection();
+            }
+            if (settings.strip)
+            {
+                args->StripDebugInfo();
+            }
+            if (settings.remap)
+            {
+                args->RemapIds();
+            }
+            if (settings.cost)
+            {
+                args->EnableCostAnalysis();
+            }
+            args->SetCompression(settings.compression);
+            if (settings.time_report || settings.trace)
+            {
+                args->EnableStatistics();
+            }
+            for(auto& [name, value] : job.macros)
+                args->AddMacroDefinition(name, value ? std::optional<std::string_view>(*value) : std::nullopt);
+            for(auto& name : job.specialize)
+                args->SpecializeMacro(name);
+            args->SetOptimizationLevel(job.level);
+            args->SetEntryPoint(job.entry);
+            return args;
+        }
+        namespace
+        {
+            // A build of many jobs, the phases share the results, timings and the compiler (with its include cache)
+            class Batch
+            {
+            public:
+                Batch(const std::vector<BuildJob>& jobs, const BuildSettings& settings) : jobs(jobs), settings(settings),
+                    results(jobs.size()), skipped(jobs.size(), false), compiled_as(jobs.size()),
+                    archived(settings.archive ? jobs.size() : 0), timings(jobs.size())
+                {
+                    workers = settings.workers > 0 ? settings.workers : std::thread::hardware_concurrency();
+                    workers = std::clamp<size_t>(workers, 1, std::max<size_t>(jobs.size(), 1));
+                    // manifest variants are told apart by their permutation in reports
+                    for(auto& job : jobs)
+                    {
+                        names.push_back(job.input.string() + (settings.manifest && !job.variant.empty() ? " [" + job.variant + "]" : ""));
+                        fingerprints.push_back(OptionsFingerprint(job, job.macros, settings));
+                    }
+                    std::iota(compiled_as.begin(), compiled_as.end(), 0);
+                }
+                int Run()
+                {
+                    // an archive is built (and skipped) as a whole, its fingerprint also covers the entries it holds
+                    if(settings.archive)
+                    {
+                        for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                            archive_fingerprint += fingerprints[i] + " " + jobs[i].input.string() + ">" + jobs[i].output + "[" + jobs[i].variant + "]\n";
+                        std::vector<std::filesystem::path> dependencies;
+                        if(settings.incremental && IsUpToDate(*settings.archive, archive_fingerprint, dependencies))
+                            return 0;
+                    }
+                    else
+                    {
+                        // manifest outputs may go to directories that don't exist yet
+                        for(auto& job : jobs)
+                            CreateParentDirectory(job.output);
+                    }
+                    // subscribed before the first build, so inputs saved while it runs aren't missed
+                    std::unique_ptr<FileWatcher> watcher;
+                    if(settings.watch)
+                    {
+                        std::vector<std::filesystem::path> inputs;
+                        for(auto& job : jobs)
+                            inputs.push_back(job.input);
+                        watcher = FileWatcher::New();
+                        if(!watcher || !watcher->Watch(inputs))
+                        {
+                            std::cerr << "--watch needs inotify, which isn't available" << std::endl;
+                            return 1;
+                        }
+                    }
+                    run_start = Clock::now();
+                    // the workers share one compiler, in connect mode every worker has its own connection
+                    cmp = Compiler::New();
+                    if(settings.cache_dir) cmp->SetCacheDirectory(*settings.cache_dir);
+                    if(settings.dedupe)
+                        Deduplicate();
+                    if(settings.max_memory)
+                    {
+                        if(!Stream()) return 1;
+                    }
+                    else
+                    {
+                        std::vector<std::thread> pool;
+                        for(size_t i = 1; i < workers; i++)
+                            pool.emplace_back(&Batch::Work, this, i);
+                        Work(0);
+                        for(auto& thread : pool)
+                            thread.join();
+                    }
+                    CopyDuplicates();
+                    int exit_code = Report();
+                    if(settings.archive)
+                        return exit_code != 0 ? exit_code : WriteArchive();
+                    // streamed builds wrote theirs as the outputs were done
+                    if(settings.depfiles && !settings.max_memory)
+                        WriteDepfiles();
+                    if(!watcher)
+                        return exit_code;
+                    return Watch(*watcher);
+                }
+            private:
+                double SinceStart(Clock::time_point time) const
+                {
+                    return std::chrono::duration<double, std::milli>(time - run_start).count();
+                }
+                void RecordJob(size_t i, size_t worker, Clock::time_point start)
+                {
+                    timings[i] = {worker, SinceStart(start), SinceStart(Clock::now()) - SinceStart(start)};
+                }
+                // true if the job can be skipped, the recorded dependencies are then placed in its result
+                bool UpToDate(size_t i)
+                {
+                    if(!settings.incremental || settings.archive || !IsUpToDate(jobs[i].output, fingerprints[i], results[i].dependencies))
+                        return false;
+                    results[i].error = CompilationError::None;
+                    skipped[i] = true;
+                    return true;
+                }
+                // jobs whose preprocessed text and options match an earlier job's are compiled once and copied
+                void Deduplicate()
+                {
+                    std::mutex mutex;
+                    // only the texts of the first job of every group are kept
+                    std::unordered_map<std::string, size_t> groups;
+                    std::vector<size_t*> group(jobs.size(), nullptr);
+                    auto preprocess = [&]()
+                    {
+                        for(size_t i = next_job++; i < jobs.size(); i = next_job++)
+                        {
+                            // debug info records the macros, those outputs differ even if the text doesn't
+                            if(UpToDate(i) || jobs[i].debug) continue;
+                            auto& job = jobs[i];
+                            ShaderSource src;
+                            src.source = job.input;
+                            src.stage = job.stage;
+                            std::string text;
+                            if(cmp->Preprocess(src, JobOptions(job, settings), text).error != CompilationError::None) continue;
+                            // the macros are already applied to the text, everything else has to match too
+                            auto key = OptionsFingerprint(job, {}, settings);
+                            key += '\0';
+                            key += text;
+                            std::lock_guard lock(mutex);
+                            auto& first = groups.try_emplace(std::move(key), i).first->second;
+                            first = std::min(first, i);
+                            group[i] = &first;
+                        }
+                    };
+                    std::vector<std::thread> pool;
+                    for(size_t i = 1; i < workers; i++)
+                        pool.emplace_back(preprocess);
+                    preprocess();
+                    for(auto& thread : pool)
+                        thread.join();
+                    next_job = 0;
+                    for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                    {
+                        if(group[i]) compiled_as[i] = *group[i];
+                    }
+                }
+                void Compile(size_t i)
+                {
+                    auto& job = jobs[i];
+                    const auto args = JobOptions(job, settings);
+                    ShaderSource src;
+                    src.source = job.input;
+                    src.stage = job.stage;
+                    if(settings.archive)
+                        results[i] = cmp->CompileToBuffer(RHI::API::Vulkan, src, args, archived[i], false);
+                    else if(settings.watch)
+                    {
+                        // a running engine reloading the output never sees it half written
+                        std::vector<char> output;
+                        results[i] = cmp->CompileToBuffer(RHI::API::Vulkan, src, args, output, false);
+                        if(results[i].error == CompilationError::None && !WriteFileAtomic(job.output, output))
+                        {
+                            results[i].error = CompilationError::Error;
+                            results[i].messages += "Failed to write " + job.output + "\n";
+                        }
+                    }
+                    else
+                        results[i] = cmp->CompileToFile(src, args, job.output);
+                    if(settings.incremental && !settings.archive && results[i].error == CompilationError::None)
+                        WriteStamp(job.output, fingerprints[i], results[i].dependencies);
+                }
+                void Submit(size_t worker)
+                {
+                    auto channel = ConnectSocket(*settings.connect);
+                    for(size_t i = next_job++; i < jobs.size(); i = next_job++)
+                    {
+                        auto start = Clock::now();
+                        if(UpToDate(i)) continue;
+                        auto& job = jobs[i];
+                        ServerRequest request;
+                        request.source = std::filesystem::absolute(job.input).string();
+                        if(!settings.archive) request.output = std::filesystem::absolute(job.output).string();
+                        request.stage = job.stage;
+                        request.entry = job.entry;
+                        request.level = job.level;
+                        request.debug = job.debug;
+                        request.reflect = job.reflect;
+                        request.strip = settings.strip;
+                        request.remap = settings.remap;
+                        request.compression = settings.compression;
+                        request.stats = settings.time_report || settings.trace;
+                        request.macros = job.macros;
+                        request.specialize = job.specialize;
+                        ServerResponse response;
+                        if(!channel || !SendRequest(*channel, request) || !ReceiveResponse(*channel, response))
+                        {
+                            response.result.error = CompilationError::Error;
+                            response.result.messages = "Lost connection to the compile server at " + *settings.connect + "\n";
+                        }
+                        results[i] = std::move(response.result);
+                        if(settings.archive) archived[i] = std::move(response.output);
+                        if(settings.incremental && !settings.archive && results[i].error == CompilationError::None)
+                            WriteStamp(job.output, fingerprints[i], results[i].dependencies);
+                        RecordJob(i, worker, start);
+                    }
+                }
+                void Work(size_t worker)
+                {
+                    if(settings.connect)
+                    {
+                        Submit(worker);
+                        return;
+                    }
+                    for(size_t i = next_job++; i < jobs.size(); i = next_job++)
+                    {
+                        auto start = Clock::now();
+                        // the dedupe pass already checked every job
+                        if(skipped[i] || (!settings.dedupe && UpToDate(i)) || compiled_as[i] != i) continue;
+                        Compile(i);
+                        RecordJob(i, worker, start);
+                    }
+                }
+                // Writes every output as soon as it's compiled, nothing of an output is kept once it's written and only the
+                // dependencies of an archive are merged. False if the archive can't be created
+                bool Stream()
+                {
+                    if(settings.archive)
+                    {
+                        std::vector<std::pair<std::string, std::string>> entries;
+                        for(auto& job : jobs)
+                            entries.emplace_back(job.output, job.variant);
+                        stream_archive.emplace(*settings.archive, entries);
+                        if(!stream_archive->Good())
+                        {
+                            std::cerr << "Failed to write " << settings.archive->string() << std::endl;
+                            return false;
+                        }
+                    }
+                    const bool depfiles = settings.depfiles && !settings.archive;
+                    std::ofstream combined;
+                    if(depfiles && settings.depfile) combined.open(*settings.depfile);
+                    // skipped jobs are reported by the workers, compiled ones by the sink
+                    std::mutex depfile_mutex;
+                    auto write_depfile = [&](size_t i)
+                    {
+                        auto dependencies = std::move(results[i].dependencies);
+                        results[i].dependencies = {};
+                        if(!depfiles) return;
+                        if(settings.manifest) dependencies.emplace_back(*settings.manifest);
+                        if(settings.depfile)
+                        {
+                            std::lock_guard lock(depfile_mutex);
+                            WriteDepfileRule(combined, jobs[i].output, dependencies);
+                        }
+                        else
+                        {
+                            std::ofstream file(jobs[i].output + ".d");
+                            WriteDepfileRule(file, jobs[i].output, dependencies);
+                        }
+                    };
+                    auto source = [&](size_t i, ShaderSource& src, std::unique_ptr<CompileOptions>& opt)
+                    {
+                        if(UpToDate(i))
+                        {
+                            if(settings.depfile) write_depfile(i);
+                            return false;
+                        }
+                        src.source = jobs[i].input;
+                        src.stage = jobs[i].stage;
+                        opt = JobOptions(jobs[i], settings);
+                        return true;
+                    };
+                    auto sink = [&](BatchOutput& done)
+                    {
+                        const auto i = done.index;
+                        auto& result = done.result;
+                        if(result.error == CompilationError::None)
+                        {
+                            const bool written = settings.archive ? stream_archive->Add(i, done.output) : WriteFileAtomic(jobs[i].output, done.output);
+                            if(!written)
+                            {
+                                result.error = CompilationError::Error;
+                                result.messages += "Failed to write " + (settings.archive ? settings.archive->string() : jobs[i].output) + "\n";
+                            }
+                        }
+                        if(!result.messages.empty())
+                        {
+                            std::cerr << result.messages;
+                            result.messages = {};
+                        }
+                        timings[i] = {done.worker, SinceStart(done.start), SinceStart(done.end) - SinceStart(done.start)};
+                        results[i] = std::move(result);
+                        if(results[i].error != CompilationError::None) return;
+                        if(settings.archive)
+                        {
+                            stream_dependencies.insert(results[i].dependencies.begin(), results[i].dependencies.end());
+                            results[i].dependencies = {};
+                            return;
+                        }
+                        if(settings.incremental)
+                            WriteStamp(jobs[i].output, fingerprints[i], results[i].dependencies);
+                        write_depfile(i);
+                    };
+                    BatchSettings batch;
+                    batch.memory_repr = false;
+                    batch.threads = static_cast<uint32_t>(workers);
+                    batch.max_memory = *settings.max_memory;
+                    cmp->CompileBatch(jobs.size(), source, sink, batch);
+                    return true;
+                }
+                void CopyDuplicates()
+                {
+                    for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                    {
+                        const auto first = compiled_as[i];
+                        if(first == i) continue;
+                        deduplicated++;
+                        // the messages and stats belong to the job that was compiled
+                        results[i] = results[first];
+                        results[i].messages.clear();
+                        results[i].stats.reset();
+                        if(results[i].error != CompilationError::None) continue;
+                        if(settings.archive)
+                        {
+                            archived[i] = archived[first];
+                            continue;
+                        }
+                        std::error_code ec;
+                        std::filesystem::copy_file(jobs[first].output, jobs[i].output, std::filesystem::copy_options::overwrite_existing, ec);
+                        if(ec)
+                        {
+                            results[i].error = CompilationError::Error;
+                            results[i].messages = "Failed to write " + jobs[i].output + "\n";
+                        }
+                        else if(settings.incremental)
+                            WriteStamp(jobs[i].output, fingerprints[i], results[i].dependencies);
+                    }
+                }
+                // Prints the messages, failures and requested reports, returns the exit code
+                int Report()
+                {
+                    int exit_code = 0;
+                    size_t failed = 0;
+                    for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                    {
+                        if(!results[i].messages.empty())
+                        {
+                            std::cerr << results[i].messages;
+                        }
+                        if(results[i].error != CompilationError::None)
+                        {
+                            std::cerr << names[i] << ": compilation failed" << std::endl;
+                            exit_code = 1;
+                            failed++;
+                        }
+                    }
+                    if(settings.manifest || settings.dedupe)
+                    {
+                        size_t up = std::ranges::count(skipped, true);
+                        if(settings.manifest)
+                            std::cout << settings.manifest->string() << ": " << settings.manifest_jobs << " jobs, " << jobs.size() << " variants: ";
+                        else
+                            std::cout << jobs.size() << " inputs: ";
+                        std::cout << jobs.size() - up - deduplicated << " compiled, " << deduplicated << " deduplicated, " << up << " up to date, "
+                            << failed << " failed in " << SinceStart(Clock::now()) / 1000 << " s" << std::endl;
+                    }
+                    if(settings.time_report)
+                    {
+                        WriteTimeReport(std::cerr, names, results);
+                    }
+                    if(settings.trace && !WriteTrace(*settings.trace, names, results, timings))
+                    {
+                        std::cerr << "Failed to write " << settings.trace->string() << std::endl;
+                        exit_code = 1;
+                    }
+                    if(settings.cost && !CheckCost(*settings.cost, CostNames(jobs), results, std::cerr))
+                        exit_code = 1;
+                    return exit_code;
+                }
+                int WriteArchive()
+                {
+                    auto& archive = *settings.archive;
+                    std::vector<std::filesystem::path> dependencies;
+                    uint64_t duplicate_bytes = 0;
+                    if(stream_archive)
+                    {
+                        dependencies.assign(stream_dependencies.begin(), stream_dependencies.end());
+                        if(!stream_archive->Finish())
+                        {
+                            std::cerr << "Failed to write " << archive.string() << std::endl;
+                            return 1;
+                        }
+                        duplicate_bytes = stream_archive->DuplicateBytes();
+                    }
+                    else
+                    {
+                        ArchiveWriter writer;
+                        for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                        {
+                            writer.Add(jobs[i].output, jobs[i].variant, std::move(archived[i]));
+                            dependencies.insert(dependencies.end(), results[i].dependencies.begin(), results[i].dependencies.end());
+                        }
+                        if(!writer.Write(archive))
+                        {
+                            std::cerr << "Failed to write " << archive.string() << std::endl;
+                            return 1;
+                        }
+                        duplicate_bytes = writer.DuplicateBytes();
+                    }
+                    if(settings.time_report)
+                    {
+                        std::cerr << duplicate_bytes << " bytes saved by storing identical archive entries once" << std::endl;
+                    }
+                    if(settings.manifest)
+                        dependencies.emplace_back(*settings.manifest);
+                    std::ranges::sort(dependencies);
+                    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+                    if(settings.incremental)
+                        WriteStamp(archive, archive_fingerprint, dependencies);
+                    if(settings.depfiles)
+                    {
+                        std::ofstream file(settings.depfile.value_or(archive.string() + ".d"));
+                        WriteDepfileRule(file, archive, dependencies);
+                    }
+                    return 0;
+                }
+                void WriteDepfiles()
+                {
+                    std::ofstream combined;
+                    if(settings.depfile) combined.open(*settings.depfile);
+                    for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                    {
+                        if(results[i].error != CompilationError::None) continue;
+                        auto dependencies = results[i].dependencies;
+                        // outputs of a manifest also depend on it
+                        if(settings.manifest) dependencies.emplace_back(*settings.manifest);
+                        if(settings.depfile)
+                        {
+                            WriteDepfileRule(combined, jobs[i].output, dependencies);
+                        }
+                        else
+                        {
+                            std::ofstream file(jobs[i].output + ".d");
+                            WriteDepfileRule(file, jobs[i].output, dependencies);
+                        }
+                    }
+                }
+                // Recompiles the jobs affected by every change, only returns if watching fails
+                int Watch(FileWatcher& watcher)
+                {
+                    // every job depends on its input even if it failed before reading it
+                    DependencyGraph graph;
+                    auto update_graph = [&](size_t i)
+                    {
+                        auto files = results[i].dependencies;
+                        files.push_back(jobs[i].input);
+                        graph.Update(i, files);
+                    };
+                    for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                        update_graph(i);
+                    while(true)
+                    {
+                        const auto files = graph.Files();
+                        if(!watcher.Watch(files))
+                        {
+                            std::cerr << "Failed to watch the sources" << std::endl;
+                            return 1;
+                        }
+                        std::cout << "Watching " << files.size() << " files for changes" << std::endl;
+                        std::optional<FileChanges> changes;
+                        std::vector<size_t> affected;
+                        while(affected.empty())
+                        {
+                            changes = watcher.Wait(settings.debounce);
+                            if(!changes)
+                            {
+                                std::cerr << "Failed to wait for changes" << std::endl;
+                                return 1;
+                            }
+                            std::vector<std::filesystem::path> recorded;
+                            affected = graph.Affected(changes->files, recorded);
+                            if(changes->overflow)
+                            {
+                                cmp->InvalidateIncludeCache();
+                                affected.resize(jobs.size());
+                                std::iota(affected.begin(), affected.end(), 0);
+                            }
+                            for(auto& file : recorded)
+                                cmp->InvalidateIncludeCache(file);
+                            // a failed job may not have reached the include that fixes it, it's retried on any change
+                            for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                            {
+                                if(results[i].error != CompilationError::None && !std::ranges::binary_search(affected, i))
+                                    affected.insert(std::ranges::upper_bound(affected, i), i);
+                            }
+                            if(changes->files.empty() && !changes->overflow) affected.clear();
+                        }
+                        // the include cache stays warm, only the changed files are read again
+                        const auto cycle_start = Clock::now();
+                        std::atomic<size_t> next = 0;
+                        auto recompile = [&]()
+                        {
+                            for(size_t n = next++; n < affected.size(); n = next++)
+                                Compile(affected[n]);
+                        };
+                        std::vector<std::thread> cycle_pool;
+                        for(size_t i = 1; i < std::min(workers, affected.size()); i++)
+                            cycle_pool.emplace_back(recompile);
+                        recompile();
+                        for(auto& thread : cycle_pool)
+                            thread.join();
+                        size_t cycle_failed = 0;
+                        for(auto i : affected)
+                        {
+                            update_graph(i);
+                            if(!results[i].messages.empty())
+                                std::cerr << results[i].messages;
+                            if(results[i].error != CompilationError::None)
+                            {
+                                std::cerr << names[i] << ": compilation failed" << std::endl;
+                                cycle_failed++;
+                            }
+                        }
+                        if(settings.depfiles)
+                            WriteDepfiles();
+                        std::cout << changes->files.size() << " files changed: " << affected.size() - cycle_failed << " recompiled, " << cycle_failed << " failed in "
+                            << std::chrono::duration<double, std::milli>(Clock::now() - cycle_start).count() << " ms" << std::endl;
+                    }
+                }
+
+                const std::vector<BuildJob>& jobs;
+                const BuildSettings& settings;
+                size_t workers;
+                std::vector<std::string> names;
+                std::vector<std::string> fingerprints;
+                std::vector<CompilationResult> results;
+                std::vector<char> skipped;
+                // the job whose output is copied, the job itself unless dedupe found an identical one
+                std::vector<size_t> compiled_as;
+                size_t deduplicated = 0;
+                // outputs of an archive build that doesn't stream
+                std::vector<std::vector<char>> archived;
+                std::string archive_fingerprint;
+                std::optional<ArchiveStreamWriter> stream_archive;
+                std::set<std::filesystem::path> stream_dependencies;
+                std::vector<JobTiming> timings;
+                Clock::time_point run_start;
+                std::unique_ptr<Compiler> cmp;
+                std::atomic<size_t> next_job = 0;
+            };
+        }
+        int RunBuild(const std::vector<BuildJob>& jobs, const BuildSettings& settings)
+        {
+            return Batch(jobs, settings).Run();
+        }
+        int RunPipeline(const std::vector<BuildJob>& jobs, const BuildSettings& settings)
+        {
+            std::vector<PipelineStage> stages(jobs.size());
+            std::vector<std::string> names;
+            for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+            {
+                stages[i].source.source = jobs[i].input;
+                stages[i].source.stage = jobs[i].stage;
+                stages[i].options = JobOptions(jobs[i], settings);
+                names.push_back(jobs[i].input.string());
+            }
+            const auto cmp = Compiler::New();
+            if(settings.cache_dir) cmp->SetCacheDirectory(*settings.cache_dir);
+            auto linked = cmp->CompilePipeline(RHI::API::Vulkan, stages, false);
+            int exit_code = 0;
+            std::vector<CompilationResult> results;
+            auto locations = [](const std::vector<uint32_t>& list)
+            {
+                std::string text;
+                for(auto location : list)
+                    text += (text.empty() ? "" : ", ") + std::to_string(location);
+                return text;
+            };
+            for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+            {
+                auto& [result, output, removed_outputs, removed_inputs] = linked[i];
+                auto& job = jobs[i];
+                std::cerr << result.messages;
+                if(result.error == CompilationError::None)
+                {
+                    CreateParentDirectory(job.output);
+                    if(!WriteFileAtomic(job.output, output))
+                    {
+                        std::cerr << "Failed to write " << job.output << std::endl;
+                        result.error = CompilationError::Error;
+                    }
+                }
+                if(result.error != CompilationError::None)
+                {
+                    std::cerr << names[i] << ": compilation failed" << std::endl;
+                    exit_code = 1;
+                }
+                else if(!removed_outputs.empty() || !removed_inputs.empty())
+                {
+                    std::cout << job.output << ": removed";
+                    if(!removed_outputs.empty()) std::cout << " unread outputs at locations " << locations(removed_outputs);
+                    if(!removed_outputs.empty() && !removed_inputs.empty()) std::cout << " and";
+                    if(!removed_inputs.empty()) std::cout << " unused inputs at locations " << locations(removed_inputs);
+                    std::cout << std::endl;
+                }
+                results.push_back(std::move(result));
+            }
+            if(settings.time_report)
+                WriteTimeReport(std::cerr, names, results);
+            if(settings.cost && !CheckCost(*settings.cost, CostNames(jobs), results, std::cerr))
+                exit_code = 1;
+            if(settings.depfiles && exit_code == 0)
+            {
+                std::ofstream combined;
+                if(settings.depfile) combined.open(*settings.depfile);
+                for(const auto i : std::views::iota(static_cast<size_t>(0), jobs.size()))
+                {
+                    if(settings.depfile)
+                        WriteDepfileRule(combined, jobs[i].output, results[i].dependencies);
+                    else
+                    {
+                        std::ofstream file(jobs[i].output + ".d");
+                        WriteDepfileRule(file, jobs[i].output, results[i].dependencies);
+                    }
+                }
+            }
+            return exit_code;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "manifest.h"
+#include "report.h"
+#include "rhi_sc.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Command line options that apply to every job of a build, the jobs bring the rest
+        struct BuildSettings
+        {
+            bool strip = false;
+            bool remap = false;
+            ShaderCompression compression = ShaderCompression::None;
+            bool time_report = false;
+            std::optional<std::filesystem::path> trace;
+            std::optional<CostCheck> cost;
+            std::optional<std::filesystem::path> cache_dir;
+            // 0 uses every hardware thread
+            size_t workers = 1;
+            bool incremental = false;
+            // -MD, one <output>.d per output unless depfile names a single file for all of them
+            bool depfiles = false;
+            std::optional<std::filesystem::path> depfile;
+            // set for manifest builds, every output also depends on the manifest
+            std::optional<std::filesystem::path> manifest;
+            size_t manifest_jobs = 0;
+            // pack the outputs into this archive, the job outputs are then entry names
+            std::optional<std::filesystem::path> archive;
+            // submit the jobs to the compile server listening here
+            std::optional<std::string> connect;
+            bool dedupe = false;
+            // stream the outputs through Compiler::CompileBatch keeping at most this many bytes in flight
+            std::optional<size_t> max_memory;
+            bool watch = false;
+            std::chrono::milliseconds debounce{50};
+        };
+        std::unique_ptr<CompileOptions> JobOptions(const BuildJob& job, const BuildSettings& settings);
+        // Compiles every job and writes the outputs, depfiles, stamps and reports, returns the exit code of the CLI.
+        // With settings.watch it then recompiles the jobs whose sources change and only returns on failure
+        int RunBuild(const std::vector<BuildJob>& jobs, const BuildSettings& settings);
+        // Compiles the jobs as the stages of one pipeline and links their interfaces, see Compiler::CompilePipeline
+        int RunPipeline(const std::vector<BuildJob>& jobs, const BuildSettings& settings);
+    }
+}
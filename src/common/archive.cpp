@@ -0,0 +1,215 @@
+#include "include/rhi_sc.h"
+#include "include/rhi_sc_archive.h"
+#include "src/common/sha256.h"
+#include <fstream>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        std::string PermutationKey(const MacroSet& macros)
+        {
+            std::vector<const MacroDefinition*> sorted;
+            for(auto& macro : macros) sorted.push_back(&macro);
+            std::ranges::stable_sort(sorted, {}, &MacroDefinition::name);
+            std::string key;
+            for(auto macro : sorted)
+            {
+                if(!key.empty()) key += ';';
+                key += macro->name;
+                if(macro->value) key += "=" + *macro->value;
+            }
+            return key;
+        }
+        void ArchiveWriter::Add(std::string_view name, std::string_view key, std::vector<char> bytes)
+        {
+            std::string stored(name);
+            stored += '\0';
+            stored += key;
+            entries.insert_or_assign(std::move(stored), std::move(bytes));
+        }
+        uint64_t ArchiveWriter::DuplicateBytes() const
+        {
+            std::unordered_set<std::string_view> unique;
+            uint64_t bytes = 0;
+            for(auto& [name, payload] : entries)
+            {
+                if(!unique.emplace(payload.data(), payload.size()).second) bytes += payload.size();
+            }
+            return bytes;
+        }
+        static uint64_t AlignUp(uint64_t value)
+        {
+            return (value + Archive::Alignment - 1) & ~(Archive::Alignment - 1);
+        }
+        bool ArchiveWriter::Write(const std::filesystem::path& path) const
+        {
+            std::vector<Archive::Entry> index;
+            std::vector<const std::vector<char>*> payloads;
+            std::string names;
+            index.reserve(entries.size());
+            for(auto& [name, bytes] : entries)
+            {
+                auto separator = name.find('\0');
+                index.push_back({Archive::Hash(std::string_view(name).substr(0, separator), std::string_view(name).substr(separator + 1)),
+                    0, bytes.size(), uint32_t(names.size()), uint32_t(name.size())});
+                payloads.push_back(&bytes);
+                names += name;
+            }
+            // sort the entries by hash and the payloads along with them
+            std::vector<uint32_t> order(index.size());
+            for(uint32_t i = 0; i < order.size(); i++) order[i] = i;
+            std::ranges::sort(order, {}, [&](uint32_t i) { return index[i].hash; });
+
+            Archive::Header header = {Archive::Magic, Archive::Version, uint32_t(index.size()), 0,
+                Archive::IndexOffset + index.size() * sizeof(Archive::Entry), names.size()};
+            uint32_t fanout[256] = {};
+            std::vector<Archive::Entry> sorted;
+            sorted.reserve(index.size());
+            uint64_t offset = AlignUp(header.names_offset + header.names_size);
+            // identical payloads (e.g. permutations that optimized to the same module) are stored once
+            std::unordered_map<std::string_view, uint64_t> stored;
+            std::vector<bool> duplicate;
+            for(auto i : order)
+            {
+                auto& entry = sorted.emplace_back(index[i]);
+                auto [existing, inserted] = stored.try_emplace(std::string_view(payloads[i]->data(), payloads[i]->size()), offset);
+                entry.offset = existing->second;
+                duplicate.push_back(!inserted);
+                if(inserted) offset = AlignUp(offset + entry.size);
+                fanout[entry.hash >> 56]++;
+            }
+            for(uint32_t i = 1; i < 256; i++) fanout[i] += fanout[i - 1];
+
+            auto tmp = path;
+            tmp += "." + std::to_string(std::random_device{}()) + ".tmp";
+            {
+                std::ofstream file(tmp, std::ios::binary);
+                file.write((const char*)&header, sizeof(header));
+                file.write((const char*)fanout, sizeof(fanout));
+                file.write((const char*)sorted.data(), sorted.size() * sizeof(Archive::Entry));
+                file.write(names.data(), names.size());
+                uint64_t written = header.names_offset + header.names_size;
+                const std::vector<char> padding(Archive::Alignment, 0);
+                for(size_t i = 0; i < sorted.size(); i++)
+                {
+                    if(duplicate[i]) continue;
+                    file.write(padding.data(), sorted[i].offset - written);
+                    auto& bytes = *payloads[order[i]];
+                    file.write(bytes.data(), bytes.size());
+                    written = sorted[i].offset + bytes.size();
+                }
+                if(!file.good())
+                {
+                    file.close();
+                    std::error_code ec;
+                    std::filesystem::remove(tmp, ec);
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, path, ec);
+            if(!ec) return true;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        struct ArchiveStreamWriter::State
+        {
+            std::filesystem::path path, tmp;
+            std::ofstream file;
+            // in the order of the entries, sorted by hash when finishing
+            std::vector<Archive::Entry> index;
+            std::vector<bool> added;
+            std::string names;
+            Archive::Header header;
+            // end of the payloads written so far
+            uint64_t written = 0;
+            std::map<std::array<uint8_t, 32>, uint64_t> stored;
+            uint64_t duplicate_bytes = 0;
+            bool finished = false;
+        };
+        ArchiveStreamWriter::ArchiveStreamWriter(const std::filesystem::path& path, std::span<const std::pair<std::string, std::string>> entries) : state(std::make_unique<State>())
+        {
+            state->path = path;
+            state->tmp = path;
+            state->tmp += "." + std::to_string(std::random_device{}()) + ".tmp";
+            for(auto& [name, key] : entries)
+            {
+                state->index.push_back({Archive::Hash(name, key), 0, 0, uint32_t(state->names.size()), uint32_t(name.size() + 1 + key.size())});
+                state->names += name;
+                state->names += '\0';
+                state->names += key;
+            }
+            state->added.resize(entries.size(), false);
+            state->header = {Archive::Magic, Archive::Version, uint32_t(entries.size()), 0,
+                Archive::IndexOffset + entries.size() * sizeof(Archive::Entry), state->names.size()};
+            // the header, index and names are only known at the end, their space is reserved for now
+            state->written = state->header.names_offset + state->header.names_size;
+            state->file.open(state->tmp, std::ios::binary);
+            const std::vector<char> zeros(state->written, 0);
+            state->file.write(zeros.data(), zeros.size());
+        }
+        ArchiveStreamWriter::~ArchiveStreamWriter()
+        {
+            if(state->finished) return;
+            state->file.close();
+            std::error_code ec;
+            std::filesystem::remove(state->tmp, ec);
+        }
+        bool ArchiveStreamWriter::Good() const
+        {
+            return state->file.good();
+        }
+        bool ArchiveStreamWriter::Add(size_t index, std::span<const char> bytes)
+        {
+            if(index >= state->index.size() || !state->file.good()) return false;
+            Sha256 hash;
+            hash.Update(bytes.data(), bytes.size());
+            auto& entry = state->index[index];
+            entry.size = bytes.size();
+            state->added[index] = true;
+            auto [existing, inserted] = state->stored.try_emplace(hash.Finish(), 0);
+            if(!inserted)
+            {
+                entry.offset = existing->second;
+                state->duplicate_bytes += bytes.size();
+                return true;
+            }
+            static const std::vector<char> padding(Archive::Alignment, 0);
+            uint64_t offset = AlignUp(state->written);
+            state->file.write(padding.data(), offset - state->written);
+            state->file.write(bytes.data(), bytes.size());
+            existing->second = entry.offset = offset;
+            state->written = offset + bytes.size();
+            return state->file.good();
+        }
+        uint64_t ArchiveStreamWriter::DuplicateBytes() const
+        {
+            return state->duplicate_bytes;
+        }
+        bool ArchiveStreamWriter::Finish()
+        {
+            if(!state->file.good() || std::ranges::find(state->added, false) != state->added.end()) return false;
+            auto& index = state->index;
+            std::ranges::stable_sort(index, {}, &Archive::Entry::hash);
+            uint32_t fanout[256] = {};
+            for(auto& entry : index)
+                fanout[entry.hash >> 56]++;
+            for(uint32_t i = 1; i < 256; i++) fanout[i] += fanout[i - 1];
+            state->file.seekp(0);
+            state->file.write((const char*)&state->header, sizeof(state->header));
+            state->file.write((const char*)fanout, sizeof(fanout));
+            state->file.write((const char*)index.data(), index.size() * sizeof(Archive::Entry));
+            state->file.write(state->names.data(), state->names.size());
+            state->file.close();
+            std::error_code ec;
+            if(!state->file.good()) return false;
+            std::filesystem::rename(state->tmp, state->path, ec);
+            state->finished = !ec;
+            return state->finished;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#include "src/common/async.h"
+#include "src/common/backend.h"
+#include <algorithm>
+#include <utility>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        AsyncCompileResult CancelledResult()
+        {
+            AsyncCompileResult result;
+            result.result.error = CompilationError::Cancelled;
+            result.result.messages = "Compilation cancelled\n";
+            return result;
+        }
+        void AsyncState::Complete(AsyncCompileResult result)
+        {
+            std::coroutine_handle<> resume;
+            {
+                std::lock_guard lock(mutex);
+                if(done) return;
+                value = std::move(result);
+                done = true;
+                resume = std::exchange(continuation, nullptr);
+            }
+            finished.notify_all();
+            if(resume) resume.resume();
+        }
+        Scheduler::Scheduler(uint32_t workers)
+        {
+            for(uint32_t i = 0; i < std::max(workers, 1u); i++)
+                threads.emplace_back(&Scheduler::Run, this);
+        }
+        Scheduler::~Scheduler()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            available.notify_all();
+            for(auto& thread : threads)
+                thread.join();
+            while(!jobs.empty())
+            {
+                jobs.top().state->Complete(CancelledResult());
+                jobs.pop();
+            }
+        }
+        void Scheduler::Submit(CompilePriority priority, std::shared_ptr<AsyncState> state, std::function<AsyncCompileResult()> work)
+        {
+            {
+                std::lock_guard lock(mutex);
+                jobs.push({priority, sequence++, std::move(state), std::move(work)});
+            }
+            available.notify_one();
+        }
+        void Scheduler::Run()
+        {
+            while(true)
+            {
+                Job job;
+                {
+                    std::unique_lock lock(mutex);
+                    available.wait(lock, [this]{ return stopping || !jobs.empty(); });
+                    if(stopping) return;
+                    // top() is const, the job is moved out right before it's popped
+                    job = std::move(const_cast<Job&>(jobs.top()));
+                    jobs.pop();
+                }
+                if(job.state->IsCancelled())
+                {
+                    job.state->Complete(CancelledResult());
+                    continue;
+                }
+                auto result = job.work();
+                job.state->Complete(job.state->IsCancelled() ? CancelledResult() : std::move(result));
+            }
+        }
+        CompileTask::CompileTask(std::shared_ptr<AsyncState> state) : state(std::move(state))
+        {
+        }
+        bool CompileTask::Ready() const
+        {
+            std::lock_guard lock(state->mutex);
+            return state->done;
+        }
+        void CompileTask::Wait() const
+        {
+            std::unique_lock lock(state->mutex);
+            state->finished.wait(lock, [this]{ return state->done; });
+        }
+        bool CompileTask::WaitFor(std::chrono::milliseconds timeout) const
+        {
+            std::unique_lock lock(state->mutex);
+            return state->finished.wait_for(lock, timeout, [this]{ return state->done; });
+        }
+        AsyncCompileResult CompileTask::Get()
+        {
+            Wait();
+            std::lock_guard lock(state->mutex);
+            return std::move(state->value);
+        }
+        void CompileTask::Cancel()
+        {
+            state->cancelled = true;
+            state->Complete(CancelledResult());
+        }
+        bool CompileTask::await_suspend(std::coroutine_handle<> handle)
+        {
+            std::lock_guard lock(state->mutex);
+            if(state->done) return false;
+            state->continuation = handle;
+            return true;
+        }
+        void Compiler::SetAsyncWorkerCount(uint32_t count)
+        {
+            auto& state = Backend::State(this);
+            std::lock_guard lock(state.schedulerMutex);
+            state.asyncWorkers = count;
+        }
+        CompileTask Compiler::CompileAsync(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, CompilePriority priority, std::optional<CancellationToken> token, bool memory_repr)
+        {
+            auto task_state = std::make_shared<AsyncState>();
+            task_state->token = std::move(token);
+            Scheduler* scheduler;
+            {
+                auto& state = Backend::State(this);
+                std::lock_guard lock(state.schedulerMutex);
+                if(!state.scheduler)
+                    state.scheduler = std::make_unique<Scheduler>(state.asyncWorkers ? state.asyncWorkers : std::thread::hardware_concurrency());
+                scheduler = state.scheduler.get();
+            }
+            // string sources are views, the job keeps its own copy of the text
+            std::shared_ptr<std::pair<std::string, std::string>> text;
+            if(auto str = std::get_if<ShaderSource::StringSource>(&source.source))
+                text = std::make_shared<std::pair<std::string, std::string>>(str->shader, str->filename);
+            // std::function needs a copyable callable
+            auto options = std::make_shared<std::unique_ptr<CompileOptions>>(opt->Clone());
+            scheduler->Submit(priority, task_state, [this, api, source, text, options, memory_repr]()
+            {
+                ShaderSource src = source;
+                if(text) src.source = ShaderSource::StringSource{text->first, text->second};
+                AsyncCompileResult result;
+                result.result = CompileToBuffer(api, src, *options, result.output, memory_repr);
+                return result;
+            });
+            return CompileTask(std::move(task_state));
+        }
+    }
+}
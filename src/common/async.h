@@ -0,0 +1,65 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        struct AsyncState
+        {
+            std::mutex mutex;
+            std::condition_variable finished;
+            bool done = false;
+            AsyncCompileResult value;
+            std::coroutine_handle<> continuation;
+            std::atomic<bool> cancelled = false;
+            std::optional<CancellationToken> token;
+            bool IsCancelled() const
+            {
+                return cancelled || (token && token->Cancelled());
+            }
+            // Only the first call has an effect, a waiting coroutine is resumed on the calling thread
+            void Complete(AsyncCompileResult result);
+        };
+        // Fixed set of worker threads running jobs by priority. Queued jobs are completed as cancelled on destruction
+        class Scheduler
+        {
+        public:
+            explicit Scheduler(uint32_t workers);
+            ~Scheduler();
+            Scheduler(const Scheduler&) = delete;
+            Scheduler& operator=(const Scheduler&) = delete;
+            void Submit(CompilePriority priority, std::shared_ptr<AsyncState> state, std::function<AsyncCompileResult()> work);
+        private:
+            struct Job
+            {
+                CompilePriority priority;
+                uint64_t sequence;
+                std::shared_ptr<AsyncState> state;
+                std::function<AsyncCompileResult()> work;
+                bool operator<(const Job& other) const
+                {
+                    // priority_queue pops the largest element
+                    if(priority != other.priority) return priority < other.priority;
+                    return sequence > other.sequence;
+                }
+            };
+            void Run();
+            std::mutex mutex;
+            std::condition_variable available;
+            std::priority_queue<Job> jobs;
+            uint64_t sequence = 0;
+            bool stopping = false;
+            std::vector<std::thread> threads;
+        };
+        AsyncCompileResult CancelledResult();
+    }
+}
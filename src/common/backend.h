@@ -0,0 +1,67 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include "src/common/async.h"
+#include "src/common/include_cache.h"
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Compiler state every backend carries, used by the backend independent code
+        struct CompilerState
+        {
+            std::optional<std::filesystem::path> cacheDir;
+            // shared with the compilers a batch spawns for its worker threads
+            std::shared_ptr<FileCache> files = std::make_shared<FileCache>();
+            // replaces files as the source of main files and includes when set
+            std::shared_ptr<FileSystem> fileSystem;
+            std::mutex schedulerMutex;
+            uint32_t asyncWorkers = 0;
+            // started by the first CompileAsync, declared last so it's stopped before the rest of the state goes away
+            std::unique_ptr<Scheduler> scheduler;
+            FileSystem* Sources()
+            {
+                return fileSystem ? fileSystem.get() : files.get();
+            }
+        };
+        // The options as recorded by CompileOptions, independent of how the backend consumes them
+        struct OptionsState
+        {
+            bool debug = false;
+            bool reflect = false;
+            bool stats = false;
+            bool cost = false;
+            bool strip = false;
+            bool remap = false;
+            ShaderCompression compression = ShaderCompression::None;
+            std::string entry = "main";
+            OptimizationLevel level = OptimizationLevel::None;
+            std::vector<std::pair<std::string, std::optional<std::string>>> macros;
+            // macros turned into specialization constants, the index is the SpecId
+            std::vector<std::string> specialized;
+        };
+        // Implemented once by every backend
+        namespace Backend
+        {
+            std::string_view Name();
+            // Build of the compiler library loaded at runtime, empty if it can't tell
+            std::string_view Version();
+            CompilerState& State(Compiler* cmp);
+            const OptionsState& State(const CompileOptions* opt);
+            CompilationResult Compile(Compiler* cmp, const ShaderSource& source, const CompileOptions* opt, ShaderBlob& output);
+            // Runs only the preprocessor, on success output holds the include expanded source
+            CompilationResult Preprocess(Compiler* cmp, const ShaderSource& source, const CompileOptions* opt, std::string& output);
+            // Hands visit the command line a compilation of source would pass the backend, empty if it takes none
+            using ArgumentVisitor = std::function<void(std::span<const wchar_t* const>)>;
+            void VisitArguments(const CompileOptions* opt, const ShaderSource& source, const ArgumentVisitor& visit);
+        }
+    }
+}
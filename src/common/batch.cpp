@@ -0,0 +1,139 @@
+#include "include/rhi_sc.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            struct QueuedOutput
+            {
+                BatchOutput output;
+                std::vector<char> buffer;
+                size_t bytes = 0;
+            };
+            // Finished jobs waiting for the sink, and the buffers of written ones kept for the next jobs
+            class BatchQueue
+            {
+            public:
+                // a budget of 0 still lets a worker go on once the queue is empty
+                BatchQueue(size_t max_memory, size_t max_free) : max_memory(std::max<size_t>(max_memory, 1)), max_free(max_free)
+                {
+                }
+                // Blocks while the queued outputs are over budget, the writer always drains so this can't deadlock
+                void WaitForRoom()
+                {
+                    std::unique_lock lock(mutex);
+                    room.wait(lock, [&]{ return queued_bytes < max_memory; });
+                }
+                std::vector<char> TakeBuffer()
+                {
+                    std::lock_guard lock(mutex);
+                    if(free.empty()) return {};
+                    auto buffer = std::move(free.back());
+                    free.pop_back();
+                    return buffer;
+                }
+                void Push(QueuedOutput item)
+                {
+                    item.bytes = item.buffer.capacity() + item.output.result.messages.capacity();
+                    {
+                        std::lock_guard lock(mutex);
+                        queued_bytes += item.bytes;
+                        items.push_back(std::move(item));
+                    }
+                    ready.notify_one();
+                }
+                // false once the workers are done and everything was taken
+                bool Pop(QueuedOutput& item)
+                {
+                    std::unique_lock lock(mutex);
+                    ready.wait(lock, [&]{ return !items.empty() || done; });
+                    if(items.empty()) return false;
+                    item = std::move(items.front());
+                    items.pop_front();
+                    return true;
+                }
+                void Recycle(QueuedOutput& item)
+                {
+                    {
+                        std::lock_guard lock(mutex);
+                        queued_bytes -= item.bytes;
+                        if(free.size() < max_free)
+                        {
+                            item.buffer.clear();
+                            free.push_back(std::move(item.buffer));
+                        }
+                    }
+                    room.notify_all();
+                }
+                void Finish()
+                {
+                    {
+                        std::lock_guard lock(mutex);
+                        done = true;
+                    }
+                    ready.notify_all();
+                }
+            private:
+                std::mutex mutex;
+                std::condition_variable ready, room;
+                std::deque<QueuedOutput> items;
+                std::vector<std::vector<char>> free;
+                size_t queued_bytes = 0;
+                const size_t max_memory, max_free;
+                bool done = false;
+            };
+        }
+        void Compiler::CompileBatch(size_t count, const BatchSource& source, const BatchSink& sink, const BatchSettings& settings)
+        {
+            size_t num_workers = std::clamp<size_t>(settings.threads, 1, std::max<size_t>(count, 1));
+            // every worker and the sink hold one buffer, one spare covers the handover
+            BatchQueue queue(settings.max_memory, num_workers + 2);
+            std::thread writer([&]
+            {
+                QueuedOutput item;
+                while(queue.Pop(item))
+                {
+                    item.output.output = item.output.result.error == CompilationError::None ? std::span<const char>(item.buffer) : std::span<const char>();
+                    sink(item.output);
+                    // the result goes with the sink call, only the buffer is kept
+                    item.output = BatchOutput();
+                    queue.Recycle(item);
+                }
+            });
+            std::atomic<size_t> next = 0;
+            auto worker = [&](size_t id)
+            {
+                ShaderSource src;
+                std::unique_ptr<CompileOptions> opt;
+                for(size_t i = next++; i < count; i = next++)
+                {
+                    queue.WaitForRoom();
+                    if(!source(i, src, opt)) continue;
+                    QueuedOutput item;
+                    item.output.index = i;
+                    item.output.worker = id;
+                    item.output.start = std::chrono::steady_clock::now();
+                    item.buffer = queue.TakeBuffer();
+                    item.output.result = CompileToBuffer(settings.api, src, opt, item.buffer, settings.memory_repr);
+                    item.output.end = std::chrono::steady_clock::now();
+                    queue.Push(std::move(item));
+                }
+            };
+            std::vector<std::thread> pool;
+            for(size_t i = 1; i < num_workers; i++)
+                pool.emplace_back(worker, i);
+            worker(0);
+            for(auto& thread : pool)
+                thread.join();
+            queue.Finish();
+            writer.join();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include "src/common/cache.h"
+#include "src/common/output.h"
+#include "src/common/sha256.h"
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <thread>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Cache
+        {
+            // bump when the stored file layout or key contents change
+            constexpr uint32_t Version = 6;
+            static std::filesystem::path EntryPath(const std::filesystem::path& dir, const std::string& key)
+            {
+                return dir / key.substr(0, 2) / (key + ".spv");
+            }
+            std::string Key(Compiler* cmp, const ShaderSource& source, const CompileOptions* opt)
+            {
+                std::string preprocessed;
+                if(Backend::Preprocess(cmp, source, opt, preprocessed).error != CompilationError::None)
+                    return {};
+                auto& options = Backend::State(opt);
+                Sha256 hash;
+                hash.UpdateU32(Version);
+                hash.UpdateU32(Backend::Name().size());
+                hash.Update(Backend::Name());
+                hash.UpdateU32(Backend::Version().size());
+                hash.Update(Backend::Version());
+                hash.UpdateU32(static_cast<uint32_t>(source.stage));
+                hash.UpdateU32(static_cast<uint32_t>(options.level));
+                hash.UpdateU32(options.debug);
+                hash.UpdateU32(options.reflect);
+                hash.UpdateU32(options.strip);
+                hash.UpdateU32(options.remap);
+                hash.UpdateU32(options.entry.size());
+                hash.Update(options.entry);
+                hash.UpdateU32(options.macros.size());
+                for(auto& [name, value] : options.macros)
+                {
+                    hash.UpdateU32(name.size());
+                    hash.Update(name);
+                    hash.UpdateU32(value ? value->size() + 1 : 0);
+                    if(value) hash.Update(*value);
+                }
+                hash.UpdateU32(options.specialized.size());
+                for(auto& name : options.specialized)
+                {
+                    hash.UpdateU32(name.size());
+                    hash.Update(name);
+                }
+                hash.UpdateU32(preprocessed.size());
+                hash.Update(preprocessed);
+                return hash.FinishHex();
+            }
+            std::optional<std::vector<char>> Load(Compiler* cmp, const std::string& key)
+            {
+                auto& dir = Backend::State(cmp).cacheDir;
+                std::vector<char> file;
+                if(!dir || !ReadFileBytes(EntryPath(*dir, key), file) || ShaderFileSpirv(file).empty())
+                    return std::nullopt;
+                return file;
+            }
+            void Store(Compiler* cmp, const std::string& key, const ShaderBlob& blob)
+            {
+                auto& dir = Backend::State(cmp).cacheDir;
+                if(!dir) return;
+                auto path = EntryPath(*dir, key);
+                std::error_code ec;
+                std::filesystem::create_directories(path.parent_path(), ec);
+                // write to a unique temporary and rename so concurrent readers never see a partial entry
+                static std::atomic<uint32_t> counter = 0;
+                std::ostringstream tmp_name;
+                tmp_name << key << '.' << std::random_device{}() << '.' << std::this_thread::get_id() << '.' << counter++ << ".tmp";
+                auto tmp = path.parent_path() / tmp_name.str();
+                if(!WriteShaderFile(tmp, blob.Bytes(), blob.Reflection()))
+                {
+                    std::filesystem::remove(tmp, ec);
+                    return;
+                }
+                std::filesystem::rename(tmp, path, ec);
+                if(ec) std::filesystem::remove(tmp, ec);
+            }
+        }
+    }
+}
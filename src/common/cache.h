@@ -0,0 +1,20 @@
+#pragma once
+#include "src/common/backend.h"
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Content addressed store of serialized shader files, keyed on the compiler build, the preprocessed source and options
+        namespace Cache
+        {
+            // returns an empty key if the source could not be preprocessed, compilation should then report the error
+            std::string Key(Compiler* cmp, const ShaderSource& source, const CompileOptions* opt);
+            std::optional<std::vector<char>> Load(Compiler* cmp, const std::string& key);
+            void Store(Compiler* cmp, const std::string& key, const ShaderBlob& blob);
+        }
+    }
+}
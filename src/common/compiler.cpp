@@ -0,0 +1,357 @@
+#include "include/rhi_sc.h"
+#include "src/common/backend.h"
+#include "src/common/cache.h"
+#include "src/common/compression.h"
+#include "src/common/cost.h"
+#include "src/common/output.h"
+#include "src/common/postprocess.h"
+#include "src/common/reflection.h"
+#include "src/common/specialize.h"
+#include "src/common/spirv.h"
+#include <chrono>
+#include <cstring>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            using Clock = std::chrono::steady_clock;
+            double Milliseconds(Clock::time_point start)
+            {
+                return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+            // Accounts the output step in the result's stats, if it has any
+            class OutputTimer
+            {
+            public:
+                explicit OutputTimer(CompilationResult& result) : result(result), start(Clock::now())
+                {
+                }
+                void Finish(size_t bytes)
+                {
+                    if(!result.stats) return;
+                    double ms = Milliseconds(start);
+                    result.stats->output_ms += ms;
+                    result.stats->total_ms += ms;
+                    result.stats->output_bytes = bytes;
+                }
+            private:
+                CompilationResult& result;
+                Clock::time_point start;
+            };
+            // Runs the requested post compile passes, a pass that can't handle the module leaves it as it is and warns
+            void PostProcess(ShaderBlob& blob, const OptionsState& options, const ShaderSource& source, CompilationResult& result)
+            {
+                auto warn = [&](const char* pass)
+                {
+                    auto path = std::get_if<std::filesystem::path>(&source.source);
+                    auto name = path ? path->string() : std::string(std::get<ShaderSource::StringSource>(source.source).filename);
+                    result.warning_count++;
+                    result.messages += name + ": warning: " + pass + " can't handle the compiled module, it was skipped\n";
+                };
+                std::vector<uint32_t> code(blob.begin(), blob.end()), processed;
+                if(options.strip)
+                {
+                    if(Spirv::StripDebugInfo(code, processed)) code.swap(processed);
+                    else warn("stripping debug info");
+                }
+                if(options.remap)
+                {
+                    if(Spirv::RemapIds(code, processed)) code.swap(processed);
+                    else warn("id remapping");
+                }
+                auto owner = std::make_shared<std::vector<uint32_t>>(std::move(code));
+                blob = ShaderBlob(owner, *owner);
+            }
+            // The source the backend is given, with the specialization constants declared ahead of it if there are any.
+            // nullptr if the main file can't be read
+            const ShaderSource* BackendSource(Compiler* cmp, const ShaderSource& source, const OptionsState& options, SpecializedSource& specialized)
+            {
+                if(options.specialized.empty()) return &source;
+                IncludeScope scope(Backend::State(cmp).Sources());
+                return Specialize(source, options.specialized, specialized) ? &specialized.source : nullptr;
+            }
+            // Errors for the specialized macros the main source or its includes test with the preprocessor
+            std::string SpecializationMisuse(Compiler* cmp, const ShaderSource& source, std::vector<std::filesystem::path> files, const OptionsState& options)
+            {
+                std::string messages;
+                IncludeScope scope(Backend::State(cmp).Sources());
+                if(auto str = std::get_if<ShaderSource::StringSource>(&source.source))
+                    messages += ConditionalUses(str->shader, str->filename, options.specialized);
+                for(auto& file : files)
+                {
+                    if(auto text = LoadSourceFile(file)) messages += ConditionalUses(text->text, file.string(), options.specialized);
+                }
+                return messages;
+            }
+            // Replaces output with the compressed file representation of blob, keeping its storage
+            void CompressedFile(const ShaderBlob& blob, ShaderCompression codec, std::vector<char>& output)
+            {
+                std::vector<char> file;
+                AppendShaderFile(file, blob.Bytes(), blob.Reflection());
+                CompressShaderFile(codec, file, output);
+            }
+        }
+        std::string_view Compiler::BackendName()
+        {
+            return Backend::Name();
+        }
+        void Compiler::SetCacheDirectory(std::optional<std::filesystem::path> directory)
+        {
+            Backend::State(this).cacheDir = std::move(directory);
+        }
+        void Compiler::PrewarmIncludeCache(std::span<const std::filesystem::path> files)
+        {
+            auto& cache = *Backend::State(this).files;
+            for(auto& file : files)
+                cache.Load(file);
+        }
+        void Compiler::InvalidateIncludeCache()
+        {
+            Backend::State(this).files->Invalidate();
+        }
+        void Compiler::InvalidateIncludeCache(const std::filesystem::path& file)
+        {
+            Backend::State(this).files->Invalidate(file);
+        }
+        void Compiler::SetFileSystem(std::shared_ptr<FileSystem> files)
+        {
+            Backend::State(this).fileSystem = std::move(files);
+        }
+        CompilationResult Compiler::Preprocess(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::string& output)
+        {
+            std::vector<std::filesystem::path> dependencies;
+            DependencyScope scope(dependencies);
+            SpecializedSource specialized;
+            auto input = BackendSource(this, source, Backend::State(opt.get()), specialized);
+            CompilationResult ret_val;
+            if(input)
+                ret_val = Backend::Preprocess(this, *input, opt.get(), output);
+            else
+            {
+                ret_val.error = CompilationError::NonExistentFile;
+                ret_val.messages = "File passed in was not found";
+            }
+            ret_val.dependencies = std::move(dependencies);
+            return ret_val;
+        }
+        CompilationResult Compiler::CompileToBlob(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, ShaderBlob& output)
+        {
+            auto& options = Backend::State(opt.get());
+            auto start = Clock::now();
+            std::vector<std::filesystem::path> dependencies;
+            DependencyScope scope(dependencies);
+            std::optional<CompilationStats> stats;
+            LoadStats loads;
+            std::optional<LoadStatsScope> load_scope;
+            if(options.stats)
+            {
+                stats.emplace();
+                load_scope.emplace(loads);
+            }
+            // wall time of step minus the source loads it did, those are accounted separately
+            auto timed = [&](auto&& step)
+            {
+                double loaded = loads.ms;
+                auto step_start = Clock::now();
+                step();
+                return Milliseconds(step_start) - (loads.ms - loaded);
+            };
+            auto finish = [&](CompilationResult& ret_val)
+            {
+                bool from_file = std::holds_alternative<std::filesystem::path>(source.source);
+                if(options.cost && ret_val.error == CompilationError::None) ret_val.cost = AnalyzeCost(output.Code());
+                if(stats && ret_val.error == CompilationError::None)
+                {
+                    stats->load_ms = loads.ms;
+                    stats->input_bytes = loads.bytes;
+                    if(!from_file) stats->input_bytes += std::get<ShaderSource::StringSource>(source.source).shader.size();
+                    stats->include_count = dependencies.size() - (from_file && !dependencies.empty());
+                    stats->instructions_after = Spirv::InstructionCount(output.Code());
+                    stats->output_bytes = output.Bytes().size();
+                    stats->total_ms = Milliseconds(start);
+                    ret_val.stats = stats;
+                }
+                ret_val.dependencies = std::move(dependencies);
+            };
+            SpecializedSource specialized;
+            auto input = BackendSource(this, source, options, specialized);
+            if(!input)
+            {
+                CompilationResult ret_val;
+                ret_val.error = CompilationError::NonExistentFile;
+                ret_val.messages = "File passed in was not found";
+                finish(ret_val);
+                return ret_val;
+            }
+            std::string key;
+            if(Backend::State(this).cacheDir)
+            {
+                double preprocess_ms = timed([&]{ key = Cache::Key(this, *input, opt.get()); });
+                if(stats) stats->preprocess_ms = preprocess_ms;
+                if(auto cached = key.empty() ? std::nullopt : Cache::Load(this, key))
+                {
+                    auto owner = std::make_shared<std::vector<char>>(std::move(*cached));
+                    auto spirv = ShaderFileSpirv(*owner);
+                    output = ShaderBlob(owner, std::span((const uint32_t*)spirv.data(), spirv.size() / sizeof(uint32_t)));
+                    if(Backend::State(opt.get()).reflect)
+                    {
+                        auto trailer = ShaderFileTrailer(*owner);
+                        output.SetReflection(std::vector<char>(trailer.begin(), trailer.end()));
+                    }
+                    CompilationResult ret_val;
+                    ret_val.error = CompilationError::None;
+                    if(stats)
+                    {
+                        stats->cache_hit = true;
+                        stats->instructions_before = Spirv::InstructionCount(output.Code());
+                    }
+                    finish(ret_val);
+                    return ret_val;
+                }
+            }
+            else if(stats)
+            {
+                std::string preprocessed;
+                stats->preprocess_ms = timed([&]{ (void)Backend::Preprocess(this, *input, opt.get(), preprocessed); });
+            }
+            double unoptimized_ms = 0;
+            if(stats && options.level != OptimizationLevel::None)
+            {
+                auto unoptimized = opt->Clone();
+                unoptimized->SetOptimizationLevel(OptimizationLevel::None);
+                ShaderBlob blob;
+                unoptimized_ms = timed([&]{ (void)Backend::Compile(this, *input, unoptimized.get(), blob); });
+                stats->instructions_before = Spirv::InstructionCount(blob.Code());
+            }
+            CompilationResult ret_val;
+            double compile_ms = timed([&]{ ret_val = Backend::Compile(this, *input, opt.get(), output); });
+            if(ret_val.error == CompilationError::None && !options.specialized.empty())
+            {
+                // an #if on a specialized macro compiles fine but silently takes the undefined branch
+                auto misuse = SpecializationMisuse(this, source, dependencies, options);
+                if(!misuse.empty())
+                {
+                    ret_val.error = CompilationError::Error;
+                    ret_val.messages += misuse;
+                }
+            }
+            double postprocess_ms = 0;
+            if(ret_val.error == CompilationError::None)
+            {
+                // reflection reads the names stripping removes
+                std::vector<char> reflection;
+                if(options.reflect) reflection = Reflect(output.Code());
+                if(stats && options.level == OptimizationLevel::None)
+                    stats->instructions_before = Spirv::InstructionCount(output.Code());
+                if(options.strip || options.remap)
+                {
+                    size_t before = output.Bytes().size();
+                    postprocess_ms = timed([&]{ PostProcess(output, options, source, ret_val); });
+                    if(stats) stats->stripped_bytes = before - output.Bytes().size();
+                }
+                if(options.reflect) output.SetReflection(std::move(reflection));
+            }
+            if(ret_val.error == CompilationError::None && !key.empty())
+                Cache::Store(this, key, output);
+            if(stats && options.level == OptimizationLevel::None)
+            {
+                stats->codegen_ms = std::max(compile_ms - stats->preprocess_ms, 0.0);
+                stats->optimize_ms = postprocess_ms;
+            }
+            else if(stats)
+            {
+                stats->codegen_ms = std::max(unoptimized_ms - stats->preprocess_ms, 0.0);
+                stats->optimize_ms = std::max(compile_ms - unoptimized_ms, 0.0) + postprocess_ms;
+            }
+            finish(ret_val);
+            return ret_val;
+        }
+        CompilationResult Compiler::CompileToFile(const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const std::filesystem::path& output)
+        {
+            ShaderBlob blob;
+            auto ret_val = CompileToBlob(source, opt, blob);
+            if(ret_val.error != CompilationError::None) return ret_val;
+            OutputTimer timer(ret_val);
+            auto codec = Backend::State(opt.get()).compression;
+            size_t size = ShaderFileSize(blob.Bytes().size(), blob.Reflection().size());
+            bool written;
+            if(codec != ShaderCompression::None)
+            {
+                std::vector<char> compressed;
+                CompressedFile(blob, codec, compressed);
+                size = compressed.size();
+                written = WriteFileBytes(output, compressed);
+            }
+            else
+                written = WriteShaderFile(output, blob.Bytes(), blob.Reflection());
+            if(!written)
+            {
+                ret_val.error = CompilationError::Error;
+                ret_val.messages += "Failed to write " + output.string() + "\n";
+            }
+            timer.Finish(size);
+            return ret_val;
+        }
+        CompilationResult Compiler::CompileToBuffer(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, std::vector<char>& output, bool memory_repr)
+        {
+            CompilationResult ret_val;
+            if(memory_repr && api != RHI::API::Vulkan)
+            {
+                ret_val.messages = "Only Vulkan API shaders supported";
+                ret_val.error = CompilationError::APINotAvailable;
+                return ret_val;
+            }
+            ShaderBlob blob;
+            ret_val = CompileToBlob(source, opt, blob);
+            if(ret_val.error != CompilationError::None) return ret_val;
+            OutputTimer timer(ret_val);
+            output.clear();
+            auto codec = Backend::State(opt.get()).compression;
+            if(memory_repr)
+                output.assign(blob.Bytes().begin(), blob.Bytes().end());
+            else if(codec != ShaderCompression::None)
+                CompressedFile(blob, codec, output);
+            else
+                AppendShaderFile(output, blob.Bytes(), blob.Reflection());
+            timer.Finish(output.size());
+            return ret_val;
+        }
+        CompilationResult Compiler::CompileToAllocator(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& opt, const OutputAllocator& allocator, bool memory_repr)
+        {
+            CompilationResult ret_val;
+            if(memory_repr && api != RHI::API::Vulkan)
+            {
+                ret_val.messages = "Only Vulkan API shaders supported";
+                ret_val.error = CompilationError::APINotAvailable;
+                return ret_val;
+            }
+            ShaderBlob blob;
+            ret_val = CompileToBlob(source, opt, blob);
+            if(ret_val.error != CompilationError::None) return ret_val;
+            auto bytes = blob.Bytes();
+            OutputTimer timer(ret_val);
+            // the compressed size is only known after compressing
+            std::vector<char> compressed;
+            if(!memory_repr && Backend::State(opt.get()).compression != ShaderCompression::None)
+                CompressedFile(blob, Backend::State(opt.get()).compression, compressed);
+            size_t size = memory_repr ? bytes.size() : !compressed.empty() ? compressed.size() : ShaderFileSize(bytes.size(), blob.Reflection().size());
+            auto dest = static_cast<char*>(allocator(size));
+            if(!dest)
+            {
+                ret_val.error = CompilationError::Error;
+                ret_val.messages += "Output allocation failed\n";
+                return ret_val;
+            }
+            if(memory_repr)
+                std::memcpy(dest, bytes.data(), bytes.size());
+            else if(!compressed.empty())
+                std::memcpy(dest, compressed.data(), compressed.size());
+            else
+                SerializeShaderFile(bytes, blob.Reflection(), dest);
+            timer.Finish(size);
+            return ret_val;
+        }
+    }
+}
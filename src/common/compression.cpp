@@ -0,0 +1,102 @@
+#include "src/common/compression.h"
+#include <cstring>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            // limits of the LZ4 block format
+            constexpr size_t MinMatch = 4;
+            constexpr size_t LastLiterals = 5;
+            constexpr size_t MatchLimit = 12;
+            constexpr size_t MaxOffset = 65535;
+            constexpr uint32_t HashBits = 16;
+            // candidates LZ4HC looks at per position
+            constexpr uint32_t SearchDepth = 256;
+            uint32_t Read32(const char* data)
+            {
+                uint32_t value;
+                std::memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            uint32_t Hash(const char* data)
+            {
+                return (Read32(data) * 2654435761u) >> (32 - HashBits);
+            }
+            void Length(std::vector<char>& output, size_t value)
+            {
+                for(; value >= 255; value -= 255) output.push_back(char(255));
+                output.push_back(char(value));
+            }
+            void Sequence(std::vector<char>& output, std::span<const char> literals, size_t offset, size_t match)
+            {
+                size_t match_code = match ? match - MinMatch : 0;
+                output.push_back(char(std::min<size_t>(literals.size(), 15) << 4 | std::min<size_t>(match_code, 15)));
+                if(literals.size() >= 15) Length(output, literals.size() - 15);
+                output.insert(output.end(), literals.begin(), literals.end());
+                if(!match) return;
+                output.push_back(char(offset & 0xff));
+                output.push_back(char(offset >> 8));
+                if(match_code >= 15) Length(output, match_code - 15);
+            }
+            void CompressBlock(std::span<const char> input, bool exhaustive, std::vector<char>& output)
+            {
+                const char* data = input.data();
+                const size_t size = input.size();
+                std::vector<int64_t> head(size_t(1) << HashBits, -1);
+                // previous position with the same hash, only kept by the exhaustive search
+                std::vector<int64_t> chain(exhaustive ? size : 0, -1);
+                auto insert = [&](size_t pos)
+                {
+                    auto& bucket = head[Hash(data + pos)];
+                    if(exhaustive) chain[pos] = bucket;
+                    bucket = pos;
+                };
+                size_t anchor = 0;
+                size_t pos = 0;
+                while(size >= MatchLimit && pos + MatchLimit <= size)
+                {
+                    size_t best_length = 0, best_offset = 0;
+                    const size_t max_length = size - LastLiterals - pos;
+                    int64_t candidate = head[Hash(data + pos)];
+                    for(uint32_t depth = 0; candidate >= 0 && pos - candidate <= MaxOffset && depth < (exhaustive ? SearchDepth : 1); depth++)
+                    {
+                        if(Read32(data + candidate) == Read32(data + pos))
+                        {
+                            size_t length = MinMatch;
+                            while(length < max_length && data[candidate + length] == data[pos + length]) length++;
+                            if(length > best_length)
+                            {
+                                best_length = length;
+                                best_offset = pos - candidate;
+                            }
+                        }
+                        candidate = exhaustive ? chain[candidate] : -1;
+                    }
+                    if(best_length < MinMatch)
+                    {
+                        insert(pos++);
+                        continue;
+                    }
+                    Sequence(output, input.subspan(anchor, pos - anchor), best_offset, best_length);
+                    // positions inside the match are indexed too, except for the fast mode which only needs the start
+                    size_t end = pos + best_length;
+                    for(size_t i = pos; i < (exhaustive ? end : pos + 1) && i + MinMatch <= size; i++) insert(i);
+                    pos = anchor = end;
+                }
+                Sequence(output, input.subspan(anchor), 0, 0);
+            }
+        }
+        void CompressShaderFile(ShaderCompression codec, std::span<const char> file, std::vector<char>& output)
+        {
+            Compressed::Header header = {Compressed::Magic, codec, file.size(), 0};
+            output.assign(sizeof(header), 0);
+            // worst case is every byte a literal
+            output.reserve(sizeof(header) + file.size() + file.size() / 255 + 16);
+            CompressBlock(file, codec == ShaderCompression::LZ4HC, output);
+            header.compressed_size = output.size() - sizeof(header);
+            std::memcpy(output.data(), &header, sizeof(header));
+        }
+    }
+}
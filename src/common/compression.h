@@ -0,0 +1,12 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include <span>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Replaces output with the compressed file (Compressed::Header and the LZ4 block) holding file
+        void CompressShaderFile(ShaderCompression codec, std::span<const char> file, std::vector<char>& output);
+    }
+}
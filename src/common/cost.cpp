@@ -0,0 +1,364 @@
+#include "src/common/cost.h"
+#include "src/common/spirv.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            // GLSL.std.450 instructions from Sin to InverseSqrt
+            constexpr uint32_t FirstTranscendental = Spirv::GLSLstd450Sin, LastTranscendental = Spirv::GLSLstd450InverseSqrt;
+            // What one function contributes to the entry points reaching it
+            struct FunctionCost
+            {
+                ShaderCost cost;
+                std::vector<uint32_t> callees;
+                // module scope variables it accesses
+                std::unordered_set<uint32_t> globals;
+            };
+            struct Variable
+            {
+                uint32_t storage;
+                uint32_t type;
+            };
+            class CostAnalysis
+            {
+            public:
+                bool Load(std::span<const uint32_t> code)
+                {
+                    instructions = Spirv::Parse(code);
+                    if(instructions.empty()) return false;
+                    for(size_t i = 0; i < instructions.size(); i++)
+                    {
+                        auto& inst = instructions[i];
+                        auto& ops = inst.operands;
+                        switch(inst.opcode)
+                        {
+                            case Spirv::OpEntryPoint:
+                                if(ops.size() > 2) entries.push_back({ops[0], ops[1], Spirv::LiteralString(ops.subspan(2))});
+                                break;
+                            case Spirv::OpExtInstImport:
+                                if(ops.size() > 1 && Spirv::LiteralString(ops.subspan(1)) == "GLSL.std.450") glsl_sets.insert(ops[0]);
+                                break;
+                            case Spirv::OpDecorate:
+                                if(ops.size() > 1 && ops[1] == Spirv::DecorationBufferBlock) buffer_blocks.insert(ops[0]);
+                                break;
+                            case Spirv::OpConstant:
+                                if(ops.size() > 2) constants[ops[1]] = ops[2];
+                                break;
+                            case Spirv::OpVariable:
+                                // function variables are recorded by the function scan
+                                if(ops.size() > 2 && ops[2] != Spirv::StorageClassFunction)
+                                {
+                                    variables[ops[1]] = {ops[2], ops[0]};
+                                    pointer_storage[ops[1]] = ops[2];
+                                }
+                                break;
+                            case Spirv::OpFunction:
+                                if(ops.size() > 1) i = ScanFunction(i);
+                                break;
+                            default:
+                                if((inst.opcode >= Spirv::OpTypeVoid && inst.opcode <= Spirv::OpTypeFunction) && !ops.empty())
+                                    types[ops[0]] = &inst;
+                                break;
+                        }
+                    }
+                    return true;
+                }
+                std::vector<ShaderCost> EntryPoints() const
+                {
+                    std::vector<ShaderCost> costs;
+                    for(auto& [model, function, name] : entries)
+                    {
+                        auto& cost = costs.emplace_back();
+                        cost.entry_point = name;
+                        cost.stage = Stage(model);
+                        std::unordered_set<uint32_t> reached = {function}, globals;
+                        std::vector<uint32_t> pending = {function};
+                        while(!pending.empty())
+                        {
+                            auto it = functions.find(pending.back());
+                            pending.pop_back();
+                            if(it == functions.end()) continue;
+                            auto& part = it->second.cost;
+                            cost.alu += part.alu;
+                            cost.transcendental += part.transcendental;
+                            cost.texture += part.texture;
+                            cost.memory += part.memory;
+                            cost.barrier += part.barrier;
+                            cost.other += part.other;
+                            cost.peak_live_values = std::max(cost.peak_live_values, part.peak_live_values);
+                            cost.peak_live_scalars = std::max(cost.peak_live_scalars, part.peak_live_scalars);
+                            cost.functions++;
+                            cost.blocks += part.blocks;
+                            cost.branches += part.branches;
+                            cost.loops += part.loops;
+                            cost.max_loop_depth = std::max(cost.max_loop_depth, part.max_loop_depth);
+                            cost.loop_instructions += part.loop_instructions;
+                            cost.approximate |= part.approximate;
+                            globals.insert(it->second.globals.begin(), it->second.globals.end());
+                            for(auto callee : it->second.callees)
+                            {
+                                if(reached.insert(callee).second) pending.push_back(callee);
+                            }
+                        }
+                        for(auto id : globals)
+                            CountDescriptor(variables.at(id), cost);
+                    }
+                    return costs;
+                }
+            private:
+                struct EntryPoint
+                {
+                    uint32_t model, function;
+                    std::string name;
+                };
+                static ShaderStage Stage(uint32_t model)
+                {
+                    switch(model)
+                    {
+                        case Spirv::ExecutionModelVertex: return ShaderStage::Vertex;
+                        case Spirv::ExecutionModelTessellationControl: return ShaderStage::Hull;
+                        case Spirv::ExecutionModelTessellationEvaluation: return ShaderStage::Domain;
+                        case Spirv::ExecutionModelGeometry: return ShaderStage::Geometry;
+                        case Spirv::ExecutionModelFragment: return ShaderStage::Pixel;
+                        case Spirv::ExecutionModelGLCompute: return ShaderStage::Compute;
+                        default: return ShaderStage::None;
+                    }
+                }
+                const Spirv::Instruction* Type(uint32_t id) const
+                {
+                    auto it = types.find(id);
+                    return it == types.end() ? nullptr : it->second;
+                }
+                // 32 bit registers a value of the type takes, 0 for pointers, descriptors and void
+                uint32_t Scalars(uint32_t id)
+                {
+                    if(auto it = scalars.find(id); it != scalars.end()) return it->second;
+                    auto type = Type(id);
+                    uint32_t count = 0;
+                    if(type)
+                    {
+                        auto& ops = type->operands;
+                        switch(type->opcode)
+                        {
+                            case Spirv::OpTypeBool: count = 1; break;
+                            case Spirv::OpTypeInt: case Spirv::OpTypeFloat: count = ops.size() > 1 && ops[1] == 64 ? 2 : 1; break;
+                            case Spirv::OpTypeVector: case Spirv::OpTypeMatrix: count = ops.size() > 2 ? Scalars(ops[1]) * ops[2] : 0; break;
+                            case Spirv::OpTypeArray:
+                            {
+                                auto length = ops.size() > 2 ? constants.find(ops[2]) : constants.end();
+                                count = length == constants.end() ? 0 : Scalars(ops[1]) * length->second;
+                                break;
+                            }
+                            case Spirv::OpTypeStruct:
+                                for(auto member : ops.subspan(1)) count += Scalars(member);
+                                break;
+                            default: break;
+                        }
+                    }
+                    scalars[id] = count;
+                    return count;
+                }
+                // Buffers, storage images and shared memory, registers and interface variables not included. Pointers
+                // of unknown origin are function parameters, which point at function variables
+                bool Memory(uint32_t pointer) const
+                {
+                    auto it = pointer_storage.find(pointer);
+                    if(it == pointer_storage.end()) return false;
+                    switch(it->second)
+                    {
+                        case Spirv::StorageClassFunction: case Spirv::StorageClassPrivate: case Spirv::StorageClassInput:
+                        case Spirv::StorageClassOutput: case Spirv::StorageClassUniformConstant:
+                            return false;
+                        default:
+                            return true;
+                    }
+                }
+                void CountDescriptor(const Variable& var, ShaderCost& cost) const
+                {
+                    auto pointer = Type(var.type);
+                    if(!pointer || pointer->operands.size() < 3) return;
+                    uint32_t pointee = pointer->operands[2];
+                    auto type = Type(pointee);
+                    while(type && (type->opcode == Spirv::OpTypeArray || type->opcode == Spirv::OpTypeRuntimeArray) && type->operands.size() > 1)
+                    {
+                        pointee = type->operands[1];
+                        type = Type(pointee);
+                    }
+                    if(!type) return;
+                    switch(var.storage)
+                    {
+                        case Spirv::StorageClassUniformConstant:
+                            // the sampled operand of an image is 2 for storage images
+                            if(type->opcode == Spirv::OpTypeImage && type->operands.size() > 6 && type->operands[6] == 2) cost.storage_images++;
+                            else if(type->opcode == Spirv::OpTypeImage || type->opcode == Spirv::OpTypeSampledImage) cost.textures++;
+                            else if(type->opcode == Spirv::OpTypeSampler) cost.samplers++;
+                            break;
+                        case Spirv::StorageClassUniform:
+                            (buffer_blocks.contains(pointee) ? cost.storage_buffers : cost.uniform_buffers)++;
+                            break;
+                        case Spirv::StorageClassStorageBuffer:
+                            cost.storage_buffers++;
+                            break;
+                        case Spirv::StorageClassPushConstant:
+                            cost.push_constants = true;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                // Counts the function starting at begin and returns the index of its OpFunctionEnd
+                size_t ScanFunction(size_t begin)
+                {
+                    auto& function = functions[instructions[begin].operands[1]];
+                    auto& cost = function.cost;
+                    struct Value
+                    {
+                        uint32_t start, end, scalars;
+                    };
+                    std::unordered_map<uint32_t, Value> values;
+                    std::unordered_map<uint32_t, uint32_t> labels;
+                    // header and merge block of every loop
+                    std::vector<std::pair<uint32_t, uint32_t>> loops;
+                    // merge blocks of the loops the current instruction is in, by layout
+                    std::vector<uint32_t> open_loops;
+                    uint32_t block = 0;
+                    Spirv::OperandLayout layout;
+                    size_t i = begin;
+                    uint32_t position = 0;
+                    for(; i < instructions.size() && instructions[i].opcode != Spirv::OpFunctionEnd; i++, position++)
+                    {
+                        auto& inst = instructions[i];
+                        auto& ops = inst.operands;
+                        bool described = Spirv::Describe(inst, layout);
+                        cost.approximate |= !described;
+                        if(described)
+                        {
+                            for(auto use : layout.uses)
+                            {
+                                if(auto value = values.find(ops[use]); value != values.end())
+                                    value->second.end = std::max(value->second.end, position);
+                                else if(variables.contains(ops[use]))
+                                    function.globals.insert(ops[use]);
+                            }
+                            if(layout.has_type && ops.size() > 1 && inst.opcode != Spirv::OpFunction)
+                            {
+                                if(uint32_t count = Scalars(ops[0])) values[ops[1]] = {position, position, count};
+                            }
+                        }
+                        uint32_t* counter = &cost.other;
+                        switch(inst.opcode)
+                        {
+                            case Spirv::OpFunction: case Spirv::OpFunctionParameter: case Spirv::OpLine: case Spirv::OpNoLine:
+                                continue;
+                            case Spirv::OpLabel:
+                                if(ops.empty()) continue;
+                                block = ops[0];
+                                labels[block] = position;
+                                while(!open_loops.empty() && open_loops.back() == block) open_loops.pop_back();
+                                cost.blocks++;
+                                continue;
+                            case Spirv::OpVariable:
+                                if(ops.size() > 2) pointer_storage[ops[1]] = ops[2];
+                                continue;
+                            case Spirv::OpLoopMerge:
+                                if(ops.empty()) break;
+                                cost.loops++;
+                                loops.emplace_back(block, ops[0]);
+                                open_loops.push_back(ops[0]);
+                                cost.max_loop_depth = std::max<uint32_t>(cost.max_loop_depth, open_loops.size());
+                                break;
+                            case Spirv::OpBranchConditional: case Spirv::OpSwitch:
+                                cost.branches++;
+                                break;
+                            case Spirv::OpFunctionCall:
+                                if(ops.size() > 2) function.callees.push_back(ops[2]);
+                                break;
+                            case Spirv::OpAccessChain: case Spirv::OpInBoundsAccessChain: case Spirv::OpPtrAccessChain:
+                            case Spirv::OpInBoundsPtrAccessChain:
+                                if(ops.size() > 2)
+                                {
+                                    if(auto base = pointer_storage.find(ops[2]); base != pointer_storage.end())
+                                        pointer_storage[ops[1]] = base->second;
+                                }
+                                break;
+                            case Spirv::OpLoad:
+                                if(ops.size() > 2 && Memory(ops[2])) counter = &cost.memory;
+                                break;
+                            case Spirv::OpStore: case Spirv::OpCopyMemory: case Spirv::OpCopyMemorySized:
+                                if(!ops.empty() && (Memory(ops[0]) || (inst.opcode != Spirv::OpStore && ops.size() > 1 && Memory(ops[1]))))
+                                    counter = &cost.memory;
+                                break;
+                            case Spirv::OpExtInst:
+                                // non-semantic sets only carry debug information
+                                if(ops.size() < 4 || !glsl_sets.contains(ops[2])) continue;
+                                counter = ops[3] >= FirstTranscendental && ops[3] <= LastTranscendental ? &cost.transcendental : &cost.alu;
+                                break;
+                            default:
+                            {
+                                uint32_t op = inst.opcode;
+                                if((op >= Spirv::OpImageSampleImplicitLod && op <= Spirv::OpImageDrefGather) ||
+                                    (op >= Spirv::OpImageSparseSampleImplicitLod && op <= Spirv::OpImageSparseDrefGather))
+                                    counter = &cost.texture;
+                                else if(op == Spirv::OpImageRead || op == Spirv::OpImageWrite || op == Spirv::OpImageSparseRead ||
+                                    (op >= Spirv::OpAtomicLoad && op <= Spirv::OpAtomicXor))
+                                    counter = &cost.memory;
+                                else if(op == Spirv::OpControlBarrier || op == Spirv::OpMemoryBarrier) counter = &cost.barrier;
+                                else if((op >= Spirv::OpConvertFToU && op <= Spirv::OpBitCount) || (op >= Spirv::OpDPdx && op <= Spirv::OpFwidthCoarse))
+                                    counter = &cost.alu;
+                                break;
+                            }
+                        }
+                        (*counter)++;
+                        if(!open_loops.empty()) cost.loop_instructions++;
+                    }
+                    // a value defined ahead of a loop and used in it stays alive for every iteration
+                    for(auto& [header, merge] : loops)
+                    {
+                        uint32_t start = labels.contains(header) ? labels[header] : 0;
+                        uint32_t end = labels.contains(merge) ? labels[merge] : position;
+                        for(auto& [id, value] : values)
+                        {
+                            if(value.start < start && value.end >= start && value.end < end) value.end = end;
+                        }
+                    }
+                    std::vector<int64_t> live_values(position + 2, 0), live_scalars(position + 2, 0);
+                    for(auto& [id, value] : values)
+                    {
+                        live_values[value.start]++;
+                        live_values[value.end + 1]--;
+                        live_scalars[value.start] += value.scalars;
+                        live_scalars[value.end + 1] -= value.scalars;
+                    }
+                    int64_t count = 0, components = 0;
+                    for(uint32_t p = 0; p <= position; p++)
+                    {
+                        count += live_values[p];
+                        components += live_scalars[p];
+                        cost.peak_live_values = std::max<uint32_t>(cost.peak_live_values, count);
+                        cost.peak_live_scalars = std::max<uint32_t>(cost.peak_live_scalars, components);
+                    }
+                    return i;
+                }
+                std::vector<Spirv::Instruction> instructions;
+                std::vector<EntryPoint> entries;
+                std::unordered_set<uint32_t> glsl_sets, buffer_blocks;
+                std::unordered_map<uint32_t, uint32_t> constants, pointer_storage, scalars;
+                std::unordered_map<uint32_t, const Spirv::Instruction*> types;
+                std::unordered_map<uint32_t, Variable> variables;
+                std::unordered_map<uint32_t, FunctionCost> functions;
+            };
+        }
+        std::vector<ShaderCost> AnalyzeCost(std::span<const uint32_t> spirv)
+        {
+            CostAnalysis analysis;
+            if(!analysis.Load(spirv)) return {};
+            return analysis.EntryPoints();
+        }
+    }
+}
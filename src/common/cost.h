@@ -0,0 +1,13 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // The cost of every entry point of a module (see ShaderCost), empty if the module can't be parsed
+        std::vector<ShaderCost> AnalyzeCost(std::span<const uint32_t> spirv);
+    }
+}
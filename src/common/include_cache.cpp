@@ -0,0 +1,182 @@
+#include "src/common/include_cache.h"
+#include "include/rhi_sc_archive.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        static thread_local FileSystem* current_files = nullptr;
+        static thread_local std::vector<std::filesystem::path>* current_dependencies = nullptr;
+        static thread_local LoadStats* current_stats = nullptr;
+        namespace
+        {
+            // Sources stored in a mapped archive, the owner of every file is the archive
+            class ArchiveFileSystem : public FileSystem
+            {
+            public:
+                explicit ArchiveFileSystem(std::shared_ptr<const ShaderArchive> archive) : archive(std::move(archive))
+                {
+                }
+                std::optional<SourceFile> Open(const std::filesystem::path& path) override
+                {
+                    auto entry = archive->Find(path.lexically_normal().generic_string());
+                    if(!entry) return std::nullopt;
+                    auto bytes = entry->Bytes();
+                    return SourceFile{std::string_view(bytes.data(), bytes.size()), archive};
+                }
+            private:
+                std::shared_ptr<const ShaderArchive> archive;
+            };
+        }
+        std::shared_ptr<FileSystem> FileSystem::Directory(std::filesystem::path root)
+        {
+            return std::make_shared<FileCache>(std::move(root));
+        }
+        std::shared_ptr<FileSystem> FileSystem::MapArchive(const std::filesystem::path& path)
+        {
+            auto archive = ShaderArchive::Open(path);
+            if(!archive) return nullptr;
+            return std::make_shared<ArchiveFileSystem>(std::make_shared<const ShaderArchive>(std::move(*archive)));
+        }
+        std::shared_ptr<MemoryFileSystem> MemoryFileSystem::New()
+        {
+            return std::make_shared<MemoryFileSystem>();
+        }
+        void MemoryFileSystem::Write(const std::filesystem::path& path, std::string text)
+        {
+            auto content = std::make_shared<const std::string>(std::move(text));
+            Write(path, *content, content);
+        }
+        void MemoryFileSystem::Write(const std::filesystem::path& path, std::string_view text, std::shared_ptr<const void> owner)
+        {
+            auto key = path.lexically_normal().generic_string();
+            std::lock_guard lock(mutex);
+            files.insert_or_assign(std::move(key), SourceFile{text, std::move(owner)});
+        }
+        void MemoryFileSystem::Remove(const std::filesystem::path& path)
+        {
+            std::lock_guard lock(mutex);
+            files.erase(path.lexically_normal().generic_string());
+        }
+        std::optional<SourceFile> MemoryFileSystem::Open(const std::filesystem::path& path)
+        {
+            auto key = path.lexically_normal().generic_string();
+            std::lock_guard lock(mutex);
+            auto it = files.find(key);
+            if(it == files.end()) return std::nullopt;
+            return it->second;
+        }
+        FileCache::FileCache(std::filesystem::path root) : root(std::move(root))
+        {
+        }
+        std::filesystem::path FileCache::Resolve(const std::filesystem::path& path) const
+        {
+            return root.empty() ? path : root / path;
+        }
+        std::optional<SourceFile> FileCache::Open(const std::filesystem::path& path)
+        {
+            auto content = Load(path);
+            if(!content) return std::nullopt;
+            return SourceFile{*content, content};
+        }
+        std::shared_ptr<const std::string> FileCache::Load(const std::filesystem::path& requested)
+        {
+            auto path = Resolve(requested);
+            auto key = path.lexically_normal().native();
+            std::error_code ec;
+            auto time = std::filesystem::last_write_time(path, ec);
+            auto size = ec ? 0 : std::filesystem::file_size(path, ec);
+            if(ec)
+            {
+                std::lock_guard lock(mutex);
+                files.erase(key);
+                return nullptr;
+            }
+            {
+                std::lock_guard lock(mutex);
+                if(auto it = files.find(key); it != files.end() && it->second.time == time && it->second.size == size)
+                    return it->second.content;
+            }
+            // read without holding the lock, the last thread to finish reading wins
+            auto content = ReadSourceFile(path);
+            if(!content) return nullptr;
+            std::lock_guard lock(mutex);
+            files.insert_or_assign(std::move(key), Entry{content, time, size});
+            return content;
+        }
+        void FileCache::Invalidate()
+        {
+            std::lock_guard lock(mutex);
+            files.clear();
+        }
+        void FileCache::Invalidate(const std::filesystem::path& path)
+        {
+            std::lock_guard lock(mutex);
+            files.erase(Resolve(path).lexically_normal().native());
+        }
+        IncludeScope::IncludeScope(FileSystem* files) : previous(current_files)
+        {
+            current_files = files;
+        }
+        IncludeScope::~IncludeScope()
+        {
+            current_files = previous;
+        }
+        DependencyScope::DependencyScope(std::vector<std::filesystem::path>& files) : previous(current_dependencies)
+        {
+            current_dependencies = &files;
+        }
+        DependencyScope::~DependencyScope()
+        {
+            current_dependencies = previous;
+        }
+        LoadStatsScope::LoadStatsScope(LoadStats& stats) : previous(current_stats)
+        {
+            current_stats = &stats;
+        }
+        LoadStatsScope::~LoadStatsScope()
+        {
+            current_stats = previous;
+        }
+        std::shared_ptr<const std::string> ReadSourceFile(const std::filesystem::path& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return nullptr;
+            auto content = std::make_shared<std::string>();
+            std::error_code ec;
+            if(auto size = std::filesystem::file_size(path, ec); !ec)
+                content->reserve(size);
+            content->assign(std::istreambuf_iterator(file), std::istreambuf_iterator<char>());
+            return content;
+        }
+        std::optional<SourceFile> LoadSourceFile(const std::filesystem::path& path)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::optional<SourceFile> content;
+            if(current_files)
+                content = current_files->Open(path);
+            else if(auto text = ReadSourceFile(path))
+                content = SourceFile{*text, text};
+            bool first = true;
+            if(content && current_dependencies)
+            {
+                auto normal = path.lexically_normal();
+                first = std::find(current_dependencies->begin(), current_dependencies->end(), normal) == current_dependencies->end();
+                if(first) current_dependencies->push_back(std::move(normal));
+            }
+            if(current_stats)
+            {
+                current_stats->ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if(content && first)
+                {
+                    current_stats->bytes += content->text.size();
+                    current_stats->files++;
+                }
+            }
+            return content;
+        }
+    }
+}
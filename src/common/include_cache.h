@@ -0,0 +1,83 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Thread safe store of source file contents shared between compilations, the default file system of a Compiler.
+        // Entries are revalidated against the file's modification time and size on every load
+        class FileCache : public FileSystem
+        {
+        public:
+            FileCache() = default;
+            // relative paths are resolved against root
+            explicit FileCache(std::filesystem::path root);
+            // nullptr if the file can't be read
+            std::shared_ptr<const std::string> Load(const std::filesystem::path& path);
+            std::optional<SourceFile> Open(const std::filesystem::path& path) override;
+            void Invalidate();
+            void Invalidate(const std::filesystem::path& path);
+        private:
+            struct Entry
+            {
+                std::shared_ptr<const std::string> content;
+                std::filesystem::file_time_type time;
+                uintmax_t size;
+            };
+            std::filesystem::path Resolve(const std::filesystem::path& path) const;
+            std::filesystem::path root;
+            std::mutex mutex;
+            std::unordered_map<std::filesystem::path::string_type, Entry> files;
+        };
+        // While alive, source files loaded on this thread (main sources and includes) are read through files
+        class IncludeScope
+        {
+        public:
+            explicit IncludeScope(FileSystem* files);
+            ~IncludeScope();
+            IncludeScope(const IncludeScope&) = delete;
+            IncludeScope& operator=(const IncludeScope&) = delete;
+        private:
+            FileSystem* previous;
+        };
+        // While alive, every source file successfully loaded on this thread is appended to files (once)
+        class DependencyScope
+        {
+        public:
+            explicit DependencyScope(std::vector<std::filesystem::path>& files);
+            ~DependencyScope();
+            DependencyScope(const DependencyScope&) = delete;
+            DependencyScope& operator=(const DependencyScope&) = delete;
+        private:
+            std::vector<std::filesystem::path>* previous;
+        };
+        // Time spent in LoadSourceFile and the size of the distinct files it returned
+        struct LoadStats
+        {
+            double ms = 0;
+            uint64_t bytes = 0;
+            uint32_t files = 0;
+        };
+        // While alive, loads on this thread are accounted in stats. Files are counted once if a DependencyScope is active
+        class LoadStatsScope
+        {
+        public:
+            explicit LoadStatsScope(LoadStats& stats);
+            ~LoadStatsScope();
+            LoadStatsScope(const LoadStatsScope&) = delete;
+            LoadStatsScope& operator=(const LoadStatsScope&) = delete;
+        private:
+            LoadStats* previous;
+        };
+        std::shared_ptr<const std::string> ReadSourceFile(const std::filesystem::path& path);
+        // Reads through the current thread's IncludeScope if there is one, nullopt if the file can't be read
+        std::optional<SourceFile> LoadSourceFile(const std::filesystem::path& path);
+    }
+}
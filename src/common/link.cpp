@@ -0,0 +1,384 @@
+#include "src/common/link.h"
+#include "src/common/spirv.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Spirv
+        {
+            namespace
+            {
+                // Annotations and debug names refer to an id without keeping it alive
+                bool Annotation(uint32_t opcode)
+                {
+                    return opcode == OpName || opcode == OpMemberName || opcode == OpDecorate || opcode == OpMemberDecorate ||
+                        opcode == OpDecorateString || opcode == OpMemberDecorateString || opcode == OpDecorateId;
+                }
+                // Instructions in a function body that can go once their result is unused
+                bool Pure(const Instruction& inst, const std::unordered_set<uint32_t>& glsl_sets)
+                {
+                    uint32_t op = inst.opcode;
+                    if(op == OpExtInst)
+                    {
+                        // Modf and Frexp write through a pointer
+                        auto& ops = inst.operands;
+                        return ops.size() > 3 && glsl_sets.contains(ops[2]) && ops[3] != GLSLstd450Modf && ops[3] != GLSLstd450Frexp;
+                    }
+                    return op == OpUndef || op == OpLoad || op == OpAccessChain || op == OpInBoundsAccessChain ||
+                        (op >= OpVectorExtractDynamic && op <= OpTranspose) || (op >= OpSampledImage && op <= OpImageRead) ||
+                        (op >= OpImage && op <= OpImageQuerySamples) || (op >= OpConvertFToU && op <= OpBitcast) ||
+                        (op >= OpSNegate && op <= OpBitCount) || (op >= OpDPdx && op <= OpFwidthCoarse) || op == OpPhi;
+                }
+                // Module scope declarations that can go once nothing refers to them
+                bool Declaration(uint32_t op)
+                {
+                    return op == OpConstantTrue || op == OpConstantFalse || op == OpConstant || op == OpConstantComposite ||
+                        op == OpConstantNull || op == OpUndef || op == OpTypePointer;
+                }
+            }
+            std::optional<StageInterface> Interface(std::span<const uint32_t> code)
+            {
+                auto instructions = Parse(code);
+                if(instructions.empty()) return std::nullopt;
+                struct Decorations
+                {
+                    std::optional<uint32_t> location;
+                    uint32_t component = 0;
+                    bool builtin = false, patch = false;
+                };
+                std::unordered_map<uint32_t, Decorations> decorations;
+                std::unordered_map<uint32_t, std::string> names;
+                std::unordered_map<uint32_t, const Instruction*> types;
+                std::unordered_map<uint32_t, uint32_t> constants;
+                // structs with builtin members, like gl_PerVertex
+                std::unordered_set<uint32_t> builtin_blocks;
+                std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> variables;
+                std::span<const uint32_t> interface;
+                StageInterface stage;
+                bool has_entry = false;
+                for(auto& inst : instructions)
+                {
+                    auto& ops = inst.operands;
+                    switch(inst.opcode)
+                    {
+                        case OpEntryPoint:
+                        {
+                            if(ops.size() < 3 || has_entry) break;
+                            has_entry = true;
+                            stage.model = ops[0];
+                            size_t words = 0;
+                            LiteralString(ops.subspan(2), &words);
+                            interface = ops.subspan(std::min(ops.size(), 2 + words));
+                            break;
+                        }
+                        case OpName:
+                            if(ops.size() > 1) names[ops[0]] = LiteralString(ops.subspan(1));
+                            break;
+                        case OpDecorate:
+                        {
+                            if(ops.size() < 2) break;
+                            auto& dec = decorations[ops[0]];
+                            if(ops[1] == DecorationLocation && ops.size() > 2) dec.location = ops[2];
+                            else if(ops[1] == DecorationComponent && ops.size() > 2) dec.component = ops[2];
+                            else if(ops[1] == DecorationBuiltIn) dec.builtin = true;
+                            else if(ops[1] == DecorationPatch) dec.patch = true;
+                            break;
+                        }
+                        case OpMemberDecorate:
+                            if(ops.size() > 2 && ops[2] == DecorationBuiltIn) builtin_blocks.insert(ops[0]);
+                            break;
+                        case OpConstant:
+                            if(ops.size() > 2) constants[ops[1]] = ops[2];
+                            break;
+                        case OpVariable:
+                            if(ops.size() > 2) variables[ops[1]] = {ops[0], ops[2]};
+                            break;
+                        default:
+                            if(inst.opcode >= OpTypeVoid && inst.opcode <= OpTypeFunction && !ops.empty())
+                                types[ops[0]] = &inst;
+                            break;
+                    }
+                }
+                if(!has_entry) return std::nullopt;
+                auto type = [&](uint32_t id) -> const Instruction*
+                {
+                    auto it = types.find(id);
+                    return it == types.end() ? nullptr : it->second;
+                };
+                // fills the locations and component type of var from its type
+                auto describe = [&](auto&& self, uint32_t id, InterfaceVariable& var) -> uint32_t
+                {
+                    auto inst = type(id);
+                    if(!inst) return 1;
+                    auto& ops = inst->operands;
+                    switch(inst->opcode)
+                    {
+                        case OpTypeBool: case OpTypeInt: case OpTypeFloat:
+                            var.scalar = inst->opcode;
+                            var.width = inst->opcode == OpTypeBool ? 32 : ops.size() > 1 ? ops[1] : 32;
+                            var.components = 1;
+                            return 1;
+                        case OpTypeVector:
+                            if(ops.size() < 3) return 1;
+                            self(self, ops[1], var);
+                            var.components = ops[2];
+                            // 64 bit vectors with more than two components take two locations
+                            return var.width == 64 && ops[2] > 2 ? 2 : 1;
+                        case OpTypeMatrix:
+                            if(ops.size() < 3) return 1;
+                            return self(self, ops[1], var) * ops[2];
+                        case OpTypeArray:
+                        {
+                            if(ops.size() < 3) return 1;
+                            auto length = constants.find(ops[2]);
+                            return self(self, ops[1], var) * (length == constants.end() ? 1 : length->second);
+                        }
+                        case OpTypeStruct:
+                        {
+                            uint32_t locations = 0;
+                            for(auto member : ops.subspan(1))
+                                locations += self(self, member, var);
+                            var.scalar = 0;
+                            var.components = 0;
+                            return std::max<uint32_t>(locations, 1);
+                        }
+                        default:
+                            var.scalar = 0;
+                            return 1;
+                    }
+                };
+                auto builtin = [&](uint32_t id)
+                {
+                    // through the pointer and any arrays down to the block
+                    while(auto inst = type(id))
+                    {
+                        auto& ops = inst->operands;
+                        if(inst->opcode == OpTypeStruct) return builtin_blocks.contains(id);
+                        if(inst->opcode == OpTypePointer && ops.size() > 2) id = ops[2];
+                        else if((inst->opcode == OpTypeArray || inst->opcode == OpTypeRuntimeArray) && ops.size() > 1) id = ops[1];
+                        else return false;
+                    }
+                    return false;
+                };
+                for(auto id : interface)
+                {
+                    auto variable = variables.find(id);
+                    if(variable == variables.end()) continue;
+                    auto [pointer, storage] = variable->second;
+                    if(storage != StorageClassInput && storage != StorageClassOutput) continue;
+                    auto& dec = decorations[id];
+                    if(dec.builtin || builtin(pointer)) continue;
+                    if(!dec.location)
+                    {
+                        stage.opaque = true;
+                        continue;
+                    }
+                    InterfaceVariable var;
+                    var.id = id;
+                    var.location = *dec.location;
+                    var.component = dec.component;
+                    var.patch = dec.patch;
+                    if(auto it = names.find(id); it != names.end()) var.name = it->second;
+                    uint32_t pointee = 0;
+                    if(auto ptr = type(pointer); ptr && ptr->opcode == OpTypePointer && ptr->operands.size() > 2) pointee = ptr->operands[2];
+                    // every vertex of the patch or primitive has its own copy
+                    bool arrayed = !dec.patch && (stage.model == ExecutionModelTessellationControl ||
+                        (storage == StorageClassInput && (stage.model == ExecutionModelTessellationEvaluation || stage.model == ExecutionModelGeometry)));
+                    if(auto array = type(pointee); arrayed && array && (array->opcode == OpTypeArray || array->opcode == OpTypeRuntimeArray) && array->operands.size() > 1)
+                        pointee = array->operands[1];
+                    var.locations = describe(describe, pointee, var);
+                    (storage == StorageClassInput ? stage.inputs : stage.outputs).push_back(std::move(var));
+                }
+                return stage;
+            }
+            bool RemoveInterface(std::span<const uint32_t> code, std::span<const uint32_t> variables, bool drop_inputs, std::vector<uint32_t>& output, std::vector<uint32_t>& removed)
+            {
+                auto instructions = Parse(code);
+                if(instructions.empty()) return false;
+                const uint32_t bound = code[3];
+                std::unordered_set<uint32_t> glsl_sets;
+                // instruction defining every id, the instructions using it and how many of those are left
+                std::vector<uint32_t> definition(bound, UINT32_MAX);
+                std::vector<std::vector<uint32_t>> users(bound);
+                std::vector<uint32_t> use_count(bound, 0);
+                std::vector<char> in_function(instructions.size(), false);
+                std::vector<char> dead(instructions.size(), false);
+                std::vector<OperandLayout> layouts(instructions.size());
+                std::unordered_set<uint32_t> interface_ids, located;
+                // the operands of an instruction that keep the ids they name alive
+                auto counted = [&](uint32_t i) -> std::span<const uint32_t>
+                {
+                    std::span<const uint32_t> uses = layouts[i].uses;
+                    switch(instructions[i].opcode)
+                    {
+                        case OpName: case OpMemberName: case OpDecorate: case OpMemberDecorate: case OpDecorateString:
+                        case OpMemberDecorateString: case OpExecutionMode:
+                            return {};
+                        // the target is annotated, the other ids are operands
+                        case OpDecorateId: case OpExecutionModeId:
+                            return uses.subspan(std::min<size_t>(uses.size(), 1));
+                        // only the function is kept alive, the interface list follows what is left
+                        case OpEntryPoint:
+                            return uses.first(std::min<size_t>(uses.size(), 1));
+                        default:
+                            return uses;
+                    }
+                };
+                bool function = false;
+                for(uint32_t i = 0; i < instructions.size(); i++)
+                {
+                    auto& inst = instructions[i];
+                    auto& ops = inst.operands;
+                    auto& layout = layouts[i];
+                    if(!Describe(inst, layout)) return false;
+                    if(inst.opcode == OpExtInstImport && ops.size() > 1 && LiteralString(ops.subspan(1)) == "GLSL.std.450")
+                        glsl_sets.insert(ops[0]);
+                    else if(inst.opcode == OpDecorate && ops.size() > 1 && ops[1] == DecorationLocation)
+                        located.insert(ops[0]);
+                    else if(inst.opcode == OpEntryPoint)
+                    {
+                        for(size_t u = 1; u < layout.uses.size(); u++) interface_ids.insert(ops[layout.uses[u]]);
+                    }
+                    if(inst.opcode == OpFunction) function = true;
+                    in_function[i] = function;
+                    if(inst.opcode == OpFunctionEnd) function = false;
+                    if(layout.has_type && !ops.empty())
+                    {
+                        if(ops[0] >= bound) return false;
+                        users[ops[0]].push_back(i);
+                        use_count[ops[0]]++;
+                    }
+                    uint32_t index = layout.has_type ? 1 : 0;
+                    if(layout.has_result && index < ops.size())
+                    {
+                        if(ops[index] >= bound) return false;
+                        definition[ops[index]] = i;
+                    }
+                    for(auto use : counted(i))
+                    {
+                        if(ops[use] >= bound) return false;
+                        users[ops[use]].push_back(i);
+                        use_count[ops[use]]++;
+                    }
+                }
+                auto result = [&](uint32_t i) -> std::optional<uint32_t>
+                {
+                    auto& ops = instructions[i].operands;
+                    uint32_t index = layouts[i].has_type ? 1 : 0;
+                    if(!layouts[i].has_result || index >= ops.size()) return std::nullopt;
+                    return ops[index];
+                };
+                std::vector<uint32_t> worklist;
+                auto release = [&](uint32_t id)
+                {
+                    if(use_count[id] > 0 && --use_count[id] == 0 && definition[id] != UINT32_MAX) worklist.push_back(definition[id]);
+                };
+                auto kill = [&](uint32_t i)
+                {
+                    if(dead[i]) return;
+                    dead[i] = true;
+                    auto& ops = instructions[i].operands;
+                    if(layouts[i].has_type && !ops.empty()) release(ops[0]);
+                    for(auto use : counted(i)) release(ops[use]);
+                };
+                // the stores and access chains through which id is written, false if it's also read or escapes
+                auto written_only = [&](auto&& self, uint32_t id, std::vector<uint32_t>& writes) -> bool
+                {
+                    for(auto user : users[id])
+                    {
+                        if(dead[user]) continue;
+                        auto& inst = instructions[user];
+                        auto& ops = inst.operands;
+                        if(inst.opcode == OpStore && ops.size() > 1 && ops[0] == id && ops[1] != id)
+                            writes.push_back(user);
+                        else if((inst.opcode == OpAccessChain || inst.opcode == OpInBoundsAccessChain) && ops.size() > 2 && ops[2] == id)
+                        {
+                            writes.push_back(user);
+                            if(!self(self, ops[1], writes)) return false;
+                        }
+                        else
+                            return false;
+                    }
+                    return true;
+                };
+                auto remove_variable = [&](uint32_t id)
+                {
+                    std::vector<uint32_t> writes;
+                    if(id >= bound || definition[id] == UINT32_MAX || !written_only(written_only, id, writes)) return false;
+                    for(auto write : writes) kill(write);
+                    kill(definition[id]);
+                    return true;
+                };
+                for(auto id : variables)
+                {
+                    if(remove_variable(id)) removed.push_back(id);
+                }
+                // results that were unused to begin with
+                for(uint32_t i = 0; i < instructions.size(); i++)
+                {
+                    if(auto id = result(i); id && use_count[*id] == 0) worklist.push_back(i);
+                }
+                while(true)
+                {
+                    while(!worklist.empty())
+                    {
+                        uint32_t i = worklist.back();
+                        worklist.pop_back();
+                        auto id = result(i);
+                        if(dead[i] || !id || use_count[*id] > 0) continue;
+                        if(in_function[i] ? Pure(instructions[i], glsl_sets) : Declaration(instructions[i].opcode))
+                            kill(i);
+                    }
+                    // variables that are only written, their stores keep them alive so they are looked at separately
+                    bool progress = false;
+                    for(uint32_t i = 0; i < instructions.size(); i++)
+                    {
+                        auto& inst = instructions[i];
+                        auto& ops = inst.operands;
+                        if(dead[i] || inst.opcode != OpVariable || ops.size() < 3) continue;
+                        uint32_t storage = ops[2];
+                        bool input = drop_inputs && storage == StorageClassInput && interface_ids.contains(ops[1]) && located.contains(ops[1]);
+                        if(storage != StorageClassFunction && storage != StorageClassPrivate && !input) continue;
+                        if(input && use_count[ops[1]] > 0) continue;
+                        if(remove_variable(ops[1]))
+                        {
+                            if(input) removed.push_back(ops[1]);
+                            progress = true;
+                        }
+                    }
+                    if(!progress && worklist.empty()) break;
+                }
+                auto alive = [&](uint32_t id)
+                {
+                    return id >= bound || definition[id] == UINT32_MAX || !dead[definition[id]];
+                };
+                output.assign(code.begin(), code.begin() + HeaderWords);
+                for(uint32_t i = 0; i < instructions.size(); i++)
+                {
+                    auto& inst = instructions[i];
+                    auto& ops = inst.operands;
+                    if(dead[i]) continue;
+                    if(Annotation(inst.opcode) && !ops.empty() && !alive(ops[0])) continue;
+                    if(inst.opcode != OpEntryPoint || layouts[i].uses.empty())
+                    {
+                        output.insert(output.end(), code.begin() + inst.offset, code.begin() + inst.offset + ops.size() + 1);
+                        continue;
+                    }
+                    // the interface list starts after the name
+                    size_t start = output.size(), first = layouts[i].uses.size() > 1 ? layouts[i].uses[1] : ops.size();
+                    output.push_back(0);
+                    output.insert(output.end(), ops.begin(), ops.begin() + first);
+                    for(auto id : ops.subspan(first))
+                    {
+                        if(alive(id)) output.push_back(id);
+                    }
+                    output[start] = uint32_t(output.size() - start) << 16 | inst.opcode;
+                }
+                return true;
+            }
+        }
+    }
+}
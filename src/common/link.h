@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Spirv
+        {
+            // A user defined Input or Output of an entry point, matched against the neighbouring stage by location
+            struct InterfaceVariable
+            {
+                uint32_t id = 0;
+                uint32_t location = 0;
+                // locations the variable occupies from location on
+                uint32_t locations = 1;
+                uint32_t component = 0;
+                // OpTypeFloat, OpTypeInt or OpTypeBool of the components and their width, 0 for structs
+                uint32_t scalar = 0;
+                uint32_t width = 0;
+                // components of one location: 1 for scalars, the vector size otherwise
+                uint32_t components = 0;
+                bool patch = false;
+                // the name the compiler gave it, empty once stripped
+                std::string name;
+            };
+            struct StageInterface
+            {
+                uint32_t model = 0;
+                std::vector<InterfaceVariable> inputs;
+                std::vector<InterfaceVariable> outputs;
+                // a variable has neither a location nor a builtin decoration, the stage can't be matched by location
+                bool opaque = false;
+            };
+            // The interface of the module's first entry point, builtins are left out. Per vertex arrays of tessellation
+            // and geometry stages are described by their element. nullopt if the module is malformed
+            std::optional<StageInterface> Interface(std::span<const uint32_t> code);
+            // Removes the interface variables listed in variables together with the stores writing them, then removes every
+            // instruction whose result is unused and that has no side effects until none is left. With drop_inputs, Input
+            // variables with a location that nothing reads anymore go too. removed receives the variables that were removed,
+            // those whose value is also read back are kept. False if the module holds an instruction the pass doesn't know
+            bool RemoveInterface(std::span<const uint32_t> code, std::span<const uint32_t> variables, bool drop_inputs, std::vector<uint32_t>& output, std::vector<uint32_t>& removed);
+        }
+    }
+}
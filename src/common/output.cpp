@@ -0,0 +1,84 @@
+#include "src/common/output.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        static uint32_t SizePrefix(size_t spirv_size)
+        {
+            uint32_t spvSize = spirv_size;
+            std::span spvSizeBytes = std::as_writable_bytes(std::span(&spvSize, 1));
+            if(std::endian::native != std::endian::little)
+            {
+                std::reverse(spvSizeBytes.begin(), spvSizeBytes.end());
+            }
+            return spvSize;
+        }
+        static constexpr char empty_trailer[TrailerSize] = {};
+        static std::span<const char> Trailer(std::span<const char> trailer)
+        {
+            return trailer.empty() ? std::span<const char>(empty_trailer) : trailer;
+        }
+        void SerializeShaderFile(std::span<const char> spirv, std::span<const char> trailer, char* dest)
+        {
+            uint32_t prefix = SizePrefix(spirv.size());
+            trailer = Trailer(trailer);
+            std::memcpy(dest, &prefix, sizeof(uint32_t));
+            std::memcpy(dest + sizeof(uint32_t), spirv.data(), spirv.size());
+            std::memcpy(dest + sizeof(uint32_t) + spirv.size(), trailer.data(), trailer.size());
+        }
+        void AppendShaderFile(std::vector<char>& output, std::span<const char> spirv, std::span<const char> trailer)
+        {
+            uint32_t prefix = SizePrefix(spirv.size());
+            trailer = Trailer(trailer);
+            output.reserve(output.size() + ShaderFileSize(spirv.size(), trailer.size()));
+            output.insert(output.end(), (const char*)&prefix, (const char*)&prefix + sizeof(uint32_t));
+            output.insert(output.end(), spirv.begin(), spirv.end());
+            output.insert(output.end(), trailer.begin(), trailer.end());
+        }
+        bool WriteShaderFile(const std::filesystem::path& path, std::span<const char> spirv, std::span<const char> trailer)
+        {
+            uint32_t prefix = SizePrefix(spirv.size());
+            trailer = Trailer(trailer);
+            std::ofstream file(path, std::ios::binary);
+            file.write((const char*)&prefix, sizeof(uint32_t));
+            file.write(spirv.data(), spirv.size());
+            file.write(trailer.data(), trailer.size());
+            return file.good();
+        }
+        std::span<const char> ShaderFileSpirv(std::span<const char> file)
+        {
+            if(file.size() < ShaderFileSize(0)) return {};
+            uint32_t spvSize;
+            std::memcpy(&spvSize, file.data(), sizeof(uint32_t));
+            spvSize = SizePrefix(spvSize);
+            if(spvSize > file.size() - ShaderFileSize(0)) return {};
+            return file.subspan(sizeof(uint32_t), spvSize);
+        }
+        std::span<const char> ShaderFileTrailer(std::span<const char> file)
+        {
+            auto spirv = ShaderFileSpirv(file);
+            return file.subspan(sizeof(uint32_t) + spirv.size());
+        }
+        bool WriteFileBytes(const std::filesystem::path& path, std::span<const char> bytes)
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write(bytes.data(), bytes.size());
+            return file.good();
+        }
+        bool ReadFileBytes(const std::filesystem::path& path, std::vector<char>& bytes)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return false;
+            std::error_code ec;
+            auto size = std::filesystem::file_size(path, ec);
+            if(ec) return false;
+            bytes.resize(size);
+            file.read(bytes.data(), size);
+            return file.gcount() == static_cast<std::streamsize>(size);
+        }
+    }
+}
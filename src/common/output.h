@@ -0,0 +1,29 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // File layout: [u32 little endian spirv size][spirv][trailer], the trailer is the reflection block
+        // or 16 zero bytes when there is none
+        constexpr uint32_t TrailerSize = sizeof(uint32_t) * 4;
+        constexpr size_t ShaderFileSize(size_t spirv_size, size_t trailer_size = 0)
+        {
+            return sizeof(uint32_t) + spirv_size + std::max<size_t>(trailer_size, TrailerSize);
+        }
+        // dest must hold ShaderFileSize(spirv.size(), trailer.size()) bytes
+        void SerializeShaderFile(std::span<const char> spirv, std::span<const char> trailer, char* dest);
+        void AppendShaderFile(std::vector<char>& output, std::span<const char> spirv, std::span<const char> trailer);
+        bool WriteShaderFile(const std::filesystem::path& path, std::span<const char> spirv, std::span<const char> trailer);
+        // returns the spirv stored in a serialized file, empty if the file is malformed
+        std::span<const char> ShaderFileSpirv(std::span<const char> file);
+        // the trailer of a file ShaderFileSpirv accepted
+        std::span<const char> ShaderFileTrailer(std::span<const char> file);
+        bool WriteFileBytes(const std::filesystem::path& path, std::span<const char> bytes);
+        bool ReadFileBytes(const std::filesystem::path& path, std::vector<char>& bytes);
+    }
+}
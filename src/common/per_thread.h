@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // One lazily created T per calling thread, destroyed with the container.
+        // Contexts of threads that exited stay around and are picked up again if the thread id is reused
+        template<typename T>
+        class PerThread
+        {
+        public:
+            // create returns a std::unique_ptr<T>, it's only called the first time a thread asks
+            template<typename Factory>
+            T& Get(Factory&& create)
+            {
+                auto id = std::this_thread::get_id();
+                {
+                    std::shared_lock lock(mutex);
+                    if(auto it = items.find(id); it != items.end()) return *it->second;
+                }
+                auto item = create();
+                std::unique_lock lock(mutex);
+                return *items.try_emplace(id, std::move(item)).first->second;
+            }
+        private:
+            std::shared_mutex mutex;
+            std::unordered_map<std::thread::id, std::unique_ptr<T>> items;
+        };
+    }
+}
@@ -0,0 +1,98 @@
+#include "include/rhi_sc.h"
+#include "src/common/backend.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        std::vector<PermutationResult> Compiler::CompilePermutations(RHI::API api, const ShaderSource& source, const std::unique_ptr<CompileOptions>& base_options, std::span<const MacroSet> permutations, uint32_t num_threads, bool memory_repr)
+        {
+            std::vector<PermutationResult> results(permutations.size());
+            ShaderSource src = source;
+            std::optional<SourceFile> main_file;
+            std::string main_name;
+            if(std::holds_alternative<std::filesystem::path>(source.source))
+            {
+                auto& path = std::get<std::filesystem::path>(source.source);
+                main_file = Backend::State(this).Sources()->Open(path);
+                if(!main_file)
+                {
+                    for(auto& [result, output, compiled_as] : results)
+                    {
+                        result.error = CompilationError::NonExistentFile;
+                        result.messages = "File passed in was not found";
+                    }
+                    return results;
+                }
+                main_name = path.string();
+                src.source = ShaderSource::StringSource{main_file->text, main_name};
+            }
+            std::vector<std::unique_ptr<CompileOptions>> options(permutations.size());
+            for(size_t i = 0; i < permutations.size(); i++)
+            {
+                options[i] = base_options->Clone();
+                for(auto& [name, value] : permutations[i])
+                    options[i]->AddMacroDefinition(name, value ? std::optional<std::string_view>(*value) : std::nullopt);
+            }
+            size_t num_workers = std::clamp<size_t>(num_threads, 1, std::max<size_t>(permutations.size(), 1));
+            auto parallel = [&](auto&& job)
+            {
+                std::atomic<size_t> next = 0;
+                auto worker = [&]()
+                {
+                    for(size_t i = next++; i < permutations.size(); i = next++)
+                        job(i);
+                };
+                std::vector<std::thread> pool;
+                for(size_t i = 1; i < num_workers; i++)
+                    pool.emplace_back(worker);
+                worker();
+                for(auto& thread : pool)
+                    thread.join();
+            };
+            std::vector<size_t> compiled_as(permutations.size());
+            std::iota(compiled_as.begin(), compiled_as.end(), 0);
+            // macros the shader doesn't use leave the preprocessed text alone, such permutations compile to the same module
+            if(!Backend::State(base_options.get()).debug)
+            {
+                std::mutex mutex;
+                // preprocessed text to the lowest permutation producing it, only unique texts are kept
+                std::unordered_map<std::string, size_t> groups;
+                std::vector<size_t*> group(permutations.size(), nullptr);
+                parallel([&](size_t i)
+                {
+                    std::string text;
+                    if(Preprocess(src, options[i], text).error != CompilationError::None) return;
+                    std::lock_guard lock(mutex);
+                    auto& first = groups.try_emplace(std::move(text), i).first->second;
+                    first = std::min(first, i);
+                    group[i] = &first;
+                });
+                for(size_t i = 0; i < permutations.size(); i++)
+                {
+                    if(group[i]) compiled_as[i] = *group[i];
+                }
+            }
+            parallel([&](size_t i)
+            {
+                if(compiled_as[i] != i) return;
+                results[i].result = CompileToBuffer(api, src, options[i], results[i].output, memory_repr);
+                if(main_file)
+                    results[i].result.dependencies.insert(results[i].result.dependencies.begin(), std::get<std::filesystem::path>(source.source).lexically_normal());
+            });
+            for(size_t i = 0; i < permutations.size(); i++)
+            {
+                results[i].compiled_as = compiled_as[i];
+                if(compiled_as[i] == i) continue;
+                results[i].result = results[compiled_as[i]].result;
+                results[i].output = results[compiled_as[i]].output;
+            }
+            return results;
+        }
+    }
+}
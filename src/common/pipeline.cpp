@@ -0,0 +1,216 @@
+#include "include/rhi_sc.h"
+#include "src/common/backend.h"
+#include "src/common/compression.h"
+#include "src/common/cost.h"
+#include "src/common/link.h"
+#include "src/common/output.h"
+#include "src/common/postprocess.h"
+#include "src/common/spirv.h"
+#include <algorithm>
+#include <numeric>
+#include <string>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            // Position of a stage in the pipeline, stages that can't be part of one sort last
+            uint32_t PipelineOrder(ShaderStage stage)
+            {
+                switch(stage)
+                {
+                    using enum ShaderStage;
+                    case Vertex: return 0;
+                    case Hull: return 1;
+                    case Domain: return 2;
+                    case Geometry: return 3;
+                    case Pixel: return 4;
+                    default: return 5;
+                }
+            }
+            std::string StageName(ShaderStage stage)
+            {
+                constexpr const char* names[] = {"vertex", "hull", "domain", "geometry", "pixel", "unknown"};
+                return names[PipelineOrder(stage)];
+            }
+            std::string SourceName(const ShaderSource& source)
+            {
+                if(auto path = std::get_if<std::filesystem::path>(&source.source)) return path->string();
+                return std::string(std::get<ShaderSource::StringSource>(source.source).filename);
+            }
+            std::string VariableName(const Spirv::InterfaceVariable& var)
+            {
+                auto location = "location " + std::to_string(var.location);
+                return var.name.empty() ? location : var.name + " (" + location + ")";
+            }
+            std::string TypeName(const Spirv::InterfaceVariable& var)
+            {
+                std::string name;
+                if(var.scalar == Spirv::OpTypeFloat) name = var.width == 16 ? "half" : var.width == 64 ? "double" : "float";
+                else if(var.scalar == Spirv::OpTypeInt) name = var.width == 64 ? "int64" : "int";
+                else if(var.scalar == Spirv::OpTypeBool) name = "bool";
+                else return "struct";
+                return var.components > 1 ? name + std::to_string(var.components) : name;
+            }
+            bool Overlap(const Spirv::InterfaceVariable& a, const Spirv::InterfaceVariable& b)
+            {
+                return a.location < b.location + b.locations && b.location < a.location + a.locations;
+            }
+            // Errors for the inputs of consumer that producer doesn't write or writes with another type
+            std::string InterfaceMismatches(const Spirv::StageInterface& producer, const Spirv::StageInterface& consumer, const std::string& producer_name, const std::string& consumer_name)
+            {
+                std::string messages;
+                for(auto& input : consumer.inputs)
+                {
+                    auto written = std::ranges::find_if(producer.outputs, [&](auto& output){ return Overlap(input, output); });
+                    if(written == producer.outputs.end())
+                    {
+                        messages += consumer_name + " input " + VariableName(input) + " isn't written by the " + producer_name + " stage\n";
+                        continue;
+                    }
+                    auto same = std::ranges::find_if(producer.outputs, [&](auto& output)
+                    {
+                        return output.location == input.location && output.component == input.component;
+                    });
+                    if(same == producer.outputs.end() || !same->scalar || !input.scalar) continue;
+                    // signedness may differ, the bits are passed on as they are
+                    if(same->scalar != input.scalar || same->width != input.width || same->components < input.components)
+                        messages += consumer_name + " input " + VariableName(input) + " reads " + TypeName(input) + " but the " +
+                            producer_name + " stage writes " + TypeName(*same) + "\n";
+                }
+                return messages;
+            }
+        }
+        std::vector<PipelineStageResult> Compiler::CompilePipeline(RHI::API api, std::span<const PipelineStage> stages, bool memory_repr)
+        {
+            std::vector<PipelineStageResult> results(stages.size());
+            auto fail = [&](CompilationError error, const std::string& message)
+            {
+                for(auto& stage : results)
+                {
+                    stage.result.error = error;
+                    stage.result.messages = message;
+                }
+            };
+            if(memory_repr && api != RHI::API::Vulkan)
+            {
+                fail(CompilationError::APINotAvailable, "Only Vulkan API shaders supported");
+                return results;
+            }
+            // indices into stages in pipeline order
+            std::vector<size_t> order(stages.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::ranges::stable_sort(order, {}, [&](size_t i){ return PipelineOrder(stages[i].source.stage); });
+            bool hull = false, domain = false;
+            for(size_t p = 0; p < order.size(); p++)
+            {
+                auto stage = stages[order[p]].source.stage;
+                if(PipelineOrder(stage) > 4 || (p > 0 && stage == stages[order[p - 1]].source.stage))
+                {
+                    fail(CompilationError::InvalidStage, "A pipeline holds at most one vertex, hull, domain, geometry and pixel stage");
+                    return results;
+                }
+                hull |= stage == ShaderStage::Hull;
+                domain |= stage == ShaderStage::Domain;
+            }
+            if(hull != domain)
+            {
+                fail(CompilationError::InvalidStage, "The hull and domain stages of a pipeline come together");
+                return results;
+            }
+            std::vector<ShaderBlob> blobs(stages.size());
+            bool compiled = true;
+            for(size_t i = 0; i < stages.size(); i++)
+            {
+                results[i].result = CompileToBlob(stages[i].source, stages[i].options, blobs[i]);
+                compiled &= results[i].result.error == CompilationError::None;
+            }
+            if(!compiled)
+            {
+                for(auto& stage : results)
+                {
+                    if(stage.result.error != CompilationError::None) continue;
+                    stage.result.error = CompilationError::Error;
+                    stage.result.messages += "Not linked, another stage of the pipeline failed to compile\n";
+                }
+                return results;
+            }
+            std::vector<std::vector<uint32_t>> code(stages.size());
+            std::vector<char> linked(stages.size(), false);
+            for(size_t i = 0; i < stages.size(); i++)
+                code[i].assign(blobs[i].begin(), blobs[i].end());
+            auto link = [&](size_t i, std::span<const uint32_t> outputs, bool drop_inputs)
+            {
+                auto before = Spirv::Interface(code[i]);
+                std::vector<uint32_t> processed, removed;
+                if(!before || !Spirv::RemoveInterface(code[i], outputs, drop_inputs, processed, removed))
+                {
+                    results[i].result.warning_count++;
+                    results[i].result.messages += SourceName(stages[i].source) + ": warning: the linker can't handle this module, its interface was left alone\n";
+                    return;
+                }
+                for(auto id : removed)
+                {
+                    if(auto it = std::ranges::find(before->outputs, id, &Spirv::InterfaceVariable::id); it != before->outputs.end())
+                        results[i].removed_outputs.push_back(it->location);
+                    else if(auto it = std::ranges::find(before->inputs, id, &Spirv::InterfaceVariable::id); it != before->inputs.end())
+                        results[i].removed_inputs.push_back(it->location);
+                }
+                code[i].swap(processed);
+                linked[i] = true;
+            };
+            // from the last stage back, so an output only feeding a removed input goes too
+            for(size_t p = order.size(); p-- > 1;)
+            {
+                size_t consumer = order[p], producer = order[p - 1];
+                if(p == order.size() - 1) link(consumer, {}, true);
+                auto inputs = Spirv::Interface(code[consumer]);
+                auto outputs = Spirv::Interface(code[producer]);
+                std::vector<uint32_t> unread;
+                if(inputs && outputs && !inputs->opaque && !outputs->opaque)
+                {
+                    auto mismatches = InterfaceMismatches(*outputs, *inputs, StageName(stages[producer].source.stage), SourceName(stages[consumer].source) + ": " + StageName(stages[consumer].source.stage));
+                    if(!mismatches.empty())
+                    {
+                        results[consumer].result.error = CompilationError::Error;
+                        results[consumer].result.messages += mismatches;
+                    }
+                    for(auto& output : outputs->outputs)
+                    {
+                        if(std::ranges::none_of(inputs->inputs, [&](auto& input){ return Overlap(input, output); }))
+                            unread.push_back(output.id);
+                    }
+                }
+                link(producer, unread, p > 1);
+            }
+            for(size_t i = 0; i < stages.size(); i++)
+            {
+                auto& options = Backend::State(stages[i].options.get());
+                auto& result = results[i].result;
+                std::vector<uint32_t> remapped;
+                // the removed instructions left holes in the numbering
+                if(linked[i] && options.remap && Spirv::RemapIds(code[i], remapped)) code[i].swap(remapped);
+                if(linked[i] && options.cost) result.cost = AnalyzeCost(code[i]);
+                std::span<const char> bytes(reinterpret_cast<const char*>(code[i].data()), code[i].size() * sizeof(uint32_t));
+                auto& output = results[i].output;
+                if(memory_repr)
+                    output.assign(bytes.begin(), bytes.end());
+                else if(options.compression != ShaderCompression::None)
+                {
+                    std::vector<char> file;
+                    AppendShaderFile(file, bytes, blobs[i].Reflection());
+                    CompressShaderFile(options.compression, file, output);
+                }
+                else
+                    AppendShaderFile(output, bytes, blobs[i].Reflection());
+                if(result.stats)
+                {
+                    result.stats->instructions_after = Spirv::InstructionCount(code[i]);
+                    result.stats->output_bytes = output.size();
+                }
+            }
+            return results;
+        }
+    }
+}
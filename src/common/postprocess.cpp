@@ -0,0 +1,114 @@
+#include "src/common/postprocess.h"
+#include "src/common/spirv.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Spirv
+        {
+            bool StripDebugInfo(std::span<const uint32_t> code, std::vector<uint32_t>& output)
+            {
+                auto instructions = Parse(code);
+                if(instructions.empty()) return false;
+                // non-semantic results may only be used by other non-semantic instructions, so they all go together
+                std::unordered_set<uint32_t> non_semantic;
+                for(auto& inst : instructions)
+                {
+                    if(inst.opcode == OpExtInstImport && inst.operands.size() > 1 &&
+                        LiteralString(inst.operands.subspan(1)).starts_with("NonSemantic."))
+                        non_semantic.insert(inst.operands[0]);
+                }
+                output.assign(code.begin(), code.begin() + HeaderWords);
+                for(auto& inst : instructions)
+                {
+                    auto& ops = inst.operands;
+                    bool strip = false;
+                    switch(inst.opcode)
+                    {
+                        case OpSourceContinued: case OpSource: case OpSourceExtension: case OpName: case OpMemberName:
+                        case OpString: case OpLine: case OpNoLine: case OpModuleProcessed:
+                            strip = true;
+                            break;
+                        case OpExtension:
+                            strip = LiteralString(ops) == "SPV_KHR_non_semantic_info";
+                            break;
+                        case OpExtInstImport:
+                            strip = !ops.empty() && non_semantic.contains(ops[0]);
+                            break;
+                        case OpExtInst:
+                            strip = ops.size() > 2 && non_semantic.contains(ops[2]);
+                            break;
+                        case OpDecorateString:
+                            strip = ops.size() > 1 && (ops[1] == DecorationUserSemantic || ops[1] == DecorationUserTypeGOOGLE);
+                            break;
+                        case OpMemberDecorateString:
+                            strip = ops.size() > 2 && (ops[2] == DecorationUserSemantic || ops[2] == DecorationUserTypeGOOGLE);
+                            break;
+                        default:
+                            break;
+                    }
+                    if(!strip)
+                        output.insert(output.end(), code.begin() + inst.offset, code.begin() + inst.offset + ops.size() + 1);
+                }
+                return true;
+            }
+            bool RemapIds(std::span<const uint32_t> code, std::vector<uint32_t>& output)
+            {
+                auto instructions = Parse(code);
+                if(instructions.empty()) return false;
+                // sets whose instructions take nothing but ids after the opcode, others may mix in literals
+                std::unordered_set<uint32_t> id_only_sets;
+                // integer width of every id with an integer type, to catch 64 bit switch literals
+                std::unordered_map<uint32_t, uint32_t> int_widths;
+                std::unordered_map<uint32_t, uint32_t> value_types;
+                for(auto& inst : instructions)
+                {
+                    auto& ops = inst.operands;
+                    if(inst.opcode == OpExtInstImport && ops.size() > 1)
+                    {
+                        auto name = LiteralString(ops.subspan(1));
+                        if(name == "GLSL.std.450" || name.starts_with("NonSemantic.")) id_only_sets.insert(ops[0]);
+                    }
+                    else if(inst.opcode == OpTypeInt && ops.size() > 1)
+                        int_widths[ops[0]] = ops[1];
+                }
+                std::vector<uint32_t> remap(code[3], 0);
+                uint32_t next = 1;
+                auto map = [&](uint32_t& id)
+                {
+                    if(id >= remap.size()) return false;
+                    if(!remap[id]) remap[id] = next++;
+                    id = remap[id];
+                    return true;
+                };
+                output.assign(code.begin(), code.end());
+                OperandLayout layout;
+                for(auto& inst : instructions)
+                {
+                    auto& ops = inst.operands;
+                    if(!Describe(inst, layout)) return false;
+                    if(inst.opcode == OpExtInst && (ops.size() < 3 || !id_only_sets.contains(ops[2]))) return false;
+                    if(layout.has_type && ops.size() > 1) value_types[ops[1]] = ops[0];
+                    if(inst.opcode == OpSwitch && !ops.empty())
+                    {
+                        auto type = value_types.find(ops[0]);
+                        if(type == value_types.end() || int_widths[type->second] > 32) return false;
+                    }
+                    uint32_t* words = output.data() + inst.offset + 1;
+                    uint32_t index = 0;
+                    if(layout.has_type && (index >= ops.size() || !map(words[index++]))) return false;
+                    if(layout.has_result && (index >= ops.size() || !map(words[index]))) return false;
+                    for(auto use : layout.uses)
+                    {
+                        if(!map(words[use])) return false;
+                    }
+                }
+                output[3] = next;
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Spirv
+        {
+            // Drops debug names, source and line information, non-semantic extended instructions and the
+            // HLSL semantic/user type decorations. False if the module is malformed
+            bool StripDebugInfo(std::span<const uint32_t> code, std::vector<uint32_t>& output);
+            // Renumbers every id in order of first appearance starting at 1 and shrinks the id bound, so modules that
+            // only differ in numbering become identical and ids stay small. False if the module contains an instruction
+            // the walker doesn't know about, the module is then left alone rather than renumbered incorrectly
+            bool RemapIds(std::span<const uint32_t> code, std::vector<uint32_t>& output);
+        }
+    }
+}
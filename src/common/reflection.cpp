@@ -0,0 +1,356 @@
+#include "src/common/reflection.h"
+#include "include/rhi_sc.h"
+#include "src/common/spirv.h"
+#include <cstring>
+#include <optional>
+#include <string>
+#include <unordered_map>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            struct Decorations
+            {
+                std::optional<uint32_t> set, binding, location, builtin, spec_id;
+                bool block = false, buffer_block = false;
+                uint32_t array_stride = 0;
+            };
+            struct Variable
+            {
+                uint32_t id, type, storage;
+            };
+            struct SpecConstant
+            {
+                uint32_t id, type, value;
+            };
+            class ModuleInfo
+            {
+            public:
+                std::unordered_map<uint32_t, std::string> names;
+                std::unordered_map<uint32_t, Decorations> decorations;
+                // struct id -> member offsets / matrix strides
+                std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> member_offsets, member_matrix_strides;
+                std::unordered_map<uint32_t, Spirv::Instruction> types;
+                std::unordered_map<uint32_t, uint32_t> constants;
+                std::vector<Variable> variables;
+                std::vector<SpecConstant> spec_constants;
+                std::optional<uint32_t> model;
+                uint32_t workgroup_size[3] = {0, 0, 0};
+                std::optional<uint32_t> workgroup_size_ids[3];
+
+                bool Load(std::span<const uint32_t> code)
+                {
+                    auto instructions = Spirv::Parse(code);
+                    if(instructions.empty()) return false;
+                    std::optional<uint32_t> entry;
+                    for(auto& inst : instructions)
+                    {
+                        auto& ops = inst.operands;
+                        switch(inst.opcode)
+                        {
+                            case Spirv::OpName:
+                                if(ops.size() > 1) names[ops[0]] = Spirv::LiteralString(ops.subspan(1));
+                                break;
+                            case Spirv::OpEntryPoint:
+                                if(ops.size() < 3 || entry) break;
+                                model = ops[0];
+                                entry = ops[1];
+                                break;
+                            case Spirv::OpExecutionMode:
+                            case Spirv::OpExecutionModeId:
+                                if(ops.size() < 5 || ops[0] != entry) break;
+                                if(ops[1] == Spirv::ExecutionModeLocalSize)
+                                    std::copy(ops.begin() + 2, ops.begin() + 5, workgroup_size);
+                                else if(ops[1] == Spirv::ExecutionModeLocalSizeId)
+                                    for(uint32_t i = 0; i < 3; i++) workgroup_size_ids[i] = ops[2 + i];
+                                break;
+                            case Spirv::OpDecorate:
+                            {
+                                if(ops.size() < 2) break;
+                                auto& dec = decorations[ops[0]];
+                                auto value = ops.size() > 2 ? std::optional<uint32_t>(ops[2]) : std::nullopt;
+                                switch(ops[1])
+                                {
+                                    case Spirv::DecorationDescriptorSet: dec.set = value; break;
+                                    case Spirv::DecorationBinding: dec.binding = value; break;
+                                    case Spirv::DecorationLocation: dec.location = value; break;
+                                    case Spirv::DecorationBuiltIn: dec.builtin = value; break;
+                                    case Spirv::DecorationSpecId: dec.spec_id = value; break;
+                                    case Spirv::DecorationBlock: dec.block = true; break;
+                                    case Spirv::DecorationBufferBlock: dec.buffer_block = true; break;
+                                    case Spirv::DecorationArrayStride: dec.array_stride = value.value_or(0); break;
+                                    default: break;
+                                }
+                                break;
+                            }
+                            case Spirv::OpMemberDecorate:
+                                if(ops.size() < 4) break;
+                                if(ops[2] == Spirv::DecorationOffset) member_offsets[ops[0]][ops[1]] = ops[3];
+                                else if(ops[2] == Spirv::DecorationMatrixStride) member_matrix_strides[ops[0]][ops[1]] = ops[3];
+                                break;
+                            case Spirv::OpConstant:
+                                if(ops.size() > 2) constants[ops[1]] = ops[2];
+                                break;
+                            case Spirv::OpSpecConstant:
+                                if(ops.size() < 3) break;
+                                constants[ops[1]] = ops[2];
+                                spec_constants.push_back({ops[1], ops[0], ops[2]});
+                                break;
+                            case Spirv::OpSpecConstantTrue:
+                            case Spirv::OpSpecConstantFalse:
+                                if(ops.size() > 1) spec_constants.push_back({ops[1], ops[0], inst.opcode == Spirv::OpSpecConstantTrue});
+                                break;
+                            case Spirv::OpVariable:
+                                if(ops.size() > 2) variables.push_back({ops[1], ops[0], ops[2]});
+                                break;
+                            case Spirv::OpFunction:
+                                // only module scope declarations are of interest
+                                goto done;
+                            default:
+                                if((inst.opcode >= Spirv::OpTypeVoid && inst.opcode <= Spirv::OpTypeFunction) ||
+                                    inst.opcode == Spirv::OpTypeAccelerationStructureKHR)
+                                {
+                                    if(!ops.empty()) types.emplace(ops[0], inst);
+                                }
+                                break;
+                        }
+                    }
+                done:
+                    for(uint32_t i = 0; i < 3; i++)
+                    {
+                        if(workgroup_size_ids[i] && constants.contains(*workgroup_size_ids[i]))
+                            workgroup_size[i] = constants[*workgroup_size_ids[i]];
+                    }
+                    return model.has_value();
+                }
+                const Spirv::Instruction* Type(uint32_t id) const
+                {
+                    auto it = types.find(id);
+                    return it == types.end() ? nullptr : &it->second;
+                }
+                uint32_t Size(uint32_t type_id, uint32_t matrix_stride = 0) const
+                {
+                    auto type = Type(type_id);
+                    if(!type) return 0;
+                    auto& ops = type->operands;
+                    switch(type->opcode)
+                    {
+                        case Spirv::OpTypeBool: return 4;
+                        case Spirv::OpTypeInt:
+                        case Spirv::OpTypeFloat: return ops.size() > 1 ? ops[1] / 8 : 0;
+                        case Spirv::OpTypeVector: return ops.size() > 2 ? Size(ops[1]) * ops[2] : 0;
+                        case Spirv::OpTypeMatrix:
+                            if(ops.size() < 3) return 0;
+                            return matrix_stride ? matrix_stride * ops[2] : Size(ops[1]) * ops[2];
+                        case Spirv::OpTypeArray:
+                        {
+                            if(ops.size() < 3) return 0;
+                            auto length = constants.find(ops[2]);
+                            if(length == constants.end()) return 0;
+                            auto dec = decorations.find(type_id);
+                            uint32_t stride = dec != decorations.end() && dec->second.array_stride ? dec->second.array_stride : Size(ops[1]);
+                            return stride * length->second;
+                        }
+                        case Spirv::OpTypeStruct:
+                        {
+                            uint32_t size = 0;
+                            auto offsets = member_offsets.find(type_id);
+                            auto strides = member_matrix_strides.find(type_id);
+                            uint32_t running = 0;
+                            for(uint32_t member = 0; member + 1 < ops.size(); member++)
+                            {
+                                uint32_t offset = running;
+                                if(offsets != member_offsets.end() && offsets->second.contains(member))
+                                    offset = offsets->second.at(member);
+                                uint32_t stride = 0;
+                                if(strides != member_matrix_strides.end() && strides->second.contains(member))
+                                    stride = strides->second.at(member);
+                                running = offset + Size(ops[member + 1], stride);
+                                size = std::max(size, running);
+                            }
+                            return size;
+                        }
+                        default: return 0;
+                    }
+                }
+                std::string Name(uint32_t id) const
+                {
+                    auto it = names.find(id);
+                    return it == names.end() ? std::string() : it->second;
+                }
+            };
+            ShaderStage StageFromModel(uint32_t model)
+            {
+                switch(model)
+                {
+                    case Spirv::ExecutionModelVertex: return ShaderStage::Vertex;
+                    case Spirv::ExecutionModelTessellationControl: return ShaderStage::Hull;
+                    case Spirv::ExecutionModelTessellationEvaluation: return ShaderStage::Domain;
+                    case Spirv::ExecutionModelGeometry: return ShaderStage::Geometry;
+                    case Spirv::ExecutionModelFragment: return ShaderStage::Pixel;
+                    case Spirv::ExecutionModelGLCompute: return ShaderStage::Compute;
+                    default: return ShaderStage::None;
+                }
+            }
+            class Builder
+            {
+            public:
+                uint32_t AddString(const std::string& str)
+                {
+                    if(str.empty()) return Reflection::NoName;
+                    uint32_t offset = strings.size();
+                    strings.insert(strings.end(), str.begin(), str.end());
+                    strings.push_back(0);
+                    return offset;
+                }
+                template<typename T>
+                void AddSection(Reflection::SectionKind kind, const std::vector<T>& items)
+                {
+                    auto& [section, bytes] = sections.emplace_back();
+                    section = {kind, 0, uint32_t(items.size()), sizeof(T)};
+                    bytes.resize(items.size() * sizeof(T));
+                    if(!items.empty()) std::memcpy(bytes.data(), items.data(), bytes.size());
+                }
+                std::vector<char> Finish()
+                {
+                    AddSection(Reflection::SectionKind::Strings, strings);
+                    size_t offset = sizeof(Reflection::Header) + sections.size() * sizeof(Reflection::Section);
+                    for(auto& [section, bytes] : sections)
+                    {
+                        section.offset = offset;
+                        offset += (bytes.size() + 3) & ~size_t(3);
+                    }
+                    std::vector<char> block(offset);
+                    Reflection::Header header = {Reflection::Magic, Reflection::Version, uint32_t(block.size()), uint32_t(sections.size())};
+                    std::memcpy(block.data(), &header, sizeof(header));
+                    for(size_t i = 0; i < sections.size(); i++)
+                    {
+                        auto& [section, bytes] = sections[i];
+                        std::memcpy(block.data() + sizeof(header) + i * sizeof(Reflection::Section), &section, sizeof(section));
+                        if(!bytes.empty()) std::memcpy(block.data() + section.offset, bytes.data(), bytes.size());
+                    }
+                    return block;
+                }
+            private:
+                std::vector<char> strings;
+                std::vector<std::pair<Reflection::Section, std::vector<char>>> sections;
+            };
+        }
+        std::vector<char> Reflect(std::span<const uint32_t> spirv)
+        {
+            ModuleInfo module;
+            if(!module.Load(spirv)) return {};
+            Builder builder;
+            Reflection::Info info = {static_cast<uint32_t>(StageFromModel(*module.model)),
+                {module.workgroup_size[0], module.workgroup_size[1], module.workgroup_size[2]}};
+            builder.AddSection(Reflection::SectionKind::Info, std::vector{info});
+
+            std::vector<Reflection::Binding> bindings;
+            std::vector<Reflection::PushConstantRange> push_constants;
+            std::vector<Reflection::VertexInput> inputs;
+            for(auto& var : module.variables)
+            {
+                auto pointer = module.Type(var.type);
+                if(!pointer || pointer->opcode != Spirv::OpTypePointer || pointer->operands.size() < 3) continue;
+                uint32_t pointee = pointer->operands[2];
+                auto dec = module.decorations[var.id];
+                std::string name = module.Name(var.id);
+                if(name.empty()) name = module.Name(pointee);
+                if(var.storage == Spirv::StorageClassPushConstant)
+                {
+                    auto offsets = module.member_offsets.find(pointee);
+                    uint32_t offset = 0;
+                    if(offsets != module.member_offsets.end() && !offsets->second.empty())
+                    {
+                        offset = UINT32_MAX;
+                        for(auto& [member, member_offset] : offsets->second) offset = std::min(offset, member_offset);
+                    }
+                    push_constants.push_back({offset, module.Size(pointee) - offset, builder.AddString(name)});
+                    continue;
+                }
+                if(var.storage == Spirv::StorageClassInput && *module.model == Spirv::ExecutionModelVertex)
+                {
+                    if(!dec.location || dec.builtin) continue;
+                    auto type = module.Type(pointee);
+                    uint32_t components = 1;
+                    if(type && type->opcode == Spirv::OpTypeVector && type->operands.size() > 2)
+                    {
+                        components = type->operands[2];
+                        type = module.Type(type->operands[1]);
+                    }
+                    auto component_type = Reflection::ComponentType::Other;
+                    if(type && type->opcode == Spirv::OpTypeFloat) component_type = Reflection::ComponentType::Float;
+                    else if(type && type->opcode == Spirv::OpTypeInt && type->operands.size() > 2)
+                        component_type = type->operands[2] ? Reflection::ComponentType::Int : Reflection::ComponentType::UInt;
+                    inputs.push_back({*dec.location, component_type, components, builder.AddString(name)});
+                    continue;
+                }
+                if(!dec.set || !dec.binding) continue;
+                // unwrap descriptor arrays
+                uint32_t count = 1;
+                auto type = module.Type(pointee);
+                while(type && (type->opcode == Spirv::OpTypeArray || type->opcode == Spirv::OpTypeRuntimeArray))
+                {
+                    if(type->opcode == Spirv::OpTypeRuntimeArray) count = 0;
+                    else if(auto length = module.constants.find(type->operands[2]); length != module.constants.end())
+                        count *= length->second;
+                    type = module.Type(type->operands[1]);
+                }
+                if(!type) continue;
+                Reflection::DescriptorKind kind;
+                switch(type->opcode)
+                {
+                    case Spirv::OpTypeStruct:
+                    {
+                        auto& type_dec = module.decorations[type->operands[0]];
+                        kind = var.storage == Spirv::StorageClassStorageBuffer || type_dec.buffer_block ?
+                            Reflection::DescriptorKind::StorageBuffer : Reflection::DescriptorKind::UniformBuffer;
+                        break;
+                    }
+                    case Spirv::OpTypeImage:
+                    {
+                        auto& ops = type->operands;
+                        uint32_t dim = ops.size() > 2 ? ops[2] : 0;
+                        uint32_t sampled = ops.size() > 6 ? ops[6] : 1;
+                        if(dim == Spirv::DimSubpassData) kind = Reflection::DescriptorKind::InputAttachment;
+                        else if(dim == Spirv::DimBuffer)
+                            kind = sampled == 2 ? Reflection::DescriptorKind::StorageTexelBuffer : Reflection::DescriptorKind::UniformTexelBuffer;
+                        else
+                            kind = sampled == 2 ? Reflection::DescriptorKind::StorageImage : Reflection::DescriptorKind::SampledImage;
+                        break;
+                    }
+                    case Spirv::OpTypeSampler: kind = Reflection::DescriptorKind::Sampler; break;
+                    case Spirv::OpTypeSampledImage: kind = Reflection::DescriptorKind::CombinedImageSampler; break;
+                    case Spirv::OpTypeAccelerationStructureKHR: kind = Reflection::DescriptorKind::AccelerationStructure; break;
+                    default: continue;
+                }
+                bindings.push_back({*dec.set, *dec.binding, kind, count, builder.AddString(name)});
+            }
+            // constants without a SpecId are only there for OpSpecConstantOp and can't be set
+            std::vector<Reflection::SpecConstant> spec_constants;
+            for(auto& constant : module.spec_constants)
+            {
+                auto dec = module.decorations.find(constant.id);
+                if(dec == module.decorations.end() || !dec->second.spec_id) continue;
+                auto type = module.Type(constant.type);
+                auto component_type = Reflection::ComponentType::Other;
+                if(type && type->opcode == Spirv::OpTypeBool) component_type = Reflection::ComponentType::Bool;
+                else if(type && type->opcode == Spirv::OpTypeFloat && type->operands.size() > 1 && type->operands[1] == 32)
+                    component_type = Reflection::ComponentType::Float;
+                else if(type && type->opcode == Spirv::OpTypeInt && type->operands.size() > 2 && type->operands[1] == 32)
+                    component_type = type->operands[2] ? Reflection::ComponentType::Int : Reflection::ComponentType::UInt;
+                spec_constants.push_back({*dec->second.spec_id, component_type, constant.value, builder.AddString(module.Name(constant.id))});
+            }
+            std::ranges::sort(bindings, {}, [](auto& b){ return std::pair(b.set, b.binding); });
+            std::ranges::sort(spec_constants, {}, &Reflection::SpecConstant::id);
+            std::ranges::sort(inputs, {}, &Reflection::VertexInput::location);
+            builder.AddSection(Reflection::SectionKind::Bindings, bindings);
+            builder.AddSection(Reflection::SectionKind::PushConstants, push_constants);
+            builder.AddSection(Reflection::SectionKind::VertexInputs, inputs);
+            builder.AddSection(Reflection::SectionKind::SpecConstants, spec_constants);
+            return builder.Finish();
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Builds the reflection block (see Reflection in rhi_sc.h) of a module, empty if the module can't be parsed
+        std::vector<char> Reflect(std::span<const uint32_t> spirv);
+    }
+}
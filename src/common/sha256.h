@@ -0,0 +1,29 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        class Sha256
+        {
+        public:
+            Sha256();
+            void Update(const void* data, size_t size);
+            void Update(std::string_view str) { Update(str.data(), str.size()); }
+            // appends the value as fixed width little endian bytes
+            void UpdateU32(uint32_t value);
+            std::array<uint8_t, 32> Finish();
+            std::string FinishHex();
+        private:
+            void Transform(const uint8_t* block);
+            uint32_t state[8];
+            uint8_t buffer[64];
+            uint64_t length = 0;
+            size_t buffered = 0;
+        };
+    }
+}
@@ -0,0 +1,93 @@
+#include "src/common/specialize.h"
+#include "src/common/include_cache.h"
+#include <algorithm>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            bool IdentifierStart(char c)
+            {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+            }
+            bool IdentifierChar(char c)
+            {
+                return IdentifierStart(c) || (c >= '0' && c <= '9');
+            }
+            // The identifier or number starting at at, which is moved past it
+            std::string_view Token(std::string_view line, size_t& at)
+            {
+                size_t start = at;
+                while(at < line.size() && IdentifierChar(line[at])) at++;
+                return line.substr(start, at - start);
+            }
+        }
+        bool Specialize(const ShaderSource& source, std::span<const std::string> names, SpecializedSource& output)
+        {
+            std::optional<SourceFile> storage;
+            std::string_view text;
+            if(std::holds_alternative<std::filesystem::path>(source.source))
+            {
+                auto& path = std::get<std::filesystem::path>(source.source);
+                storage = LoadSourceFile(path);
+                if(!storage) return false;
+                text = storage->text;
+                output.filename = path.string();
+            }
+            else
+            {
+                auto& str = std::get<ShaderSource::StringSource>(source.source);
+                text = str.shader;
+                output.filename = str.filename;
+            }
+            // a -D of the same name would turn the declaration into nonsense
+            output.text.clear();
+            for(size_t id = 0; id < names.size(); id++)
+            {
+                output.text += "#undef " + names[id] + "\n";
+                output.text += "[[vk::constant_id(" + std::to_string(id) + ")]] const bool " + names[id] + " = false;\n";
+            }
+            output.text += "#line 1\n";
+            output.text += text;
+            output.source.source = ShaderSource::StringSource{output.text, output.filename};
+            output.source.stage = source.stage;
+            return true;
+        }
+        std::string ConditionalUses(std::string_view text, std::string_view filename, std::span<const std::string> names)
+        {
+            std::string messages;
+            size_t number = 0;
+            for(size_t start = 0; start < text.size();)
+            {
+                size_t end = std::min(text.find('\n', start), text.size());
+                auto line = text.substr(start, end - start);
+                start = end + 1;
+                number++;
+                size_t at = line.find_first_not_of(" \t");
+                if(at == std::string_view::npos || line[at] != '#') continue;
+                at = line.find_first_not_of(" \t", at + 1);
+                if(at == std::string_view::npos) continue;
+                auto directive = Token(line, at);
+                if(directive != "if" && directive != "ifdef" && directive != "ifndef" && directive != "elif") continue;
+                // up to a line comment, numbers are skipped whole so suffixes aren't taken for names
+                line = line.substr(0, line.find("//"));
+                while(at < line.size())
+                {
+                    if(!IdentifierChar(line[at]))
+                    {
+                        at++;
+                        continue;
+                    }
+                    auto token = Token(line, at);
+                    if(IdentifierStart(token[0]) && std::ranges::find(names, token) != names.end())
+                    {
+                        messages += std::string(filename) + ":" + std::to_string(number) + ": " + std::string(token) +
+                            " is a specialization constant and can't be tested with #" + std::string(directive) + ", test it with if(" + std::string(token) + ")\n";
+                    }
+                }
+            }
+            return messages;
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "include/rhi_sc.h"
+#include <span>
+#include <string>
+#include <string_view>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // The main source with a boolean specialization constant declared ahead of it for every specialized macro,
+        // source refers to the text and filename held here
+        struct SpecializedSource
+        {
+            std::string text;
+            std::string filename;
+            ShaderSource source;
+        };
+        // Reads the main source through LoadSourceFile, false if it can't be read. The SpecId of names[i] is i
+        bool Specialize(const ShaderSource& source, std::span<const std::string> names, SpecializedSource& output);
+        // An error line for every preprocessor conditional of text testing one of names, it would see them undefined
+        std::string ConditionalUses(std::string_view text, std::string_view filename, std::span<const std::string> names);
+    }
+}
@@ -0,0 +1,271 @@
+#include "src/common/spirv.h"
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace Spirv
+        {
+            std::vector<Instruction> Parse(std::span<const uint32_t> code)
+            {
+                std::vector<Instruction> instructions;
+                if(code.size() < HeaderWords || code[0] != Magic) return instructions;
+                for(size_t offset = HeaderWords; offset < code.size();)
+                {
+                    uint32_t count = code[offset] >> 16;
+                    if(count == 0 || offset + count > code.size())
+                    {
+                        instructions.clear();
+                        return instructions;
+                    }
+                    instructions.push_back({code[offset] & 0xffff, offset, code.subspan(offset + 1, count - 1)});
+                    offset += count;
+                }
+                return instructions;
+            }
+            uint32_t InstructionCount(std::span<const uint32_t> code)
+            {
+                if(code.size() < HeaderWords || code[0] != Magic) return 0;
+                uint32_t instructions = 0;
+                for(size_t offset = HeaderWords; offset < code.size(); instructions++)
+                {
+                    uint32_t count = code[offset] >> 16;
+                    if(count == 0 || offset + count > code.size()) return 0;
+                    offset += count;
+                }
+                return instructions;
+            }
+            std::string LiteralString(std::span<const uint32_t> words, size_t* count)
+            {
+                std::string str;
+                size_t i = 0;
+                for(; i < words.size(); i++)
+                {
+                    for(uint32_t byte = 0; byte < 4; byte++)
+                    {
+                        char c = char(words[i] >> (byte * 8));
+                        if(c == 0)
+                        {
+                            if(count) *count = i + 1;
+                            return str;
+                        }
+                        str += c;
+                    }
+                }
+                if(count) *count = i;
+                return str;
+            }
+            static size_t StringWords(std::span<const uint32_t> words)
+            {
+                size_t count;
+                LiteralString(words, &count);
+                return count;
+            }
+            bool Describe(const Instruction& inst, OperandLayout& layout)
+            {
+                auto& ops = inst.operands;
+                const uint32_t size = ops.size();
+                layout.uses.clear();
+                layout.has_type = false;
+                layout.has_result = false;
+                auto ids_from = [&](uint32_t first, uint32_t last)
+                {
+                    for(uint32_t i = first; i < last && i < size; i++) layout.uses.push_back(i);
+                };
+                auto typed = [&](){ layout.has_type = true; layout.has_result = true; };
+                // memory operands: mask, an Aligned literal, then ids for MakePointerAvailable/Visible
+                auto memory_operands = [&](uint32_t first)
+                {
+                    if(first >= size) return first;
+                    uint32_t mask = ops[first++];
+                    if(mask & MemoryAccessAligned) first++;
+                    if(mask & MemoryAccessMakePointerAvailable) ids_from(first, first + 1), first++;
+                    if(mask & MemoryAccessMakePointerVisible) ids_from(first, first + 1), first++;
+                    return first;
+                };
+                switch(inst.opcode)
+                {
+                    case OpNop: case OpSourceContinued: case OpSourceExtension: case OpExtension: case OpMemoryModel:
+                    case OpCapability: case OpNoLine: case OpModuleProcessed: case OpFunctionEnd: case OpReturn: case OpKill:
+                    case OpUnreachable: case OpEmitVertex: case OpEndPrimitive: case OpTerminateInvocation:
+                    case OpDemoteToHelperInvocation:
+                        return true;
+                    case OpSource:
+                        if(size > 2) ids_from(2, 3);
+                        return true;
+                    case OpName: case OpMemberName: case OpLine: case OpDecorate: case OpMemberDecorate:
+                    case OpDecorateString: case OpMemberDecorateString: case OpExecutionMode: case OpTypeForwardPointer:
+                        ids_from(0, 1);
+                        return true;
+                    case OpExecutionModeId: case OpDecorateId:
+                        ids_from(0, 1);
+                        ids_from(2, size);
+                        return true;
+                    case OpString: case OpExtInstImport: case OpTypeVoid: case OpTypeBool: case OpTypeInt: case OpTypeFloat:
+                    case OpTypeSampler: case OpTypeOpaque: case OpTypeEvent: case OpTypeDeviceEvent: case OpTypeReserveId: case OpTypeQueue:
+                    case OpTypePipe: case OpDecorationGroup: case OpLabel: case OpTypeAccelerationStructureKHR:
+                        layout.has_result = true;
+                        return true;
+                    case OpTypeVector: case OpTypeMatrix: case OpTypeImage: case OpTypeSampledImage: case OpTypeRuntimeArray:
+                        layout.has_result = true;
+                        ids_from(1, 2);
+                        return true;
+                    case OpTypeArray:
+                        layout.has_result = true;
+                        ids_from(1, 3);
+                        return true;
+                    case OpTypeStruct: case OpTypeFunction:
+                        layout.has_result = true;
+                        ids_from(1, size);
+                        return true;
+                    case OpTypePointer:
+                        layout.has_result = true;
+                        ids_from(2, 3);
+                        return true;
+                    case OpEntryPoint:
+                        ids_from(1, 2);
+                        if(size > 2) ids_from(2 + StringWords(ops.subspan(2)), size);
+                        return true;
+                    case OpGroupDecorate:
+                        ids_from(0, size);
+                        return true;
+                    case OpGroupMemberDecorate:
+                        ids_from(0, 1);
+                        for(uint32_t i = 1; i < size; i += 2) ids_from(i, i + 1);
+                        return true;
+                    case OpUndef: case OpConstantTrue: case OpConstantFalse: case OpConstant: case OpConstantNull:
+                    case OpSpecConstantTrue: case OpSpecConstantFalse: case OpSpecConstant: case OpConstantSampler: case OpFunctionParameter:
+                    case OpIsHelperInvocation:
+                        typed();
+                        return true;
+                    case OpConstantComposite: case OpSpecConstantComposite:
+                        typed();
+                        ids_from(2, size);
+                        return true;
+                    case OpSpecConstantOp:
+                    {
+                        typed();
+                        if(size < 3) return true;
+                        uint32_t op = ops[2];
+                        if(op == OpVectorShuffle || op == OpCompositeInsert) ids_from(3, 5);
+                        else if(op == OpCompositeExtract) ids_from(3, 4);
+                        else ids_from(3, size);
+                        return true;
+                    }
+                    case OpExtInst:
+                        typed();
+                        ids_from(2, 3);
+                        ids_from(4, size);
+                        return true;
+                    case OpFunction:
+                        typed();
+                        ids_from(3, 4);
+                        return true;
+                    case OpVariable:
+                        typed();
+                        ids_from(3, 4);
+                        return true;
+                    case OpLoad:
+                        typed();
+                        ids_from(2, 3);
+                        memory_operands(3);
+                        return true;
+                    case OpStore:
+                        ids_from(0, 2);
+                        memory_operands(2);
+                        return true;
+                    case OpCopyMemory:
+                        ids_from(0, 2);
+                        memory_operands(memory_operands(2));
+                        return true;
+                    case OpCopyMemorySized:
+                        ids_from(0, 3);
+                        memory_operands(3);
+                        return true;
+                    case OpArrayLength: case OpImageSparseTexelsResident:
+                        typed();
+                        ids_from(2, 3);
+                        return true;
+                    case OpGenericCastToPtrExplicit:
+                        typed();
+                        ids_from(2, 3);
+                        return true;
+                    case OpVectorShuffle: case OpCompositeInsert:
+                        typed();
+                        ids_from(2, 4);
+                        return true;
+                    case OpCompositeExtract:
+                        typed();
+                        ids_from(2, 3);
+                        return true;
+                    case OpImageWrite:
+                        ids_from(0, 3);
+                        if(size > 3) ids_from(4, size);
+                        return true;
+                    case OpImageSampleImplicitLod: case OpImageSampleExplicitLod: case OpImageSampleProjImplicitLod:
+                    case OpImageSampleProjExplicitLod: case OpImageFetch: case OpImageRead: case OpImageSparseSampleImplicitLod:
+                    case OpImageSparseSampleExplicitLod: case OpImageSparseSampleProjImplicitLod:
+                    case OpImageSparseSampleProjExplicitLod: case OpImageSparseFetch: case OpImageSparseRead:
+                        typed();
+                        ids_from(2, 4);
+                        if(size > 4) ids_from(5, size);
+                        return true;
+                    case OpImageSampleDrefImplicitLod: case OpImageSampleDrefExplicitLod: case OpImageSampleProjDrefImplicitLod:
+                    case OpImageSampleProjDrefExplicitLod: case OpImageGather: case OpImageDrefGather:
+                    case OpImageSparseSampleDrefImplicitLod: case OpImageSparseSampleDrefExplicitLod:
+                    case OpImageSparseSampleProjDrefImplicitLod: case OpImageSparseSampleProjDrefExplicitLod:
+                    case OpImageSparseGather: case OpImageSparseDrefGather:
+                        typed();
+                        ids_from(2, 5);
+                        if(size > 5) ids_from(6, size);
+                        return true;
+                    case OpEmitStreamVertex: case OpEndStreamPrimitive: case OpReturnValue: case OpBranch:
+                        ids_from(0, size);
+                        return true;
+                    case OpControlBarrier: case OpMemoryBarrier: case OpAtomicStore:
+                        ids_from(0, size);
+                        return true;
+                    case OpLoopMerge:
+                        ids_from(0, 2);
+                        return true;
+                    case OpSelectionMerge:
+                        ids_from(0, 1);
+                        return true;
+                    case OpBranchConditional:
+                        ids_from(0, 3);
+                        return true;
+                    case OpSwitch:
+                        ids_from(0, 2);
+                        for(uint32_t i = 3; i < size; i += 2) ids_from(i, i + 1);
+                        return true;
+                    case OpLifetimeStart: case OpLifetimeStop:
+                        ids_from(0, 1);
+                        return true;
+                    default:
+                        break;
+                }
+                uint32_t op = inst.opcode;
+                if(op == OpGroupNonUniformBallotBitCount || (op >= OpGroupNonUniformIAdd && op <= OpGroupNonUniformLogicalXor))
+                {
+                    // group operation literal between the scope and the value
+                    typed();
+                    ids_from(2, 3);
+                    ids_from(4, size);
+                    return true;
+                }
+                // the remaining known instructions all read ids after their result type and id
+                bool value_op = op == OpFunctionCall || op == OpImageTexelPointer ||
+                    (op >= OpAccessChain && op <= OpInBoundsPtrAccessChain) ||
+                    (op >= OpVectorExtractDynamic && op <= OpTranspose) || op == OpSampledImage ||
+                    (op >= OpImage && op <= OpImageQuerySamples) || (op >= OpConvertFToU && op <= OpBitcast) ||
+                    (op >= OpSNegate && op <= OpSMulExtended) || (op >= OpAny && op <= OpFUnordGreaterThanEqual) ||
+                    (op >= OpShiftRightLogical && op <= OpBitCount) || (op >= OpDPdx && op <= OpFwidthCoarse) ||
+                    (op >= OpAtomicLoad && op <= OpAtomicXor) || op == OpPhi ||
+                    (op >= OpGroupNonUniformElect && op <= OpGroupNonUniformShuffleDown) || (op >= OpCopyLogical && op <= OpPtrDiff);
+                if(!value_op) return false;
+                typed();
+                ids_from(2, size);
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Minimal SPIR-V definitions and module walker, only what the post compile passes need
+        namespace Spirv
+        {
+            constexpr uint32_t Magic = 0x07230203;
+            constexpr uint32_t HeaderWords = 5;
+            enum Op : uint32_t
+            {
+                OpNop = 0, OpUndef = 1, OpSourceContinued = 2, OpSource = 3, OpSourceExtension = 4, OpName = 5,
+                OpMemberName = 6, OpString = 7, OpLine = 8, OpExtension = 10, OpExtInstImport = 11, OpExtInst = 12,
+                OpMemoryModel = 14, OpEntryPoint = 15, OpExecutionMode = 16, OpCapability = 17,
+                OpTypeVoid = 19, OpTypeBool = 20, OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeMatrix = 24,
+                OpTypeImage = 25, OpTypeSampler = 26, OpTypeSampledImage = 27, OpTypeArray = 28, OpTypeRuntimeArray = 29,
+                OpTypeStruct = 30, OpTypeOpaque = 31, OpTypePointer = 32, OpTypeFunction = 33, OpTypeEvent = 34,
+                OpTypeDeviceEvent = 35, OpTypeReserveId = 36, OpTypeQueue = 37, OpTypePipe = 38, OpTypeForwardPointer = 39,
+                OpConstantTrue = 41, OpConstantFalse = 42, OpConstant = 43, OpConstantComposite = 44, OpConstantSampler = 45,
+                OpConstantNull = 46, OpSpecConstantTrue = 48, OpSpecConstantFalse = 49, OpSpecConstant = 50,
+                OpSpecConstantComposite = 51, OpSpecConstantOp = 52, OpFunction = 54, OpFunctionParameter = 55,
+                OpFunctionEnd = 56, OpFunctionCall = 57, OpVariable = 59, OpImageTexelPointer = 60, OpLoad = 61, OpStore = 62,
+                OpCopyMemory = 63, OpCopyMemorySized = 64, OpAccessChain = 65, OpInBoundsAccessChain = 66, OpPtrAccessChain = 67,
+                OpArrayLength = 68, OpInBoundsPtrAccessChain = 70,
+                OpDecorate = 71, OpMemberDecorate = 72, OpDecorationGroup = 73, OpGroupDecorate = 74, OpGroupMemberDecorate = 75,
+                OpVectorExtractDynamic = 77, OpVectorShuffle = 79, OpCompositeExtract = 81, OpCompositeInsert = 82,
+                OpTranspose = 84, OpSampledImage = 86, OpImageSampleImplicitLod = 87, OpImageSampleExplicitLod = 88,
+                OpImageSampleDrefImplicitLod = 89, OpImageSampleDrefExplicitLod = 90, OpImageSampleProjImplicitLod = 91,
+                OpImageSampleProjExplicitLod = 92, OpImageSampleProjDrefImplicitLod = 93, OpImageSampleProjDrefExplicitLod = 94,
+                OpImageFetch = 95, OpImageGather = 96, OpImageDrefGather = 97, OpImageRead = 98, OpImageWrite = 99,
+                OpImage = 100, OpImageQuerySamples = 107, OpConvertFToU = 109, OpGenericCastToPtrExplicit = 123, OpBitcast = 124,
+                OpSNegate = 126, OpSMulExtended = 152, OpAny = 154, OpFUnordGreaterThanEqual = 191, OpShiftRightLogical = 194,
+                OpBitCount = 205, OpDPdx = 207, OpFwidthCoarse = 215,
+                OpEmitVertex = 218, OpEndPrimitive = 219, OpEmitStreamVertex = 220, OpEndStreamPrimitive = 221,
+                OpControlBarrier = 224, OpMemoryBarrier = 225, OpAtomicLoad = 227, OpAtomicStore = 228, OpAtomicXor = 242,
+                OpPhi = 245, OpLoopMerge = 246, OpSelectionMerge = 247, OpLabel = 248, OpBranch = 249, OpBranchConditional = 250,
+                OpSwitch = 251, OpKill = 252, OpReturn = 253, OpReturnValue = 254, OpUnreachable = 255,
+                OpLifetimeStart = 256, OpLifetimeStop = 257,
+                OpImageSparseSampleImplicitLod = 305, OpImageSparseSampleExplicitLod = 306, OpImageSparseSampleDrefImplicitLod = 307,
+                OpImageSparseSampleDrefExplicitLod = 308, OpImageSparseSampleProjImplicitLod = 309,
+                OpImageSparseSampleProjExplicitLod = 310, OpImageSparseSampleProjDrefImplicitLod = 311,
+                OpImageSparseSampleProjDrefExplicitLod = 312, OpImageSparseFetch = 313, OpImageSparseGather = 314,
+                OpImageSparseDrefGather = 315, OpImageSparseTexelsResident = 316, OpNoLine = 317, OpImageSparseRead = 320,
+                OpModuleProcessed = 330, OpExecutionModeId = 331, OpDecorateId = 332, OpGroupNonUniformElect = 333,
+                OpGroupNonUniformBallotBitCount = 342, OpGroupNonUniformShuffleDown = 348, OpGroupNonUniformIAdd = 349,
+                OpGroupNonUniformLogicalXor = 364, OpCopyLogical = 400, OpPtrDiff = 403, OpTerminateInvocation = 4416,
+                OpTypeAccelerationStructureKHR = 5341, OpDemoteToHelperInvocation = 5380, OpIsHelperInvocation = 5381,
+                OpDecorateString = 5632, OpMemberDecorateString = 5633
+            };
+            enum MemoryAccess : uint32_t
+            {
+                MemoryAccessAligned = 0x2, MemoryAccessMakePointerAvailable = 0x8, MemoryAccessMakePointerVisible = 0x10
+            };
+            // GLSL.std.450 extended instructions
+            enum GLSLstd450 : uint32_t
+            {
+                GLSLstd450Sin = 13, GLSLstd450InverseSqrt = 32, GLSLstd450Modf = 35, GLSLstd450Frexp = 51
+            };
+            enum Decoration : uint32_t
+            {
+                DecorationSpecId = 1, DecorationBlock = 2, DecorationBufferBlock = 3, DecorationArrayStride = 6, DecorationPatch = 15,
+                DecorationMatrixStride = 7, DecorationBuiltIn = 11, DecorationLocation = 30, DecorationComponent = 31,
+                DecorationBinding = 33, DecorationDescriptorSet = 34, DecorationOffset = 35, DecorationUserSemantic = 5635,
+                DecorationUserTypeGOOGLE = 5636
+            };
+            enum StorageClass : uint32_t
+            {
+                StorageClassUniformConstant = 0, StorageClassInput = 1, StorageClassUniform = 2, StorageClassOutput = 3,
+                StorageClassWorkgroup = 4, StorageClassPrivate = 6, StorageClassFunction = 7, StorageClassPushConstant = 9,
+                StorageClassImage = 11, StorageClassStorageBuffer = 12
+            };
+            enum ExecutionModel : uint32_t
+            {
+                ExecutionModelVertex = 0, ExecutionModelTessellationControl = 1, ExecutionModelTessellationEvaluation = 2,
+                ExecutionModelGeometry = 3, ExecutionModelFragment = 4, ExecutionModelGLCompute = 5
+            };
+            enum ExecutionMode : uint32_t
+            {
+                ExecutionModeLocalSize = 17, ExecutionModeLocalSizeId = 38
+            };
+            enum Dim : uint32_t
+            {
+                DimBuffer = 5, DimSubpassData = 6
+            };
+            struct Instruction
+            {
+                uint32_t opcode;
+                // word offset of the instruction in the module
+                size_t offset;
+                std::span<const uint32_t> operands;
+            };
+            // Splits a module into instructions, empty if the module is malformed
+            std::vector<Instruction> Parse(std::span<const uint32_t> code);
+            // Number of instructions in a module without splitting it, 0 if the module is malformed
+            uint32_t InstructionCount(std::span<const uint32_t> code);
+            // Decodes a literal string operand, count receives the number of words it used
+            std::string LiteralString(std::span<const uint32_t> words, size_t* count = nullptr);
+            struct OperandLayout
+            {
+                bool has_type = false;
+                bool has_result = false;
+                // indices into operands of the ids the instruction reads, the result type not included
+                std::vector<uint32_t> uses;
+            };
+            // Classifies the operands of inst, false for opcodes this walker doesn't know about.
+            // Switch literals are assumed to be 32 bit wide
+            bool Describe(const Instruction& inst, OperandLayout& layout);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "depfile.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        static std::filesystem::path StampPath(const std::filesystem::path& output)
+        {
+            auto path = output;
+            path += ".stamp";
+            return path;
+        }
+        static std::string Escape(const std::filesystem::path& path)
+        {
+            std::string escaped;
+            for(char c : path.generic_string())
+            {
+                if(c == ' ' || c == '#' || c == '\\') escaped += '\\';
+                else if(c == '$') escaped += '$';
+                escaped += c;
+            }
+            return escaped;
+        }
+        // FNV-1a, only used to tell whether a file changed
+        static bool HashFile(const std::filesystem::path& path, uint64_t& hash)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return false;
+            hash = 0xcbf29ce484222325;
+            char buffer[1 << 14];
+            while(file.read(buffer, sizeof(buffer)) || file.gcount())
+            {
+                for(std::streamsize i = 0; i < file.gcount(); i++)
+                    hash = (hash ^ uint8_t(buffer[i])) * 0x100000001b3;
+            }
+            return true;
+        }
+        static int64_t WriteTime(const std::filesystem::path& path, std::error_code& ec)
+        {
+            return std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        }
+        void WriteDepfileRule(std::ostream& out, const std::filesystem::path& target, const std::vector<std::filesystem::path>& dependencies)
+        {
+            out << Escape(target) << ':';
+            for(auto& dependency : dependencies)
+                out << " \\\n  " << Escape(dependency);
+            out << '\n';
+        }
+        void WriteStamp(const std::filesystem::path& output, const std::string& options, const std::vector<std::filesystem::path>& dependencies)
+        {
+            std::ostringstream stamp;
+            stamp << options << '\n';
+            for(auto& dependency : dependencies)
+            {
+                std::error_code ec;
+                uint64_t hash;
+                auto size = std::filesystem::file_size(dependency, ec);
+                auto time = WriteTime(dependency, ec);
+                if(ec || !HashFile(dependency, hash))
+                {
+                    // an unreadable dependency makes the output always out of date
+                    std::filesystem::remove(StampPath(output), ec);
+                    return;
+                }
+                stamp << size << ' ' << time << ' ' << hash << ' ' << dependency.string() << '\n';
+            }
+            std::ofstream(StampPath(output)) << stamp.str();
+        }
+        bool IsUpToDate(const std::filesystem::path& output, const std::string& options, std::vector<std::filesystem::path>& dependencies)
+        {
+            dependencies.clear();
+            std::ifstream stamp(StampPath(output));
+            std::string line;
+            if(!std::filesystem::exists(output) || !stamp || !std::getline(stamp, line) || line != options)
+                return false;
+            while(std::getline(stamp, line))
+            {
+                std::istringstream entry(line);
+                uintmax_t size;
+                int64_t time;
+                uint64_t hash, current_hash;
+                std::string path;
+                if(!(entry >> size >> time >> hash) || !std::getline(entry >> std::ws, path))
+                    return false;
+                std::error_code ec;
+                auto current_size = std::filesystem::file_size(path, ec);
+                auto current_time = WriteTime(path, ec);
+                if(ec || current_size != size) return false;
+                // only rehash files that were touched
+                if(current_time != time && (!HashFile(path, current_hash) || current_hash != hash))
+                    return false;
+                dependencies.emplace_back(path);
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Makefile style rule "target: deps...", understood by ninja and meson
+        void WriteDepfileRule(std::ostream& out, const std::filesystem::path& target, const std::vector<std::filesystem::path>& dependencies);
+        // The fingerprint of an output is stored next to it in "<output>.stamp": the options it was built with and
+        // the size, modification time and content hash of every dependency.
+        void WriteStamp(const std::filesystem::path& output, const std::string& options, const std::vector<std::filesystem::path>& dependencies);
+        // True if output exists and was built with options from dependencies whose contents haven't changed since.
+        // dependencies receives the recorded dependency list
+        bool IsUpToDate(const std::filesystem::path& output, const std::string& options, std::vector<std::filesystem::path>& dependencies);
+    }
+}
@@ -0,0 +1,213 @@
+#include "json.h"
+#include <charconv>
+#include <cstdint>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        const JsonValue* JsonValue::Find(std::string_view key) const
+        {
+            auto object = GetObject();
+            if(!object) return nullptr;
+            for(auto& [name, member] : *object)
+            {
+                if(name == key) return &member;
+            }
+            return nullptr;
+        }
+        namespace
+        {
+            class Parser
+            {
+            public:
+                explicit Parser(std::string_view text) : text(text)
+                {
+                }
+                std::optional<JsonValue> Document(std::string& error)
+                {
+                    JsonValue value;
+                    if(Value(value, 0))
+                    {
+                        Whitespace();
+                        if(pos == text.size()) return value;
+                        Fail("unexpected trailing characters");
+                    }
+                    size_t line = 1, column = 1;
+                    for(size_t i = 0; i < failed_at && i < text.size(); i++)
+                    {
+                        column = text[i] == '\n' ? 1 : column + 1;
+                        line += text[i] == '\n';
+                    }
+                    error = std::to_string(line) + ":" + std::to_string(column) + ": " + message;
+                    return std::nullopt;
+                }
+            private:
+                // deeper documents are rejected instead of overflowing the stack
+                static constexpr uint32_t MaxDepth = 256;
+                bool Fail(std::string why)
+                {
+                    if(message.empty())
+                    {
+                        message = std::move(why);
+                        failed_at = pos;
+                    }
+                    return false;
+                }
+                void Whitespace()
+                {
+                    while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+                        pos++;
+                }
+                bool Literal(std::string_view word)
+                {
+                    if(text.substr(pos, word.size()) != word) return Fail("invalid literal");
+                    pos += word.size();
+                    return true;
+                }
+                bool Value(JsonValue& out, uint32_t depth)
+                {
+                    if(depth > MaxDepth) return Fail("nesting too deep");
+                    Whitespace();
+                    if(pos == text.size()) return Fail("unexpected end of input");
+                    switch(text[pos])
+                    {
+                        case 'n': out.value = nullptr; return Literal("null");
+                        case 't': out.value = true; return Literal("true");
+                        case 'f': out.value = false; return Literal("false");
+                        case '"':
+                        {
+                            std::string str;
+                            if(!String(str)) return false;
+                            out.value = std::move(str);
+                            return true;
+                        }
+                        case '[':
+                        {
+                            pos++;
+                            JsonValue::Array array;
+                            Whitespace();
+                            if(pos < text.size() && text[pos] == ']')
+                            {
+                                pos++;
+                                out.value = std::move(array);
+                                return true;
+                            }
+                            while(true)
+                            {
+                                if(!Value(array.emplace_back(), depth + 1)) return false;
+                                Whitespace();
+                                if(pos < text.size() && text[pos] == ',') { pos++; continue; }
+                                if(pos < text.size() && text[pos] == ']') { pos++; break; }
+                                return Fail("expected ',' or ']'");
+                            }
+                            out.value = std::move(array);
+                            return true;
+                        }
+                        case '{':
+                        {
+                            pos++;
+                            JsonValue::Object object;
+                            Whitespace();
+                            if(pos < text.size() && text[pos] == '}')
+                            {
+                                pos++;
+                                out.value = std::move(object);
+                                return true;
+                            }
+                            while(true)
+                            {
+                                Whitespace();
+                                auto& [key, member] = object.emplace_back();
+                                if(pos == text.size() || text[pos] != '"') return Fail("expected a member name");
+                                if(!String(key)) return false;
+                                Whitespace();
+                                if(pos == text.size() || text[pos] != ':') return Fail("expected ':'");
+                                pos++;
+                                if(!Value(member, depth + 1)) return false;
+                                Whitespace();
+                                if(pos < text.size() && text[pos] == ',') { pos++; continue; }
+                                if(pos < text.size() && text[pos] == '}') { pos++; break; }
+                                return Fail("expected ',' or '}'");
+                            }
+                            out.value = std::move(object);
+                            return true;
+                        }
+                        default:
+                        {
+                            double number;
+                            auto [end, ec] = std::from_chars(text.data() + pos, text.data() + text.size(), number);
+                            if(ec != std::errc() || end == text.data() + pos) return Fail("unexpected character");
+                            pos = end - text.data();
+                            out.value = number;
+                            return true;
+                        }
+                    }
+                }
+                bool Hex(uint32_t& code)
+                {
+                    if(text.size() - pos < 4) return Fail("truncated \\u escape");
+                    auto [end, ec] = std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16);
+                    if(ec != std::errc() || end != text.data() + pos + 4) return Fail("invalid \\u escape");
+                    pos += 4;
+                    return true;
+                }
+                bool String(std::string& out)
+                {
+                    pos++;
+                    while(true)
+                    {
+                        if(pos == text.size()) return Fail("unterminated string");
+                        char c = text[pos++];
+                        if(c == '"') return true;
+                        if(uint8_t(c) < 0x20) return Fail("control character in string");
+                        if(c != '\\')
+                        {
+                            out += c;
+                            continue;
+                        }
+                        if(pos == text.size()) return Fail("unterminated string");
+                        switch(char escape = text[pos++])
+                        {
+                            case '"': case '\\': case '/': out += escape; break;
+                            case 'b': out += '\b'; break;
+                            case 'f': out += '\f'; break;
+                            case 'n': out += '\n'; break;
+                            case 'r': out += '\r'; break;
+                            case 't': out += '\t'; break;
+                            case 'u':
+                            {
+                                uint32_t code;
+                                if(!Hex(code)) return false;
+                                if(code >= 0xd800 && code < 0xdc00)
+                                {
+                                    uint32_t low;
+                                    if(text.substr(pos, 2) != "\\u") return Fail("unpaired surrogate");
+                                    pos += 2;
+                                    if(!Hex(low)) return false;
+                                    if(low < 0xdc00 || low >= 0xe000) return Fail("unpaired surrogate");
+                                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                                }
+                                // UTF-8
+                                if(code < 0x80) out += char(code);
+                                else if(code < 0x800) out += {char(0xc0 | code >> 6), char(0x80 | (code & 0x3f))};
+                                else if(code < 0x10000) out += {char(0xe0 | code >> 12), char(0x80 | (code >> 6 & 0x3f)), char(0x80 | (code & 0x3f))};
+                                else out += {char(0xf0 | code >> 18), char(0x80 | (code >> 12 & 0x3f)), char(0x80 | (code >> 6 & 0x3f)), char(0x80 | (code & 0x3f))};
+                                break;
+                            }
+                            default:
+                                return Fail("invalid escape");
+                        }
+                    }
+                }
+                std::string_view text;
+                size_t pos = 0;
+                std::string message;
+                size_t failed_at = 0;
+            };
+        }
+        std::optional<JsonValue> ParseJson(std::string_view text, std::string& error)
+        {
+            return Parser(text).Document(error);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Parsed JSON document, objects keep their members in document order
+        class JsonValue
+        {
+        public:
+            using Array = std::vector<JsonValue>;
+            using Object = std::vector<std::pair<std::string, JsonValue>>;
+            std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+            [[nodiscard]] bool IsNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+            [[nodiscard]] const bool* Bool() const { return std::get_if<bool>(&value); }
+            [[nodiscard]] const double* Number() const { return std::get_if<double>(&value); }
+            [[nodiscard]] const std::string* String() const { return std::get_if<std::string>(&value); }
+            [[nodiscard]] const Array* GetArray() const { return std::get_if<Array>(&value); }
+            [[nodiscard]] const Object* GetObject() const { return std::get_if<Object>(&value); }
+            // nullptr if this isn't an object or has no such member
+            [[nodiscard]] const JsonValue* Find(std::string_view key) const;
+        };
+        // error receives "line:column: message" on failure
+        std::optional<JsonValue> ParseJson(std::string_view text, std::string& error);
+    }
+}
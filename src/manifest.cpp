@@ -0,0 +1,336 @@
+#include "manifest.h"
+#include "json.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            // expanding more variants than this from one job is almost certainly a mistake in the manifest
+            constexpr size_t MaxVariants = 1 << 16;
+            std::optional<OptimizationLevel> ParseLevel(const JsonValue& value)
+            {
+                std::string level;
+                if(auto number = value.Number()) level = std::to_string(int(*number));
+                else if(auto str = value.String()) level = *str;
+                std::ranges::transform(level, level.begin(), [](unsigned char c){ return std::tolower(c); });
+                if(level == "none" || level == "0") return OptimizationLevel::None;
+                if(level == "1") return OptimizationLevel::_1;
+                if(level == "2") return OptimizationLevel::_2;
+                if(level == "3") return OptimizationLevel::_3;
+                if(level == "fast") return OptimizationLevel::Max;
+                return std::nullopt;
+            }
+            // nullopt for false and null, the macro is then left undefined
+            std::optional<MacroDefinition> ParseMacro(std::string name, const JsonValue& value, std::string& error)
+            {
+                if(value.IsNull() || (value.Bool() && !*value.Bool())) return std::nullopt;
+                if(value.Bool()) return MacroDefinition{std::move(name), std::nullopt};
+                if(auto str = value.String()) return MacroDefinition{std::move(name), *str};
+                if(auto number = value.Number())
+                {
+                    char buffer[32];
+                    auto end = std::to_chars(buffer, buffer + sizeof(buffer), *number).ptr;
+                    return MacroDefinition{std::move(name), std::string(buffer, end)};
+                }
+                error = "the value of " + name + " must be a string, number or boolean";
+                return std::nullopt;
+            }
+            // text of a permutation value in output names
+            std::string ValueName(const std::optional<MacroDefinition>& macro, const JsonValue& value)
+            {
+                if(value.Bool()) return *value.Bool() ? "1" : "0";
+                if(!macro) return "0";
+                return macro->value.value_or("1");
+            }
+            bool ParseDefines(const JsonValue& defines, MacroSet& macros, std::string& error)
+            {
+                if(auto object = defines.GetObject())
+                {
+                    for(auto& [name, value] : *object)
+                    {
+                        auto macro = ParseMacro(name, value, error);
+                        if(!error.empty()) return false;
+                        if(macro) macros.push_back(std::move(*macro));
+                    }
+                    return true;
+                }
+                if(auto array = defines.GetArray())
+                {
+                    for(auto& value : *array)
+                    {
+                        auto str = value.String();
+                        if(!str)
+                        {
+                            error = "defines given as an array must be strings";
+                            return false;
+                        }
+                        auto equals = str->find('=');
+                        if(equals == std::string::npos) macros.push_back({*str, std::nullopt});
+                        else macros.push_back({str->substr(0, equals), str->substr(equals + 1)});
+                    }
+                    return true;
+                }
+                error = "defines must be an object or an array";
+                return false;
+            }
+            // Applies the fields present in a job (or the defaults) on top of job
+            bool ParseJobFields(const JsonValue& fields, const std::filesystem::path& base, BuildJob& job, std::string& error)
+            {
+                if(!fields.GetObject())
+                {
+                    error = "must be an object";
+                    return false;
+                }
+                auto string_field = [&](const char* name, auto&& apply)
+                {
+                    auto field = fields.Find(name);
+                    if(!field) return true;
+                    if(!field->String())
+                    {
+                        error = std::string(name) + " must be a string";
+                        return false;
+                    }
+                    apply(*field->String());
+                    return true;
+                };
+                auto bool_field = [&](const char* name, bool& out)
+                {
+                    auto field = fields.Find(name);
+                    if(!field) return true;
+                    if(!field->Bool())
+                    {
+                        error = std::string(name) + " must be a boolean";
+                        return false;
+                    }
+                    out = *field->Bool();
+                    return true;
+                };
+                bool stage_known = true;
+                if(!string_field("input", [&](const std::string& input){ job.input = base / input; }) ||
+                    !string_field("output", [&](const std::string& output){ job.output = output; }) ||
+                    !string_field("entry", [&](const std::string& entry){ job.entry = entry; }) ||
+                    !string_field("stage", [&](const std::string& stage){ stage_known = (job.stage = ParseShaderStage(stage)) != ShaderStage::None; }) ||
+                    !bool_field("debug", job.debug) || !bool_field("reflect", job.reflect))
+                    return false;
+                if(!stage_known)
+                {
+                    error = "unknown stage";
+                    return false;
+                }
+                if(auto level = fields.Find("optimization"))
+                {
+                    auto parsed = ParseLevel(*level);
+                    if(!parsed)
+                    {
+                        error = "optimization must be none, 1, 2, 3 or fast";
+                        return false;
+                    }
+                    job.level = *parsed;
+                }
+                if(auto specialize = fields.Find("specialize"))
+                {
+                    auto array = specialize->GetArray();
+                    if(!array || !std::ranges::all_of(*array, [](auto& value) { return value.String() != nullptr; }))
+                    {
+                        error = "specialize must be an array of macro names";
+                        return false;
+                    }
+                    for(auto& value : *array)
+                    {
+                        if(std::ranges::find(job.specialize, *value.String()) == job.specialize.end())
+                            job.specialize.push_back(*value.String());
+                    }
+                }
+                if(auto defines = fields.Find("defines"))
+                    return ParseDefines(*defines, job.macros, error);
+                return true;
+            }
+            bool Expand(const JsonValue& desc, const BuildJob& job, bool archive, std::vector<BuildJob>& jobs, std::string& error)
+            {
+                auto axes_value = desc.Find("permutations");
+                static const JsonValue::Object no_axes;
+                auto all_axes = axes_value ? axes_value->GetObject() : &no_axes;
+                if(!all_axes)
+                {
+                    error = "permutations must be an object mapping macro names to arrays of values";
+                    return false;
+                }
+                // one module covers both values of a specialized axis
+                JsonValue::Object expanded;
+                for(auto& axis : *all_axes)
+                {
+                    if(std::ranges::find(job.specialize, axis.first) == job.specialize.end())
+                    {
+                        expanded.push_back(axis);
+                        continue;
+                    }
+                    auto array = axis.second.GetArray();
+                    if(!array || !std::ranges::all_of(*array, [](auto& value) { return value.Bool() != nullptr; }))
+                    {
+                        error = "specialized axis " + axis.first + " must be an array of booleans";
+                        return false;
+                    }
+                    if(job.output.find("{" + axis.first + "}") != std::string::npos)
+                    {
+                        error = "output can't contain {" + axis.first + "}, the axis is specialized";
+                        return false;
+                    }
+                }
+                auto axes = &expanded;
+                size_t variants = 1;
+                for(auto& [name, values] : *axes)
+                {
+                    auto array = values.GetArray();
+                    if(!array || array->empty())
+                    {
+                        error = "permutation axis " + name + " must be a non-empty array";
+                        return false;
+                    }
+                    variants *= array->size();
+                    if(variants > MaxVariants)
+                    {
+                        error = "expands into more than " + std::to_string(MaxVariants) + " variants";
+                        return false;
+                    }
+                }
+                bool named_by_axes = true;
+                for(auto& [name, values] : *axes)
+                    named_by_axes = named_by_axes && job.output.find("{" + name + "}") != std::string::npos;
+                if(variants > 1 && !archive && !named_by_axes)
+                {
+                    error = "output must contain {AXIS} for every permutation axis, otherwise the variants overwrite each other";
+                    return false;
+                }
+                // mixed radix counter over the axes
+                std::vector<size_t> index(axes->size(), 0);
+                for(size_t v = 0; v < variants; v++)
+                {
+                    auto& variant = jobs.emplace_back(job);
+                    MacroSet axis_macros;
+                    for(size_t a = 0; a < axes->size(); a++)
+                    {
+                        auto& [name, values] = (*axes)[a];
+                        auto& value = (*values.GetArray())[index[a]];
+                        auto macro = ParseMacro(name, value, error);
+                        if(!error.empty()) return false;
+                        auto placeholder = "{" + name + "}";
+                        for(size_t at; (at = variant.output.find(placeholder)) != std::string::npos;)
+                            variant.output.replace(at, placeholder.size(), ValueName(macro, value));
+                        if(macro) axis_macros.push_back(std::move(*macro));
+                    }
+                    variant.variant = PermutationKey(axis_macros);
+                    variant.macros.insert(variant.macros.end(), axis_macros.begin(), axis_macros.end());
+                    for(size_t a = axes->size(); a-- > 0;)
+                    {
+                        if(++index[a] < (*axes)[a].second.GetArray()->size()) break;
+                        index[a] = 0;
+                    }
+                }
+                return true;
+            }
+        }
+        ShaderStage ParseShaderStage(std::string_view name)
+        {
+            std::string stg(name);
+            std::ranges::transform(stg, stg.begin(), [](const unsigned char c){ return std::tolower(c); });
+            if (stg == "pixel")
+                return ShaderStage::Pixel;
+            else if (stg == "vertex")
+                return ShaderStage::Vertex;
+            else if (stg == "compute")
+                return ShaderStage::Compute;
+            else if (stg == "hull")
+                return ShaderStage::Hull;
+            else if (stg == "domain")
+                return ShaderStage::Domain;
+            else if (stg == "geometry")
+                return ShaderStage::Geometry;
+            else
+                return ShaderStage::None;
+        }
+        bool LoadManifest(const std::filesystem::path& path, Manifest& manifest, std::string& error)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if(!file)
+            {
+                error = "cannot open " + path.string();
+                return false;
+            }
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            std::string parse_error;
+            auto root = ParseJson(text, parse_error);
+            if(!root)
+            {
+                error = path.string() + ":" + parse_error;
+                return false;
+            }
+            auto base = path.parent_path();
+            auto fail = [&](const std::string& where)
+            {
+                error = path.string() + ": " + where + ": " + error;
+                return false;
+            };
+            if(auto archive = root->Find("archive"))
+            {
+                if(!archive->String())
+                {
+                    error = "must be a string";
+                    return fail("archive");
+                }
+                manifest.archive = base / *archive->String();
+            }
+            BuildJob defaults;
+            if(auto fields = root->Find("defaults"); fields && !ParseJobFields(*fields, base, defaults, error))
+                return fail("defaults");
+            auto jobs = root->Find("jobs");
+            if(!jobs || !jobs->GetArray())
+            {
+                error = "missing the jobs array";
+                return fail("jobs");
+            }
+            manifest.job_count = jobs->GetArray()->size();
+            std::set<std::string> outputs;
+            for(size_t i = 0; i < manifest.job_count; i++)
+            {
+                auto& desc = (*jobs->GetArray())[i];
+                auto where = "job " + std::to_string(i);
+                BuildJob job = defaults;
+                if(!ParseJobFields(desc, base, job, error)) return fail(where);
+                if(job.input.empty() || job.stage == ShaderStage::None)
+                {
+                    error = "input and stage are required";
+                    return fail(where);
+                }
+                // archive entries are named after their input by default
+                if(job.output.empty() && manifest.archive)
+                    job.output = (base.empty() ? job.input : job.input.lexically_relative(base)).generic_string();
+                if(job.output.empty())
+                {
+                    error = "output is required unless building an archive";
+                    return fail(where);
+                }
+                size_t first = manifest.jobs.size();
+                if(!Expand(desc, job, manifest.archive.has_value(), manifest.jobs, error)) return fail(where);
+                for(size_t v = first; v < manifest.jobs.size(); v++)
+                {
+                    auto& variant = manifest.jobs[v];
+                    if(!manifest.archive) variant.output = (base / variant.output).string();
+                    // archive entries only collide if their variant is the same too
+                    if(!outputs.insert(manifest.archive ? variant.output + '\0' + variant.variant : variant.output).second)
+                    {
+                        error = "writes " + variant.output + " which another job already writes";
+                        return fail(where);
+                    }
+                }
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "rhi_sc.h"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // One compilation of a batch, an -i/-o pair or one variant of a manifest job
+        struct BuildJob
+        {
+            std::filesystem::path input;
+            // the file written, or the entry name when building an archive
+            std::string output;
+            ShaderStage stage = ShaderStage::None;
+            std::string entry = "main";
+            OptimizationLevel level = OptimizationLevel::None;
+            bool debug = false;
+            bool reflect = false;
+            MacroSet macros;
+            // boolean macros compiled as specialization constants, see CompileOptions::SpecializeMacro
+            std::vector<std::string> specialize;
+            // archive key of the variant
+            std::string variant;
+        };
+        // A build described by a JSON file:
+        // {
+        //   "archive": "shaders.rsa",                      optional, pack every output into this archive
+        //   "defaults": { job fields },                    optional, the defines are prepended to every job's
+        //   "jobs": [{
+        //     "input": "lit.hlsl",
+        //     "output": "out/lit_{SHADOWS}_{QUALITY}.spv", {AXIS} is replaced by the variant's value of the axis
+        //     "stage": "pixel", "entry": "PSMain", "optimization": "3", "debug": false, "reflect": true,
+        //     "defines": {"USE_FOG": "1", "DEBUG": true} or ["USE_FOG=1", "DEBUG"],
+        //     "permutations": {"SHADOWS": [false, true], "QUALITY": [0, 1, 2]},
+        //     "specialize": ["SHADOWS"]
+        //   }]
+        // }
+        // Macro values can be strings or numbers, true defines the macro without a value and false leaves it undefined.
+        // Every job is expanded into the cross product of its permutation axes. Specialized axes aren't expanded, they
+        // become specialization constants of every variant and must be [false, true]. Relative paths are relative to the manifest
+        struct Manifest
+        {
+            std::optional<std::filesystem::path> archive;
+            // jobs as written in the manifest, before expansion
+            size_t job_count = 0;
+            std::vector<BuildJob> jobs;
+        };
+        // error describes the first problem found
+        bool LoadManifest(const std::filesystem::path& path, Manifest& manifest, std::string& error);
+        // Case insensitive stage name as taken by -t, ShaderStage::None if unknown
+        ShaderStage ParseShaderStage(std::string_view name);
+    }
+}
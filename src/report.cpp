@@ -0,0 +1,268 @@
+#include "report.h"
+#include "json.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <utility>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        static std::array<std::pair<const char*, double>, 5> Phases(const CompilationStats& stats)
+        {
+            return {{
+                {"load", stats.load_ms},
+                {"preprocess", stats.preprocess_ms},
+                {"codegen", stats.codegen_ms},
+                {"optimize", stats.optimize_ms},
+                {"output", stats.output_ms}
+            }};
+        }
+        static std::string Format(const char* format, auto... args)
+        {
+            char buffer[256];
+            std::snprintf(buffer, sizeof(buffer), format, args...);
+            return buffer;
+        }
+        void WriteTimeReport(std::ostream& out, const std::vector<std::string>& names, const std::vector<CompilationResult>& results)
+        {
+            CompilationStats sum;
+            std::array<double, 5> phase_totals = {};
+            size_t inputs = 0, cache_hits = 0;
+            std::vector<size_t> order;
+            for(size_t i = 0; i < results.size(); i++)
+            {
+                auto& stats = results[i].stats;
+                if(!stats) continue;
+                auto phases = Phases(*stats);
+                for(size_t p = 0; p < phases.size(); p++) phase_totals[p] += phases[p].second;
+                sum.total_ms += stats->total_ms;
+                sum.input_bytes += stats->input_bytes;
+                sum.output_bytes += stats->output_bytes;
+                sum.include_count += stats->include_count;
+                sum.instructions_before += stats->instructions_before;
+                sum.instructions_after += stats->instructions_after;
+                sum.stripped_bytes += stats->stripped_bytes;
+                cache_hits += stats->cache_hit;
+                inputs++;
+                order.push_back(i);
+            }
+            if(!inputs)
+            {
+                out << "No timing information, every input was up to date or failed\n";
+                return;
+            }
+            out << "Phase           Total (ms)   Share\n";
+            auto phases = Phases(sum);
+            for(size_t p = 0; p < phases.size(); p++)
+            {
+                double share = sum.total_ms > 0 ? phase_totals[p] / sum.total_ms * 100 : 0;
+                out << Format("%-14s %11.2f  %5.1f%%\n", phases[p].first, phase_totals[p], share);
+            }
+            out << Format("%-14s %11.2f\n", "total", sum.total_ms);
+            out << inputs << " inputs (" << cache_hits << " from cache), " << sum.include_count << " includes, "
+                << sum.input_bytes << " bytes in, " << sum.output_bytes << " bytes out\n";
+            out << sum.instructions_before << " instructions before optimization, " << sum.instructions_after << " after\n";
+            if(sum.stripped_bytes)
+                out << sum.stripped_bytes << " bytes removed by stripping and id remapping\n";
+
+            constexpr size_t slowest = 10;
+            std::ranges::sort(order, std::greater<>(), [&](size_t i) { return results[i].stats->total_ms; });
+            order.resize(std::min(order.size(), slowest));
+            out << "Slowest inputs:\n";
+            for(auto i : order)
+            {
+                auto& stats = *results[i].stats;
+                auto phases = Phases(stats);
+                auto hottest = std::ranges::max_element(phases, {}, &std::pair<const char*, double>::second);
+                out << Format("%11.2f ms  ", stats.total_ms) << names[i]
+                    << Format(" (%s %.2f ms)\n", hottest->first, hottest->second);
+            }
+        }
+        static std::string JsonString(std::string_view str)
+        {
+            std::string out = "\"";
+            for(char c : str)
+            {
+                if(c == '"' || c == '\\') out += '\\';
+                if(uint8_t(c) < 0x20) out += Format("\\u%04x", c);
+                else out += c;
+            }
+            return out + "\"";
+        }
+        bool WriteTrace(const std::filesystem::path& path, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, const std::vector<JobTiming>& jobs)
+        {
+            std::ofstream out(path);
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            bool first = true;
+            // timestamps and durations are microseconds
+            auto event = [&](std::string_view name, const char* category, size_t worker, double start_ms, double duration_ms, const std::string& args)
+            {
+                out << (first ? "" : ",\n") << "{\"name\": " << JsonString(name) << ", \"cat\": \"" << category
+                    << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << worker
+                    << Format(", \"ts\": %.3f, \"dur\": %.3f", start_ms * 1000, duration_ms * 1000);
+                if(!args.empty()) out << ", \"args\": {" << args << "}";
+                out << "}";
+                first = false;
+            };
+            for(size_t i = 0; i < results.size(); i++)
+            {
+                auto& job = jobs[i];
+                auto& stats = results[i].stats;
+                if(!stats)
+                {
+                    // inputs skipped as up to date were never timed
+                    if(job.wall_ms > 0) event(names[i], "compile", job.worker, job.start_ms, job.wall_ms, "");
+                    continue;
+                }
+                event(names[i], "compile", job.worker, job.start_ms, job.wall_ms,
+                    Format("\"input_bytes\": %llu, \"output_bytes\": %llu, \"includes\": %u, \"instructions_before\": %u, \"instructions_after\": %u, \"cache_hit\": %s",
+                        (unsigned long long)stats->input_bytes, (unsigned long long)stats->output_bytes, stats->include_count,
+                        stats->instructions_before, stats->instructions_after, stats->cache_hit ? "true" : "false"));
+                // the phases are laid out back to back, loads really happen in between the others
+                double start = job.start_ms;
+                for(auto& [phase, ms] : Phases(*stats))
+                {
+                    if(ms <= 0) continue;
+                    event(phase, "phase", job.worker, start, ms, "");
+                    start += ms;
+                }
+            }
+            out << "\n]}\n";
+            return out.good();
+        }
+        struct CostMetric
+        {
+            const char* name;
+            uint32_t ShaderCost::* value;
+            // compared by CompareCost, the others describe the shape of the code
+            bool gated;
+        };
+        static constexpr CostMetric CostMetrics[] = {
+            {"alu", &ShaderCost::alu, true},
+            {"transcendental", &ShaderCost::transcendental, true},
+            {"texture", &ShaderCost::texture, true},
+            {"memory", &ShaderCost::memory, true},
+            {"barrier", &ShaderCost::barrier, true},
+            {"other", &ShaderCost::other, false},
+            {"peak_live_values", &ShaderCost::peak_live_values, false},
+            {"peak_live_scalars", &ShaderCost::peak_live_scalars, true},
+            {"functions", &ShaderCost::functions, false},
+            {"blocks", &ShaderCost::blocks, false},
+            {"branches", &ShaderCost::branches, false},
+            {"loops", &ShaderCost::loops, false},
+            {"max_loop_depth", &ShaderCost::max_loop_depth, false},
+            {"loop_instructions", &ShaderCost::loop_instructions, true},
+            {"uniform_buffers", &ShaderCost::uniform_buffers, false},
+            {"storage_buffers", &ShaderCost::storage_buffers, false},
+            {"textures", &ShaderCost::textures, false},
+            {"storage_images", &ShaderCost::storage_images, false},
+            {"samplers", &ShaderCost::samplers, false}
+        };
+        static const char* StageName(ShaderStage stage)
+        {
+            switch(stage)
+            {
+                case ShaderStage::Vertex: return "vertex";
+                case ShaderStage::Pixel: return "pixel";
+                case ShaderStage::Geometry: return "geometry";
+                case ShaderStage::Hull: return "hull";
+                case ShaderStage::Domain: return "domain";
+                case ShaderStage::Compute: return "compute";
+                default: return "unknown";
+            }
+        }
+        bool WriteCostReport(const std::filesystem::path& path, const std::vector<std::string>& names, const std::vector<CompilationResult>& results)
+        {
+            std::ofstream out(path);
+            out << "{";
+            bool first = true;
+            for(size_t i = 0; i < results.size(); i++)
+            {
+                if(results[i].cost.empty()) continue;
+                out << (first ? "\n  " : ",\n  ") << JsonString(names[i]) << ": [";
+                first = false;
+                for(size_t e = 0; e < results[i].cost.size(); e++)
+                {
+                    auto& cost = results[i].cost[e];
+                    out << (e ? ",\n    {" : "\n    {") << "\"entry_point\": " << JsonString(cost.entry_point)
+                        << ", \"stage\": \"" << StageName(cost.stage) << "\"";
+                    for(auto& metric : CostMetrics)
+                        out << ", \"" << metric.name << "\": " << cost.*metric.value;
+                    out << ", \"push_constants\": " << (cost.push_constants ? "true" : "false")
+                        << ", \"approximate\": " << (cost.approximate ? "true" : "false") << "}";
+                }
+                out << "\n  ]";
+            }
+            out << "\n}\n";
+            return out.good();
+        }
+        bool CompareCost(const std::filesystem::path& baseline, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, double tolerance, std::string& messages)
+        {
+            std::ifstream file(baseline, std::ios::binary);
+            if(!file) return false;
+            std::stringstream text;
+            text << file.rdbuf();
+            std::string error;
+            auto document = ParseJson(text.str(), error);
+            if(!document || !document->GetObject())
+            {
+                messages += baseline.string() + ": " + (document ? "not a cost report" : error) + "\n";
+                return false;
+            }
+            for(size_t i = 0; i < results.size(); i++)
+            {
+                auto shader = document->Find(names[i]);
+                auto entries = shader ? shader->GetArray() : nullptr;
+                if(!entries) continue;
+                for(auto& cost : results[i].cost)
+                {
+                    auto entry = std::ranges::find_if(*entries, [&](const JsonValue& entry)
+                    {
+                        auto name = entry.Find("entry_point");
+                        return name && name->String() && *name->String() == cost.entry_point;
+                    });
+                    if(entry == entries->end()) continue;
+                    for(auto& metric : CostMetrics)
+                    {
+                        auto before = metric.gated ? entry->Find(metric.name) : nullptr;
+                        if(!before || !before->Number()) continue;
+                        double limit = *before->Number() * (1 + tolerance / 100);
+                        if(cost.*metric.value > limit)
+                            messages += names[i] + ": " + cost.entry_point + " " + metric.name + " grew from " +
+                                Format("%.0f to %u", *before->Number(), cost.*metric.value) + ", more than " + Format("%g%%", tolerance) + "\n";
+                    }
+                }
+            }
+            return true;
+        }
+        bool CheckCost(const CostCheck& check, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, std::ostream& errors)
+        {
+            for(size_t i = 0; i < results.size(); i++)
+            {
+                for(auto& entry : results[i].cost)
+                {
+                    if(entry.approximate)
+                        errors << names[i] << ": warning: " << entry.entry_point << " holds instructions the cost analysis doesn't know, its peak live counts are too low\n";
+                }
+            }
+            bool passed = true;
+            if(check.report && !WriteCostReport(*check.report, names, results))
+            {
+                errors << "Failed to write " << check.report->string() << "\n";
+                passed = false;
+            }
+            std::string regressions;
+            if(check.baseline && !CompareCost(*check.baseline, names, results, check.tolerance, regressions))
+            {
+                errors << regressions << "Failed to read " << check.baseline->string() << "\n";
+                return false;
+            }
+            errors << regressions;
+            return passed && regressions.empty();
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "rhi_sc.h"
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // When and where the CLI ran an input, milliseconds since the start of the run
+        struct JobTiming
+        {
+            size_t worker = 0;
+            double start_ms = 0;
+            double wall_ms = 0;
+        };
+        // Phase totals over every input that carries stats, followed by the slowest inputs
+        void WriteTimeReport(std::ostream& out, const std::vector<std::string>& names, const std::vector<CompilationResult>& results);
+        // Chrome trace (chrome://tracing, Perfetto) with one row per worker, every input is a slice split into its phases
+        bool WriteTrace(const std::filesystem::path& path, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, const std::vector<JobTiming>& jobs);
+        // JSON object mapping every name to the cost of its entry points, results without cost are left out
+        bool WriteCostReport(const std::filesystem::path& path, const std::vector<std::string>& names, const std::vector<CompilationResult>& results);
+        // Checks the results against a cost report written earlier, messages receives a line per metric that grew by more than
+        // tolerance percent. Shaders and entry points missing from either side are ignored. False if the baseline can't be read
+        bool CompareCost(const std::filesystem::path& baseline, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, double tolerance, std::string& messages);
+        // What --cost-report, --cost-baseline and --cost-tolerance ask for
+        struct CostCheck
+        {
+            std::optional<std::filesystem::path> report;
+            std::optional<std::filesystem::path> baseline;
+            double tolerance = 5.0;
+        };
+        // Warns about approximate entry points, writes the report and prints the regressions against the baseline to errors.
+        // False if the report can't be written, the baseline can't be read or a shader costs more than it allows
+        bool CheckCost(const CostCheck& check, const std::vector<std::string>& names, const std::vector<CompilationResult>& results, std::ostream& errors);
+    }
+}
@@ -0,0 +1,406 @@
+#include "server.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            class Writer
+            {
+            public:
+                std::vector<char> bytes;
+                void U32(uint32_t value)
+                {
+                    for(uint32_t i = 0; i < 4; i++) bytes.push_back(char(value >> (i * 8)));
+                }
+                void U64(uint64_t value)
+                {
+                    U32(uint32_t(value));
+                    U32(uint32_t(value >> 32));
+                }
+                void String(std::string_view str)
+                {
+                    U32(str.size());
+                    bytes.insert(bytes.end(), str.begin(), str.end());
+                }
+            };
+            class Reader
+            {
+            public:
+                explicit Reader(std::span<const char> bytes) : bytes(bytes)
+                {
+                }
+                bool U32(uint32_t& value)
+                {
+                    if(bytes.size() < 4) return false;
+                    value = 0;
+                    for(uint32_t i = 0; i < 4; i++) value |= uint32_t(uint8_t(bytes[i])) << (i * 8);
+                    bytes = bytes.subspan(4);
+                    return true;
+                }
+                bool U64(uint64_t& value)
+                {
+                    uint32_t low, high;
+                    if(!U32(low) || !U32(high)) return false;
+                    value = low | (uint64_t(high) << 32);
+                    return true;
+                }
+                bool String(std::string& str)
+                {
+                    uint32_t size;
+                    if(!U32(size) || bytes.size() < size) return false;
+                    str.assign(bytes.data(), size);
+                    bytes = bytes.subspan(size);
+                    return true;
+                }
+                bool Bytes(std::vector<char>& out)
+                {
+                    uint32_t size;
+                    if(!U32(size) || bytes.size() < size) return false;
+                    out.assign(bytes.begin(), bytes.begin() + size);
+                    bytes = bytes.subspan(size);
+                    return true;
+                }
+            private:
+                std::span<const char> bytes;
+            };
+            bool WriteFrame(Channel& channel, const std::vector<char>& payload)
+            {
+                if(payload.size() > MaxFrameSize) return false;
+                Writer size;
+                size.U32(payload.size());
+                return channel.Write(size.bytes.data(), size.bytes.size()) && channel.Write(payload.data(), payload.size());
+            }
+            bool ReadFrame(Channel& channel, std::vector<char>& payload)
+            {
+                char size_bytes[4];
+                uint32_t size;
+                if(!channel.Read(size_bytes, 4) || !Reader(size_bytes).U32(size) || size > MaxFrameSize) return false;
+                payload.resize(size);
+                return channel.Read(payload.data(), size);
+            }
+            std::vector<char> Encode(const ServerRequest& request)
+            {
+                Writer w;
+                w.U32(ServerProtocolMagic);
+                w.U32(request.inline_source);
+                w.String(request.source);
+                w.String(request.filename);
+                w.U32(static_cast<uint32_t>(request.stage));
+                w.String(request.entry);
+                w.U32(static_cast<uint32_t>(request.level));
+                w.U32(request.debug);
+                w.U32(request.reflect);
+                w.U32(request.strip);
+                w.U32(request.remap);
+                w.U32(static_cast<uint32_t>(request.compression));
+                w.U32(request.stats);
+                w.U32(request.macros.size());
+                for(auto& [name, value] : request.macros)
+                {
+                    w.String(name);
+                    w.U32(value.has_value());
+                    w.String(value.value_or(""));
+                }
+                w.U32(request.specialize.size());
+                for(auto& name : request.specialize)
+                    w.String(name);
+                w.String(request.output);
+                return std::move(w.bytes);
+            }
+            bool Decode(std::span<const char> bytes, ServerRequest& request)
+            {
+                Reader r(bytes);
+                uint32_t magic, inline_source, stage, level, debug, reflect, strip, remap, compression, stats, num_macros;
+                if(!r.U32(magic) || magic != ServerProtocolMagic) return false;
+                if(!r.U32(inline_source) || !r.String(request.source) || !r.String(request.filename)) return false;
+                if(!r.U32(stage) || !r.String(request.entry) || !r.U32(level) || !r.U32(debug) || !r.U32(reflect) || !r.U32(strip) || !r.U32(remap) || !r.U32(compression) || !r.U32(stats) || !r.U32(num_macros)) return false;
+                request.inline_source = inline_source;
+                request.stage = static_cast<ShaderStage>(stage);
+                request.level = static_cast<OptimizationLevel>(level);
+                request.debug = debug;
+                request.reflect = reflect;
+                request.strip = strip;
+                request.remap = remap;
+                request.compression = static_cast<ShaderCompression>(compression);
+                request.stats = stats;
+                request.macros.clear();
+                for(uint32_t i = 0; i < num_macros; i++)
+                {
+                    auto& [name, value] = request.macros.emplace_back();
+                    uint32_t has_value;
+                    std::string str;
+                    if(!r.String(name) || !r.U32(has_value) || !r.String(str)) return false;
+                    if(has_value) value = std::move(str);
+                }
+                uint32_t num_specialized;
+                if(!r.U32(num_specialized)) return false;
+                request.specialize.clear();
+                for(uint32_t i = 0; i < num_specialized; i++)
+                {
+                    if(!r.String(request.specialize.emplace_back())) return false;
+                }
+                return r.String(request.output);
+            }
+            std::vector<char> Encode(const ServerResponse& response)
+            {
+                Writer w;
+                w.U32(ServerProtocolMagic);
+                w.U32(static_cast<uint32_t>(response.result.error));
+                w.U32(response.result.warning_count);
+                w.String(response.result.messages);
+                w.String(std::string_view(response.output.data(), response.output.size()));
+                w.U32(response.result.dependencies.size());
+                for(auto& dependency : response.result.dependencies)
+                    w.String(dependency.string());
+                w.U32(response.result.stats.has_value());
+                if(auto& stats = response.result.stats)
+                {
+                    // times travel as whole nanoseconds
+                    for(double ms : {stats->load_ms, stats->preprocess_ms, stats->codegen_ms, stats->optimize_ms, stats->output_ms, stats->total_ms})
+                        w.U64(uint64_t(ms * 1e6));
+                    w.U64(stats->input_bytes);
+                    w.U64(stats->output_bytes);
+                    w.U32(stats->include_count);
+                    w.U32(stats->instructions_before);
+                    w.U32(stats->instructions_after);
+                    w.U32(stats->cache_hit);
+                    w.U64(stats->stripped_bytes);
+                }
+                return std::move(w.bytes);
+            }
+            bool Decode(std::span<const char> bytes, ServerResponse& response)
+            {
+                Reader r(bytes);
+                uint32_t magic, error;
+                if(!r.U32(magic) || magic != ServerProtocolMagic) return false;
+                if(!r.U32(error) || !r.U32(response.result.warning_count)) return false;
+                response.result.error = static_cast<CompilationError>(error);
+                uint32_t num_dependencies;
+                if(!r.String(response.result.messages) || !r.Bytes(response.output) || !r.U32(num_dependencies))
+                    return false;
+                response.result.dependencies.clear();
+                for(uint32_t i = 0; i < num_dependencies; i++)
+                {
+                    std::string dependency;
+                    if(!r.String(dependency)) return false;
+                    response.result.dependencies.emplace_back(std::move(dependency));
+                }
+                uint32_t has_stats;
+                if(!r.U32(has_stats)) return false;
+                if(!has_stats) return true;
+                auto& stats = response.result.stats.emplace();
+                for(double* ms : {&stats.load_ms, &stats.preprocess_ms, &stats.codegen_ms, &stats.optimize_ms, &stats.output_ms, &stats.total_ms})
+                {
+                    uint64_t ns;
+                    if(!r.U64(ns)) return false;
+                    *ms = ns / 1e6;
+                }
+                uint32_t cache_hit;
+                if(!r.U64(stats.input_bytes) || !r.U64(stats.output_bytes) || !r.U32(stats.include_count) ||
+                    !r.U32(stats.instructions_before) || !r.U32(stats.instructions_after) || !r.U32(cache_hit) || !r.U64(stats.stripped_bytes))
+                    return false;
+                stats.cache_hit = cache_hit;
+                return true;
+            }
+            class FileChannel : public Channel
+            {
+            public:
+                FileChannel(FILE* in, FILE* out) : in(in), out(out)
+                {
+                }
+                bool Read(void* data, size_t size) override
+                {
+                    return std::fread(data, 1, size, in) == size;
+                }
+                bool Write(const void* data, size_t size) override
+                {
+                    return std::fwrite(data, 1, size, out) == size && std::fflush(out) == 0;
+                }
+            private:
+                FILE* in;
+                FILE* out;
+            };
+#ifndef _WIN32
+            class SocketChannel : public Channel
+            {
+            public:
+                explicit SocketChannel(int fd) : fd(fd)
+                {
+                }
+                ~SocketChannel() override
+                {
+                    close(fd);
+                }
+                bool Read(void* data, size_t size) override
+                {
+                    for(auto bytes = static_cast<char*>(data); size;)
+                    {
+                        auto count = recv(fd, bytes, size, 0);
+                        if(count <= 0) return false;
+                        bytes += count; size -= count;
+                    }
+                    return true;
+                }
+                bool Write(const void* data, size_t size) override
+                {
+                    for(auto bytes = static_cast<const char*>(data); size;)
+                    {
+                        auto count = send(fd, bytes, size, MSG_NOSIGNAL);
+                        if(count <= 0) return false;
+                        bytes += count; size -= count;
+                    }
+                    return true;
+                }
+            private:
+                int fd;
+            };
+            bool MakeAddress(const std::filesystem::path& path, sockaddr_un& address)
+            {
+                std::memset(&address, 0, sizeof(address));
+                address.sun_family = AF_UNIX;
+                auto str = path.string();
+                if(str.size() >= sizeof(address.sun_path)) return false;
+                std::memcpy(address.sun_path, str.c_str(), str.size());
+                return true;
+            }
+#endif
+        }
+        std::unique_ptr<Channel> StdioChannel()
+        {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            return std::make_unique<FileChannel>(stdin, stdout);
+        }
+        std::unique_ptr<Channel> ConnectSocket(const std::filesystem::path& path)
+        {
+#ifndef _WIN32
+            sockaddr_un address;
+            if(!MakeAddress(path, address)) return nullptr;
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(fd < 0) return nullptr;
+            if(connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+            {
+                close(fd);
+                return nullptr;
+            }
+            return std::make_unique<SocketChannel>(fd);
+#else
+            return nullptr;
+#endif
+        }
+        bool SendRequest(Channel& channel, const ServerRequest& request)
+        {
+            return WriteFrame(channel, Encode(request));
+        }
+        bool ReceiveResponse(Channel& channel, ServerResponse& response)
+        {
+            std::vector<char> frame;
+            return ReadFrame(channel, frame) && Decode(frame, response);
+        }
+        ServerResponse CompilerPool::Handle(const ServerRequest& request)
+        {
+            auto opt = CompileOptions::New();
+            if(request.debug) opt->EnableDebuggingSymbols();
+            if(request.reflect) opt->EnableReflection();
+            if(request.strip) opt->StripDebugInfo();
+            if(request.remap) opt->RemapIds();
+            opt->SetCompression(request.compression);
+            opt->SetEntryPoint(request.entry);
+            if(request.stats) opt->EnableStatistics();
+            opt->SetOptimizationLevel(request.level);
+            for(auto& [name, value] : request.macros)
+                opt->AddMacroDefinition(name, value ? std::optional<std::string_view>(*value) : std::nullopt);
+            for(auto& name : request.specialize)
+                opt->SpecializeMacro(name);
+            ShaderSource src;
+            src.stage = request.stage;
+            if(request.inline_source)
+                src.source = ShaderSource::StringSource{request.source, request.filename};
+            else
+                src.source = std::filesystem::path(request.source);
+
+            ServerResponse response;
+            if(request.output.empty())
+                response.result = compiler->CompileToBuffer(RHI::API::Vulkan, src, opt, response.output, false);
+            else
+                response.result = compiler->CompileToFile(src, opt, request.output);
+            return response;
+        }
+        void Serve(Channel& channel, CompilerPool& pool)
+        {
+            std::vector<char> frame;
+            while(ReadFrame(channel, frame))
+            {
+                ServerRequest request;
+                ServerResponse response;
+                if(Decode(frame, request))
+                {
+                    response = pool.Handle(request);
+                }
+                else
+                {
+                    response.result.error = CompilationError::Error;
+                    response.result.messages = "Malformed compile request\n";
+                }
+                if(!WriteFrame(channel, Encode(response))) return;
+            }
+        }
+        std::string ServeSocket(const std::filesystem::path& path, CompilerPool& pool)
+        {
+#ifndef _WIN32
+            sockaddr_un address;
+            if(!MakeAddress(path, address)) return "Failed to listen on " + path.string() + ": the path is too long";
+            std::error_code ec;
+            auto status = std::filesystem::symlink_status(path, ec);
+            if(std::filesystem::exists(status))
+            {
+                if(!std::filesystem::is_socket(status))
+                    return "Failed to listen on " + path.string() + ": the path exists and isn't a socket";
+                std::filesystem::remove(path, ec);
+            }
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(fd < 0) return "Failed to listen on " + path.string() + ": " + std::strerror(errno);
+            if(bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+            {
+                std::string error = "Failed to listen on " + path.string() + ": " + std::strerror(errno);
+                close(fd);
+                return error;
+            }
+            while(true)
+            {
+                int client = accept(fd, nullptr, nullptr);
+                if(client < 0)
+                {
+                    if(errno == EINTR || errno == ECONNABORTED) continue;
+                    break;
+                }
+                std::thread([client, &pool]()
+                {
+                    SocketChannel channel(client);
+                    Serve(channel, pool);
+                }).detach();
+            }
+            std::string error = "Stopped accepting connections on " + path.string() + ": " + std::strerror(errno);
+            close(fd);
+            return error;
+#else
+            return "Unix domain sockets aren't supported on this platform";
+#endif
+        }
+    }
+}
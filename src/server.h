@@ -0,0 +1,76 @@
+#pragma once
+#include "rhi_sc.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        // Protocol: every message is a frame of [u32 payload size][payload], integers are little endian
+        // and strings are [u32 size][bytes]. The client sends a ServerRequest and receives one ServerResponse per frame.
+        constexpr uint32_t ServerProtocolMagic = 0x37435352; // "RSC7"
+        // Larger frames are refused and the connection is dropped
+        constexpr uint32_t MaxFrameSize = 64u << 20;
+        struct ServerRequest
+        {
+            bool inline_source = false;
+            // a path, or the shader text when inline_source is set
+            std::string source;
+            std::string filename;
+            ShaderStage stage = ShaderStage::None;
+            std::string entry = "main";
+            OptimizationLevel level = OptimizationLevel::None;
+            bool debug = false;
+            bool reflect = false;
+            bool strip = false;
+            bool remap = false;
+            ShaderCompression compression = ShaderCompression::None;
+            bool stats = false;
+            MacroSet macros;
+            std::vector<std::string> specialize;
+            // written by the server if set, otherwise the file representation is returned in the response
+            std::string output;
+        };
+        struct ServerResponse
+        {
+            CompilationResult result;
+            std::vector<char> output;
+        };
+        class Channel
+        {
+        public:
+            virtual ~Channel() = default;
+            virtual bool Read(void* data, size_t size) = 0;
+            virtual bool Write(const void* data, size_t size) = 0;
+        };
+        // stdin/stdout, switched to binary mode
+        std::unique_ptr<Channel> StdioChannel();
+        // nullptr if the socket isn't available
+        std::unique_ptr<Channel> ConnectSocket(const std::filesystem::path& path);
+        bool SendRequest(Channel& channel, const ServerRequest& request);
+        bool ReceiveResponse(Channel& channel, ServerResponse& response);
+        // Keeps a compiler (and its include cache) warm between requests, requests of different connections compile concurrently
+        class CompilerPool
+        {
+        public:
+            explicit CompilerPool(std::optional<std::filesystem::path> cache_dir) : compiler(Compiler::New())
+            {
+                compiler->SetCacheDirectory(std::move(cache_dir));
+            }
+            ServerResponse Handle(const ServerRequest& request);
+        private:
+            // shared by every connection, it keeps a backend compiler per serving thread
+            std::unique_ptr<Compiler> compiler;
+        };
+        // Answers requests on the channel until it's closed
+        void Serve(Channel& channel, CompilerPool& pool);
+        // Accepts connections on a unix domain socket, every connection is served on its own thread.
+        // Returns only on failure, with a description of it. A stale socket at path is replaced, anything else is left alone
+        std::string ServeSocket(const std::filesystem::path& path, CompilerPool& pool);
+    }
+}
@@ -0,0 +1,170 @@
+#include "watch.h"
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <unordered_set>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        namespace
+        {
+            std::string Canonical(const std::filesystem::path& path)
+            {
+                std::error_code ec;
+                auto canonical = std::filesystem::weakly_canonical(path, ec);
+                if(ec) canonical = std::filesystem::absolute(path, ec).lexically_normal();
+                return canonical.string();
+            }
+#ifdef __linux__
+            class InotifyWatcher : public FileWatcher
+            {
+            public:
+                explicit InotifyWatcher(int fd) : fd(fd)
+                {
+                }
+                ~InotifyWatcher() override
+                {
+                    close(fd);
+                }
+                bool Watch(std::span<const std::filesystem::path> files) override
+                {
+                    for(auto& file : files)
+                    {
+                        auto dir = std::filesystem::path(Canonical(file)).parent_path();
+                        if(dir.empty() || watched.contains(dir.string())) continue;
+                        // writes in place show up as close_write, saves through a temporary file as moved_to
+                        int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR);
+                        if(wd < 0)
+                        {
+                            // the directory is gone, it's watched again once a job that needs it is compiled
+                            if(errno == ENOENT || errno == ENOTDIR) continue;
+                            return false;
+                        }
+                        watched[dir.string()] = wd;
+                        directories[wd] = dir;
+                    }
+                    return true;
+                }
+                std::optional<FileChanges> Wait(std::chrono::milliseconds debounce) override
+                {
+                    FileChanges changes;
+                    std::unordered_set<std::string> seen;
+                    int timeout = -1;
+                    while(true)
+                    {
+                        pollfd events = {fd, POLLIN, 0};
+                        int ready = poll(&events, 1, timeout);
+                        if(ready < 0 && errno == EINTR) continue;
+                        if(ready < 0) return std::nullopt;
+                        if(ready == 0) return changes;
+                        alignas(inotify_event) char buffer[16384];
+                        auto size = read(fd, buffer, sizeof(buffer));
+                        if(size < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+                        if(size < 0) return std::nullopt;
+                        for(char* ptr = buffer; ptr < buffer + size;)
+                        {
+                            auto event = reinterpret_cast<const inotify_event*>(ptr);
+                            ptr += sizeof(inotify_event) + event->len;
+                            if(event->mask & IN_Q_OVERFLOW) changes.overflow = true;
+                            auto dir = directories.find(event->wd);
+                            if(dir == directories.end()) continue;
+                            if(event->mask & IN_IGNORED)
+                            {
+                                watched.erase(dir->second.string());
+                                directories.erase(dir);
+                                continue;
+                            }
+                            if(!event->len) continue;
+                            auto file = dir->second / event->name;
+                            if(seen.insert(file.string()).second) changes.files.push_back(std::move(file));
+                        }
+                        timeout = static_cast<int>(debounce.count());
+                    }
+                }
+            private:
+                int fd;
+                std::unordered_map<std::string, int> watched;
+                std::unordered_map<int, std::filesystem::path> directories;
+            };
+#endif
+        }
+        std::unique_ptr<FileWatcher> FileWatcher::New()
+        {
+#ifdef __linux__
+            int fd = inotify_init1(IN_CLOEXEC);
+            if(fd < 0) return nullptr;
+            return std::make_unique<InotifyWatcher>(fd);
+#else
+            return nullptr;
+#endif
+        }
+        void DependencyGraph::Update(size_t job, std::span<const std::filesystem::path> job_files)
+        {
+            if(job >= files.size()) files.resize(job + 1);
+            for(auto& [key, recorded] : files[job])
+            {
+                auto it = dependents.find(key);
+                std::erase(it->second, job);
+                if(it->second.empty()) dependents.erase(it);
+            }
+            files[job].clear();
+            for(auto& file : job_files)
+            {
+                auto key = Canonical(file);
+                if(std::ranges::any_of(files[job], [&](auto& entry) { return entry.first == key; })) continue;
+                dependents[key].push_back(job);
+                files[job].emplace_back(std::move(key), file);
+            }
+        }
+        std::vector<size_t> DependencyGraph::Affected(std::span<const std::filesystem::path> changed, std::vector<std::filesystem::path>& recorded) const
+        {
+            std::vector<size_t> jobs;
+            for(auto& file : changed)
+            {
+                auto key = Canonical(file);
+                auto it = dependents.find(key);
+                if(it == dependents.end()) continue;
+                for(auto job : it->second)
+                {
+                    jobs.push_back(job);
+                    for(auto& [job_key, path] : files[job])
+                    {
+                        if(job_key == key) recorded.push_back(path);
+                    }
+                }
+            }
+            std::ranges::sort(jobs);
+            jobs.erase(std::unique(jobs.begin(), jobs.end()), jobs.end());
+            return jobs;
+        }
+        std::vector<std::filesystem::path> DependencyGraph::Files() const
+        {
+            std::vector<std::filesystem::path> paths;
+            for(auto& [key, jobs] : dependents)
+                paths.emplace_back(key);
+            return paths;
+        }
+        bool WriteFileAtomic(const std::filesystem::path& path, std::span<const char> bytes)
+        {
+            auto temp = path;
+            temp += ".tmp";
+            std::ofstream file(temp, std::ios::binary);
+            file.write(bytes.data(), bytes.size());
+            file.close();
+            std::error_code ec;
+            if(file.good()) std::filesystem::rename(temp, path, ec);
+            if(!file.good() || ec)
+            {
+                std::filesystem::remove(temp, ec);
+                return false;
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace RHI
+{
+    namespace ShaderCompiler
+    {
+        struct FileChanges
+        {
+            std::vector<std::filesystem::path> files;
+            // events were dropped, anything may have changed
+            bool overflow = false;
+        };
+        // Reports changes to a set of files. The directories holding them are watched rather than the files, as editors
+        // usually save by replacing the file
+        class FileWatcher
+        {
+        public:
+            // nullptr where the platform has no inotify
+            static std::unique_ptr<FileWatcher> New();
+            virtual ~FileWatcher() = default;
+            // Adds the directories of files that aren't watched yet
+            virtual bool Watch(std::span<const std::filesystem::path> files) = 0;
+            // Blocks until something in a watched directory changes, then collects events until none arrived for debounce.
+            // nullopt if the watch failed
+            virtual std::optional<FileChanges> Wait(std::chrono::milliseconds debounce) = 0;
+        };
+        // Which jobs read which files, as recorded by their last compilation. Files are compared by their canonical path
+        class DependencyGraph
+        {
+        public:
+            // Replaces the files job depends on
+            void Update(size_t job, std::span<const std::filesystem::path> files);
+            // The jobs reading any of changed in ascending order, recorded receives the changed files as the jobs spelled them
+            std::vector<size_t> Affected(std::span<const std::filesystem::path> changed, std::vector<std::filesystem::path>& recorded) const;
+            std::vector<std::filesystem::path> Files() const;
+        private:
+            std::unordered_map<std::string, std::vector<size_t>> dependents;
+            // per job, the canonical path and the recorded one of every file
+            std::vector<std::vector<std::pair<std::string, std::filesystem::path>>> files;
+        };
+        // Writes bytes next to path and renames it over path, readers see either the old or the new file
+        bool WriteFileAtomic(const std::filesystem::path& path, std::span<const char> bytes);
+    }
+}